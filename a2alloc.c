@@ -0,0 +1,326 @@
+/* HW3 - Locality
+ * a2alloc.c
+ * Function: Allocates the storage of the 2d arrays: cache line aligned
+ *           from the C library when small, and when large mapped on its
+ *           own on a 2MB boundary and marked for transparent huge pages,
+ *           optionally faulting every page in before it is returned.
+ *           Freed storage may be pooled by size class for the next
+ *           allocation of the same class
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "assert.h"
+#include "a2alloc.h"
+
+/* Every allocation starts on a cache line */
+#define LINE 64
+
+/* Size and alignment of a transparent huge page */
+#define HUGE_PAGE (2 * 1024 * 1024)
+
+/* Allocations at least this large get huge pages; below it the 4KB
+ * pages of an array fit in the second level TLB anyway, and rounding up
+ * to whole huge pages wastes less than a quarter of what is mapped */
+#define HUGE_MIN (4 * HUGE_PAGE)
+
+/* Most allocations the pool holds */
+#define POOL_SLOTS 16
+
+/* Whether huge page allocations are faulted in when made */
+static int populate = 0;
+
+/* The pool: freed storage, oldest first, with the total bytes it holds
+ * and the most it may; the threads of a pipeline allocate and free at
+ * once, so it is locked */
+static struct {
+        void *mem;
+        size_t bytes;           /* a size class */
+} pool[POOL_SLOTS];
+static int pooled = 0;
+static size_t pool_bytes = 0;
+static size_t pool_limit = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t class_bytes(size_t bytes);
+static void *pool_take(size_t bytes);
+static int pool_put(void *mem, size_t bytes);
+static void pool_trim(size_t bytes, int slots);
+static void *system_new(size_t bytes);
+static void system_free(void *mem, size_t bytes);
+#ifdef MADV_HUGEPAGE
+static void *huge_new(size_t bytes);
+static void prefault(char *mem, size_t bytes);
+#endif
+
+/* size_t round_up(size_t n, size_t multiple)
+ * Parameters: size_t n - a byte count
+ *             size_t multiple - a power of two
+ *    Returns: the smallest multiple of 'multiple' that is at least n
+ *   if Error: None
+ */
+static inline size_t round_up(size_t n, size_t multiple)
+{
+        return (n + multiple - 1) & ~(multiple - 1);
+}
+
+/* void *A2alloc_new(size_t bytes)
+ * Parameters: size_t bytes - bytes wanted
+ *    Returns: a pointer to at least that many bytes, cache line aligned
+ *       Does: Rounds the size up to its class and takes storage of that
+ *             class from the pool, or else from the system
+ *   if Error: raises assertion if out of memory
+ */
+void *A2alloc_new(size_t bytes)
+{
+        bytes = class_bytes(bytes);
+        void *mem = pool_take(bytes);
+        if (mem == NULL) {
+                mem = system_new(bytes);
+        }
+        return mem;
+}
+
+/* void A2alloc_free(void *mem, size_t bytes)
+ * Parameters: void *mem - storage from A2alloc_new
+ *             size_t bytes - bytes asked of A2alloc_new for it
+ *    Returns: Nothing
+ *       Does: Puts it in the pool, or gives it back to the system if the
+ *             pool has no room for it
+ *   if Error: raises assertion if mem is null
+ */
+void A2alloc_free(void *mem, size_t bytes)
+{
+        assert(mem != NULL);
+        bytes = class_bytes(bytes);
+        if (!pool_put(mem, bytes)) {
+                system_free(mem, bytes);
+        }
+}
+
+/* void A2alloc_set_populate(int on)
+ * Parameters: int on - nonzero to fault huge page allocations in
+ *    Returns: Nothing
+ *       Does: Sets whether later large allocations are faulted in before
+ *             they are returned, moving the cost of the page faults out
+ *             of whatever first writes the array
+ *   if Error: None
+ */
+void A2alloc_set_populate(int on)
+{
+        populate = on;
+}
+
+/* void A2alloc_set_pool(size_t bytes)
+ * Parameters: size_t bytes - most bytes of freed storage to keep
+ *    Returns: Nothing
+ *       Does: Sets the pool's limit, giving back the oldest storage it
+ *             holds until it is within it; 0 empties the pool and stops
+ *             pooling
+ *   if Error: None
+ */
+void A2alloc_set_pool(size_t bytes)
+{
+        pthread_mutex_lock(&pool_lock);
+        pool_limit = bytes;
+        pool_trim(bytes, POOL_SLOTS);
+        pthread_mutex_unlock(&pool_lock);
+}
+
+/* static size_t class_bytes(size_t bytes)
+ * Parameters: size_t bytes - bytes wanted
+ *    Returns: the size class holding it: bytes rounded up to a quarter of
+ *             the largest power of two not above it, and at least a line
+ *       Does: Keeps the storage wasted by rounding under a quarter, while
+ *             sizes close to each other share a class and so storage
+ *   if Error: None
+ */
+static size_t class_bytes(size_t bytes)
+{
+        if (bytes <= LINE) {
+                return LINE;
+        }
+        size_t top = LINE;
+        while (top <= bytes / 2) {
+                top *= 2;
+        }
+        size_t step = top / 4 > LINE ? top / 4 : LINE;
+        return round_up(bytes, step);
+}
+
+/* static void *pool_take(size_t bytes)
+ * Parameters: size_t bytes - a size class
+ *    Returns: pooled storage of that class, or NULL if there is none
+ *       Does: Takes the most recently pooled storage of the class
+ *   if Error: None
+ */
+static void *pool_take(size_t bytes)
+{
+        void *mem = NULL;
+        pthread_mutex_lock(&pool_lock);
+        for (int slot = pooled - 1; slot >= 0; slot--) {
+                if (pool[slot].bytes == bytes) {
+                        mem = pool[slot].mem;
+                        pool_bytes -= bytes;
+                        pooled--;
+                        for (int k = slot; k < pooled; k++) {
+                                pool[k] = pool[k + 1];
+                        }
+                        break;
+                }
+        }
+        pthread_mutex_unlock(&pool_lock);
+        return mem;
+}
+
+/* static int pool_put(void *mem, size_t bytes)
+ * Parameters: void *mem - storage being freed
+ *             size_t bytes - its size class
+ *    Returns: nonzero if the pool kept it
+ *       Does: Makes room by giving back the oldest storage in the pool,
+ *             which is the least likely to be asked for again, and adds
+ *             it as the newest
+ *   if Error: None
+ */
+static int pool_put(void *mem, size_t bytes)
+{
+        pthread_mutex_lock(&pool_lock);
+        int kept = bytes <= pool_limit;
+        if (kept) {
+                pool_trim(pool_limit - bytes, POOL_SLOTS - 1);
+                pool[pooled].mem = mem;
+                pool[pooled].bytes = bytes;
+                pooled++;
+                pool_bytes += bytes;
+        }
+        pthread_mutex_unlock(&pool_lock);
+        return kept;
+}
+
+/* static void pool_trim(size_t bytes, int slots)
+ * Parameters: size_t bytes - most bytes the pool may be left holding
+ *             int slots - most allocations it may be left holding
+ *    Returns: Nothing
+ *       Does: Gives the oldest storage back to the system until the pool
+ *             is within both; the caller holds the lock
+ *   if Error: None
+ */
+static void pool_trim(size_t bytes, int slots)
+{
+        int drop = 0;
+        while (drop < pooled && (pool_bytes > bytes
+                                 || pooled - drop > slots)) {
+                system_free(pool[drop].mem, pool[drop].bytes);
+                pool_bytes -= pool[drop].bytes;
+                drop++;
+        }
+        pooled -= drop;
+        for (int k = 0; k < pooled; k++) {
+                pool[k] = pool[k + drop];
+        }
+}
+
+/* static void *system_new(size_t bytes)
+ * Parameters: size_t bytes - a size class
+ *    Returns: a pointer to that many bytes, cache line aligned
+ *       Does: Maps large allocations on huge pages where the system has
+ *             them, and takes the rest from posix_memalign
+ *   if Error: raises assertion if out of memory
+ */
+static void *system_new(size_t bytes)
+{
+#ifdef MADV_HUGEPAGE
+        if (bytes >= HUGE_MIN) {
+                return huge_new(bytes);
+        }
+#endif
+        void *mem = NULL;
+        int failed = posix_memalign(&mem, LINE, bytes);
+        assert(failed == 0 && mem != NULL);
+        return mem;
+}
+
+/* static void system_free(void *mem, size_t bytes)
+ * Parameters: void *mem - storage from system_new
+ *             size_t bytes - its size class
+ *    Returns: Nothing
+ *       Does: Unmaps it or frees it, whichever system_new's choice for
+ *             that many bytes was
+ *   if Error: None
+ */
+static void system_free(void *mem, size_t bytes)
+{
+#ifdef MADV_HUGEPAGE
+        if (bytes >= HUGE_MIN) {
+                munmap(mem, round_up(bytes, HUGE_PAGE));
+                return;
+        }
+#endif
+        (void) bytes;
+        free(mem);
+}
+
+#ifdef MADV_HUGEPAGE
+/* static void *huge_new(size_t bytes)
+ * Parameters: size_t bytes - bytes wanted, at least HUGE_MIN
+ *    Returns: a 2MB aligned pointer to bytes rounded up to whole huge
+ *             pages
+ *       Does: Maps a huge page more than is needed, unmaps the parts
+ *             before the first 2MB boundary and after the last whole
+ *             huge page, and advises the kernel to back the rest with
+ *             huge pages. The advice is only advice: where huge pages
+ *             are off it fails and the mapping keeps small ones
+ *   if Error: raises assertion if the mapping fails
+ */
+static void *huge_new(size_t bytes)
+{
+        size_t kept = round_up(bytes, HUGE_PAGE);
+        size_t mapped = kept + HUGE_PAGE;
+        char *base = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(base != MAP_FAILED);
+
+        char *mem = (char *) round_up((uintptr_t) base, HUGE_PAGE);
+        size_t head = mem - base;
+        size_t tail = mapped - head - kept;
+        if (head > 0) {
+                munmap(base, head);
+        }
+        if (tail > 0) {
+                munmap(mem + kept, tail);
+        }
+        madvise(mem, kept, MADV_HUGEPAGE);
+        if (populate) {
+                prefault(mem, kept);
+        }
+        return mem;
+}
+
+/* static void prefault(char *mem, size_t bytes)
+ * Parameters: char *mem, size_t bytes - a mapping just made
+ *    Returns: Nothing
+ *       Does: Asks the kernel to fault the whole mapping in for writing,
+ *             or where it cannot, writes to every page. This is done
+ *             after the huge page advice, which MAP_POPULATE would
+ *             come before, so that the pages faulted in are huge ones
+ *   if Error: None
+ */
+static void prefault(char *mem, size_t bytes)
+{
+#ifdef MADV_POPULATE_WRITE
+        if (madvise(mem, bytes, MADV_POPULATE_WRITE) == 0) {
+                return;
+        }
+#endif
+        long page = sysconf(_SC_PAGESIZE);
+        if (page <= 0) {
+                page = 4096;
+        }
+        for (size_t at = 0; at < bytes; at += page) {
+                ((volatile char *) mem)[at] = 0;
+        }
+}
+#endif
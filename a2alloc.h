@@ -0,0 +1,37 @@
+#ifndef A2ALLOC_INCLUDED
+#define A2ALLOC_INCLUDED
+
+#include <stddef.h>
+
+/* Storage for the cells of 2d arrays. Every allocation starts on a cache
+ * line. Large ones are mapped on their own, start on a 2MB boundary and
+ * are marked for transparent huge pages, so that a walk across rows or
+ * down columns of a large image needs far fewer TLB entries; they can
+ * also be faulted in at allocation time instead of on first touch.
+ *
+ * Freed storage can be kept in a pool instead of going back to the
+ * system. Sizes are rounded up to size classes, a quarter of a power of
+ * two apart, and a new allocation of a class the pool holds gets that
+ * storage back, already faulted in, so an array made after one of the
+ * same size was freed costs neither a system call nor page faults.
+ */
+
+/* returns 'bytes' bytes of uninitialized storage, which a request for
+ * 0 bytes also gets (checked runtime error if memory is exhausted)
+ */
+extern void *A2alloc_new (size_t bytes);
+
+/* gives back storage from A2alloc_new, to the pool if it has room and
+ * otherwise to the system; 'bytes' must be what was asked for
+ */
+extern void  A2alloc_free(void *mem, size_t bytes);
+
+/* whether huge page allocations are faulted in when made (default 0) */
+extern void  A2alloc_set_populate(int populate);
+
+/* keeps at most 'bytes' of freed storage for reuse (default 0, no pool);
+ * storage over the new limit is released at once
+ */
+extern void  A2alloc_set_pool(size_t bytes);
+
+#endif
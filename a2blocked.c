@@ -2,12 +2,16 @@
 
 #include <a2blocked.h>
 #include "uarray2b.h"
+#include "workpool.h"
+#include "hilbert.h"
+#include "blocktune.h"
 
 typedef A2Methods_UArray2 A2;	// private abbreviation
 
+/* blocks sized to this machine's caches, or to its saved calibration */
 static A2 new(int width, int height, int size)
 {
-	return UArray2b_new_64K_block(width, height, size);
+	return UArray2b_new(width, height, size, Blocktune_blocksize(size));
 }
 
 static A2 new_with_blocksize(int width, int height, int size, int blocksize)
@@ -49,25 +53,84 @@ static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
 	UArray2b_map(array2, (applyfun *) apply, cl);
 }
 
-struct small_closure {
-	A2Methods_smallapplyfun *apply;
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+				  void *cl)
+{
+	UArray2b_small_map(a2, apply, cl);
+}
+
+/* a span ends at the edge of its block or of the array */
+static A2Methods_Object *span_at(A2 array2, int i, int j, int *n)
+{
+	A2Methods_Object *first = UArray2b_at(array2, i, j);
+	int bs = UArray2b_blocksize(array2);
+	int to_block_edge = bs - i % bs;
+	int to_array_edge = UArray2b_width(array2) - i;
+	*n = to_block_edge < to_array_edge ? to_block_edge : to_array_edge;
+	return first;
+}
+
+struct span_closure {
+	A2Methods_spanfun *apply;
 	void *cl;
 };
 
-static void apply_small(int i, int j, UArray2b_T array2, void *elem, void *vcl)
+static void apply_span(int i, int j, int n, UArray2b_T array2b, void *first,
+		       void *vcl)
 {
-	struct small_closure *cl = vcl;
-	(void)i;
-	(void)j;
-	(void)array2;
-	cl->apply(elem, cl->cl);
+	struct span_closure *cl = vcl;
+	cl->apply(i, j, n, A2Methods_ALONG_ROW, array2b, first, cl->cl);
 }
 
-static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
-				  void *cl)
+static void map_span_block_major(A2 array2, A2Methods_spanfun apply, void *cl)
+{
+	struct span_closure mycl = { apply, cl };
+	UArray2b_map_spans(array2, apply_span, &mycl);
+}
+
+/* a parallel map gives each block to one task of Workpool_map */
+struct parallel_closure {
+	A2 array2;
+	A2Methods_applyfun *apply;	/* one of apply and small_apply */
+	A2Methods_smallapplyfun *small_apply;
+};
+
+static void map_block(int block, void *cl, void *vp)
+{
+	struct parallel_closure *p = vp;
+	if (p->apply != NULL)
+		UArray2b_map_block(p->array2, block, (applyfun *) p->apply, cl);
+	else
+		UArray2b_small_map_block(p->array2, block, p->small_apply, cl);
+}
+
+static void map_block_major_parallel(A2 array2, int nthreads,
+				     A2Methods_closurefun *make_cl,
+				     A2Methods_applyfun apply, void *cl)
+{
+	struct parallel_closure p = { array2, apply, NULL };
+	Workpool_map(nthreads, UArray2b_blocks(array2), map_block, &p,
+		     make_cl, cl);
+}
+
+static void small_map_block_major_parallel(A2 a2, int nthreads,
+					   A2Methods_closurefun *make_cl,
+					   A2Methods_smallapplyfun apply,
+					   void *cl)
+{
+	struct parallel_closure p = { a2, NULL, apply };
+	Workpool_map(nthreads, UArray2b_blocks(a2), map_block, &p, make_cl,
+		     cl);
+}
+
+static void map_hilbert(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+	Hilbert_map(width(array2), height(array2), at, array2, apply, cl);
+}
+
+static void small_map_hilbert(A2 a2, A2Methods_smallapplyfun apply, void *cl)
 {
-	struct small_closure mycl = { apply, cl };
-	UArray2b_map(a2, apply_small, &mycl);
+	Hilbert_small_map(width(a2), height(a2), at, a2, apply, cl);
 }
 
 static struct A2Methods_T uarray2_methods_blocked_struct = {
@@ -87,6 +150,19 @@ static struct A2Methods_T uarray2_methods_blocked_struct = {
 	NULL,										/* small_map_col_major */
 	small_map_block_major,
 	small_map_block_major,	/* small_map_default   */
+	span_at,
+	NULL,			/* map_span_row_major  */
+	map_span_block_major,
+	map_span_block_major,	/* map_span_default    */
+	NULL,			/* map_row_major_parallel */
+	map_block_major_parallel,
+	map_block_major_parallel,	/* map_default_parallel */
+	NULL,			/* small_map_row_major_parallel */
+	small_map_block_major_parallel,
+	small_map_block_major_parallel,	/* small_map_default_parallel */
+	map_hilbert,
+	small_map_hilbert,
+	NULL,			/* transpose */
 };
 
 A2Methods_T uarray2_methods_blocked = &uarray2_methods_blocked_struct;
\ No newline at end of file
@@ -18,6 +18,29 @@ typedef void A2Methods_mapfun(A2 array2, A2Methods_applyfun apply, void *cl);
 typedef void A2Methods_smallapplyfun(A2Methods_Object *ptr, void *cl);
 typedef void A2Methods_smallmapfun(A2 a2, A2Methods_smallapplyfun f, void *cl);
 
+/* direction in which the cells of a span follow its first cell */
+typedef enum A2Methods_direction {
+        A2Methods_ALONG_ROW,    /* cell k of the span is (i + k, j) */
+        A2Methods_ALONG_COL     /* cell k of the span is (i, j + k) */
+} A2Methods_direction;
+
+/* a span is 'n' cells adjacent in memory: cell k of the span is at
+ * (char *)first + k * size, and its indices follow from (i, j) and 'dir'
+ */
+typedef void A2Methods_spanfun(int i, int j, int n, A2Methods_direction dir,
+                               A2 array2, A2Methods_Object *first, void *cl);
+typedef void A2Methods_spanmapfun(A2 array2, A2Methods_spanfun apply,
+                                  void *cl);
+
+/* makes the closure one thread of a parallel mapper passes to 'apply':
+ * called on that thread, before its first cell, with the thread's number
+ * (0 to nthreads - 1) and the closure given to the mapper
+ */
+typedef void *A2Methods_closurefun(int thread, void *cl);
+typedef void A2Methods_parallelmapfun(A2 array2, int nthreads,
+                                      A2Methods_closurefun *make_cl,
+                                      A2Methods_applyfun apply, void *cl);
+
 /* operations on 2D arrays */
 
 /* 
@@ -98,6 +121,96 @@ typedef struct A2Methods_T {
         void (*small_map_default)    (A2 a2, A2Methods_smallapplyfun apply,
                                       void *cl);
 
+        /* 
+         * bulk access: instead of one call per cell, these pass runs of
+         * cells that are adjacent in memory, so a caller can walk a run
+         * with a pointer
+         */
+
+        /* returns a pointer to the object in column i, row j, and sets *n
+         * to the number of cells (i, j), (i + 1, j), ... that are adjacent
+         * in memory, always at least 1; *n depends on i but not on j
+         * (checked runtime error if i or j is out of bounds)
+         */
+        A2Methods_Object *(*span_at)(A2 array2, int i, int j, int *n);
+
+        /* each span mapping function visits every cell of array2 exactly
+         * once, calling 'apply' once per span of nonzero length:
+         *   - span_row_major passes each whole row, in order of increasing
+         *     row index
+         *   - span_block_major passes each row of a block (clipped to the
+         *     array), visiting every block before the next
+         *   - span_default uses the order with the best locality
+         *
+         * A NULL entry follows the same rules as the other mappers.
+         */
+        void (*map_span_row_major)  (A2 array2, A2Methods_spanfun apply,
+                                     void *cl);
+        void (*map_span_block_major)(A2 array2, A2Methods_spanfun apply,
+                                     void *cl);
+        void (*map_span_default)    (A2 array2, A2Methods_spanfun apply,
+                                     void *cl);
+
+        /*
+         * parallel mapping functions: the cells are shared out among
+         * 'nthreads' threads, the caller being one of them, and every
+         * thread calls 'apply' with the closure make_cl(thread, cl) made
+         * on it (a thread given no cells never calls make_cl); if make_cl
+         * is NULL, every thread gets cl itself
+         *   - row_major gives each row to exactly one thread, which visits
+         *     it in order of increasing column index
+         *   - block_major gives each block to exactly one thread, which
+         *     visits it in the order map_block_major does
+         *   - default is whichever of the two the array has
+         *
+         * So an apply function that writes only its own cell needs no
+         * lock. Which thread gets a row or block, and the order of rows or
+         * blocks, is not specified; every call to 'apply' has returned
+         * when the mapper returns. nthreads < 1 is a checked runtime error.
+         * A NULL entry follows the same rules as the other mappers.
+         */
+        void (*map_row_major_parallel)  (A2 array2, int nthreads,
+                                         A2Methods_closurefun *make_cl,
+                                         A2Methods_applyfun apply, void *cl);
+        void (*map_block_major_parallel)(A2 array2, int nthreads,
+                                         A2Methods_closurefun *make_cl,
+                                         A2Methods_applyfun apply, void *cl);
+        void (*map_default_parallel)    (A2 array2, int nthreads,
+                                         A2Methods_closurefun *make_cl,
+                                         A2Methods_applyfun apply, void *cl);
+
+        void (*small_map_row_major_parallel)  (A2 a2, int nthreads,
+                                               A2Methods_closurefun *make_cl,
+                                               A2Methods_smallapplyfun apply,
+                                               void *cl);
+        void (*small_map_block_major_parallel)(A2 a2, int nthreads,
+                                               A2Methods_closurefun *make_cl,
+                                               A2Methods_smallapplyfun apply,
+                                               void *cl);
+        void (*small_map_default_parallel)    (A2 a2, int nthreads,
+                                               A2Methods_closurefun *make_cl,
+                                               A2Methods_smallapplyfun apply,
+                                               void *cl);
+
+        /*
+         * Hilbert order mapping: visits every cell once, along Hilbert
+         * curves laid over the array (see hilbert.h) whatever its layout,
+         * so that consecutive cells are close in both dimensions; both
+         * the rows and the columns of a row-major array are then read
+         * with locality. A NULL entry means the array has no such order.
+         */
+        void (*map_hilbert)      (A2 array2, A2Methods_applyfun apply,
+                                  void *cl);
+        void (*small_map_hilbert)(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl);
+
+        /*
+         * In place transposition: moves the cells within the array's own
+         * storage so that it becomes height cells wide and width cells
+         * tall, cell (i, j) holding what cell (j, i) held. A NULL entry
+         * means the layout cannot change shape in place.
+         */
+        void (*transpose)(A2 array2);
 } *A2Methods_T;
 
 #undef A2
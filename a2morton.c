@@ -0,0 +1,165 @@
+#include <string.h>
+
+#include <a2morton.h>
+#include "uarray2m.h"
+#include "workpool.h"
+#include "hilbert.h"
+
+typedef A2Methods_UArray2 A2;	// private abbreviation
+
+static A2 new(int width, int height, int size)
+{
+	return UArray2m_new_64K_block(width, height, size);
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+	return UArray2m_new(width, height, size, blocksize);
+}
+
+static void a2free(A2 * array2p)
+{
+	UArray2m_free((UArray2m_T *) array2p);
+}
+
+static int width(A2 array2)
+{
+	return UArray2m_width(array2);
+}
+static int height(A2 array2)
+{
+	return UArray2m_height(array2);
+}
+static int size(A2 array2)
+{
+	return UArray2m_size(array2);
+}
+static int blocksize(A2 array2)
+{
+	return UArray2m_blocksize(array2);
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+	return UArray2m_at(array2, i, j);
+}
+
+typedef void applyfun(int i, int j, UArray2m_T array2m, void *elem, void *cl);
+
+static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+	UArray2m_map(array2, (applyfun *) apply, cl);
+}
+
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+				  void *cl)
+{
+	UArray2m_small_map(a2, apply, cl);
+}
+
+/* in Z order, a cell in an even column is followed in memory by the one
+ * to its right, if that is in the array, and by nothing else of its row
+ */
+static A2Methods_Object *span_at(A2 array2, int i, int j, int *n)
+{
+	A2Methods_Object *first = UArray2m_at(array2, i, j);
+	*n = i % 2 == 0 && i + 1 < UArray2m_width(array2) ? 2 : 1;
+	return first;
+}
+
+struct span_closure {
+	A2Methods_spanfun *apply;
+	void *cl;
+};
+
+static void apply_span(int i, int j, int n, UArray2m_T array2m, void *first,
+		       void *vcl)
+{
+	struct span_closure *cl = vcl;
+	cl->apply(i, j, n, A2Methods_ALONG_ROW, array2m, first, cl->cl);
+}
+
+static void map_span_block_major(A2 array2, A2Methods_spanfun apply, void *cl)
+{
+	struct span_closure mycl = { apply, cl };
+	UArray2m_map_spans(array2, apply_span, &mycl);
+}
+
+/* a parallel map gives each tile to one task of Workpool_map */
+struct parallel_closure {
+	A2 array2;
+	A2Methods_applyfun *apply;	/* one of apply and small_apply */
+	A2Methods_smallapplyfun *small_apply;
+};
+
+static void map_block(int block, void *cl, void *vp)
+{
+	struct parallel_closure *p = vp;
+	if (p->apply != NULL)
+		UArray2m_map_block(p->array2, block, (applyfun *) p->apply, cl);
+	else
+		UArray2m_small_map_block(p->array2, block, p->small_apply, cl);
+}
+
+static void map_block_major_parallel(A2 array2, int nthreads,
+				     A2Methods_closurefun *make_cl,
+				     A2Methods_applyfun apply, void *cl)
+{
+	struct parallel_closure p = { array2, apply, NULL };
+	Workpool_map(nthreads, UArray2m_blocks(array2), map_block, &p,
+		     make_cl, cl);
+}
+
+static void small_map_block_major_parallel(A2 a2, int nthreads,
+					   A2Methods_closurefun *make_cl,
+					   A2Methods_smallapplyfun apply,
+					   void *cl)
+{
+	struct parallel_closure p = { a2, NULL, apply };
+	Workpool_map(nthreads, UArray2m_blocks(a2), map_block, &p, make_cl,
+		     cl);
+}
+
+static void map_hilbert(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+	Hilbert_map(width(array2), height(array2), at, array2, apply, cl);
+}
+
+static void small_map_hilbert(A2 a2, A2Methods_smallapplyfun apply, void *cl)
+{
+	Hilbert_small_map(width(a2), height(a2), at, a2, apply, cl);
+}
+
+static struct A2Methods_T uarray2_methods_morton_struct = {
+	new,
+	new_with_blocksize,
+	a2free,
+	width,
+	height,
+	size,
+	blocksize,
+	at,
+	NULL,			/* map_row_major       */
+	NULL,			/* map_col_major       */
+	map_block_major,
+	map_block_major,	/* map_default: Z order */
+	NULL,			/* small_map_row_major */
+	NULL,			/* small_map_col_major */
+	small_map_block_major,
+	small_map_block_major,	/* small_map_default   */
+	span_at,
+	NULL,			/* map_span_row_major  */
+	map_span_block_major,
+	map_span_block_major,	/* map_span_default    */
+	NULL,			/* map_row_major_parallel */
+	map_block_major_parallel,
+	map_block_major_parallel,	/* map_default_parallel */
+	NULL,			/* small_map_row_major_parallel */
+	small_map_block_major_parallel,
+	small_map_block_major_parallel,	/* small_map_default_parallel */
+	map_hilbert,
+	small_map_hilbert,
+	NULL,			/* transpose */
+};
+
+A2Methods_T uarray2_methods_morton = &uarray2_methods_morton_struct;
\ No newline at end of file
@@ -0,0 +1,3 @@
+#include <a2methods.h>
+
+extern A2Methods_T uarray2_methods_morton;    /* functions for Z order arrays */
@@ -2,6 +2,8 @@
 
 #include <a2plain.h>
 #include "uarray2.h"
+#include "workpool.h"
+#include "hilbert.h"
 
 /************************************************/
 /* Define a private version of each function in */
@@ -102,6 +104,83 @@ static void small_map_col_major(A2Methods_UArray2        a2,
 }
 
 
+/* the cells of a row are adjacent, so a span runs to the end of the row */
+static A2Methods_Object *span_at(A2 array2, int i, int j, int *n)
+{
+    A2Methods_Object *first = UArray2_at(array2, i, j);
+    *n = UArray2_width(array2) - i;
+    return first;
+}
+
+static void map_span_row_major(A2Methods_UArray2 uarray2,
+                               A2Methods_spanfun apply,
+                               void *cl)
+{
+    int w = UArray2_width(uarray2);
+    int h = UArray2_height(uarray2);
+    if (w == 0)
+        return;
+    for (int j = 0; j < h; j++)
+        apply(0, j, w, A2Methods_ALONG_ROW, uarray2,
+              UArray2_at(uarray2, 0, j), cl);
+}
+
+/* a parallel map gives each row to one task of Workpool_map */
+struct parallel_closure {
+    A2Methods_UArray2        uarray2;
+    A2Methods_applyfun      *apply;       /* one of apply and small_apply */
+    A2Methods_smallapplyfun *small_apply;
+};
+
+static void map_row(int j, void *cl, void *vp)
+{
+    struct parallel_closure *p = vp;
+    int w = UArray2_width(p->uarray2);
+    int size = UArray2_size(p->uarray2);
+    if (w == 0)
+        return;
+    char *elem = UArray2_at(p->uarray2, 0, j);
+    for (int i = 0; i < w; i++, elem += size) {
+        if (p->apply != NULL)
+            p->apply(i, j, p->uarray2, elem, cl);
+        else
+            p->small_apply(elem, cl);
+    }
+}
+
+static void map_row_major_parallel(A2Methods_UArray2 uarray2, int nthreads,
+                                   A2Methods_closurefun *make_cl,
+                                   A2Methods_applyfun apply,
+                                   void *cl)
+{
+    struct parallel_closure p = { uarray2, apply, NULL };
+    Workpool_map(nthreads, UArray2_height(uarray2), map_row, &p, make_cl,
+                 cl);
+}
+
+static void small_map_row_major_parallel(A2Methods_UArray2 a2, int nthreads,
+                                         A2Methods_closurefun *make_cl,
+                                         A2Methods_smallapplyfun apply,
+                                         void *cl)
+{
+    struct parallel_closure p = { a2, NULL, apply };
+    Workpool_map(nthreads, UArray2_height(a2), map_row, &p, make_cl, cl);
+}
+
+static void map_hilbert(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+    Hilbert_map(width(array2), height(array2), at, array2, apply, cl);
+}
+
+static void small_map_hilbert(A2 a2, A2Methods_smallapplyfun apply, void *cl)
+{
+    Hilbert_small_map(width(a2), height(a2), at, a2, apply, cl);
+}
+
+static void transpose(A2 array2)
+{
+    UArray2_transpose(array2);
+}
 
 static struct A2Methods_T uarray2_methods_plain_struct = {
     new,
@@ -120,6 +199,19 @@ static struct A2Methods_T uarray2_methods_plain_struct = {
     small_map_col_major,
     NULL,                /* small_map_block_major */
     small_map_row_major, /* small_map_default */
+    span_at,
+    map_span_row_major,
+    NULL,                /* map_span_block_major */
+    map_span_row_major,  /* map_span_default */
+    map_row_major_parallel,
+    NULL,                /* map_block_major_parallel */
+    map_row_major_parallel, /* map_default_parallel */
+    small_map_row_major_parallel,
+    NULL,                /* small_map_block_major_parallel */
+    small_map_row_major_parallel, /* small_map_default_parallel */
+    map_hilbert,
+    small_map_hilbert,
+    transpose,
 };
 
 // finally the payoff: here is the exported pointer to the struct
@@ -1,9 +1,20 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "assert.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2morton.h"
+#include "a2alloc.h"
+#include "a2view.h"
+#include "transform.h"
+#include "ppmread.h"
+#include "ppmwrite.h"
+#include "pipeline.h"
+#include "outofcore.h"
 
 
 #define W 13
@@ -66,6 +77,173 @@ static void double_row_major_plus()
         methods->free(&array);
 }
 
+static void sum_cell(int i, int j, A2 a, void *elem, void *cl)
+{
+        (void)a;
+        unsigned *p = elem;
+        unsigned *sum = cl;
+        assert(*p == 1000u * i + j);
+        *sum += *p;
+}
+
+static void small_sum_cell(void *elem, void *cl)
+{
+        unsigned *p = elem;
+        unsigned *sum = cl;
+        *sum += *p;
+}
+
+/* sum of every cell of an array holding 1000 * i + j in cell (i, j) */
+static unsigned expected_sum(void)
+{
+        unsigned expected = 0;
+        for (int i = 0; i < W; i++)
+                for (int j = 0; j < H; j++)
+                        expected += 1000 * i + j;
+        return expected;
+}
+
+/* every cell must have been incremented once; undo it */
+static void check_incremented(A2 array)
+{
+        for (int i = 0; i < W; i++) {
+                for (int j = 0; j < H; j++) {
+                        unsigned *p = methods->at(array, i, j);
+                        assert(*p == 1000u * i + j + 1);
+                        *p -= 1;
+                }
+        }
+}
+
+/* block-major mappers must visit every cell exactly once */
+static void block_major_sums(A2 array)
+{
+        unsigned expected = expected_sum();
+        if (methods->map_block_major) {
+                unsigned sum = 0;
+                methods->map_block_major(array, sum_cell, &sum);
+                assert(sum == expected);
+        }
+        if (methods->small_map_block_major) {
+                unsigned sum = 0;
+                methods->small_map_block_major(array, small_sum_cell, &sum);
+                assert(sum == expected);
+        }
+}
+
+static void span_sum(int i, int j, int n, A2Methods_direction dir, A2 a,
+                     void *first, void *cl)
+{
+        unsigned *p = first;
+        unsigned *sum = cl;
+        int left;
+        assert(n > 0);
+        for (int k = 0; k < n; k++) {
+                int ci = dir == A2Methods_ALONG_ROW ? i + k : i;
+                int cj = dir == A2Methods_ALONG_ROW ? j : j + k;
+                assert(methods->at(a, ci, cj) == (void *)(p + k));
+                *sum += p[k];
+        }
+        assert(methods->span_at(a, i, j, &left) == first);
+        assert(left >= 1);
+}
+
+/* span mappers must cover every cell exactly once with adjacent runs */
+static void span_sums(A2 array)
+{
+        unsigned expected = expected_sum();
+        assert(methods->map_span_default != NULL);
+        unsigned sum = 0;
+        methods->map_span_default(array, span_sum, &sum);
+        assert(sum == expected);
+        for (int j = 0; j < H; j++) {
+                for (int i = 0; i < W; i++) {
+                        int n;
+                        unsigned *p = methods->span_at(array, i, j, &n);
+                        assert(n >= 1 && i + n <= W);
+                        for (int k = 0; k < n; k++)
+                                assert(p + k == methods->at(array, i + k, j));
+                }
+        }
+}
+
+#define THREADS 3
+
+/* one running sum per thread, so the threads share no closure */
+struct thread_sums {
+        unsigned sum[THREADS];
+        int made[THREADS];
+};
+
+static void *own_sum(int thread, void *cl)
+{
+        struct thread_sums *sums = cl;
+        assert(thread >= 0 && thread < THREADS);
+        assert(!sums->made[thread]);
+        sums->made[thread] = 1;
+        return &sums->sum[thread];
+}
+
+static void small_increment(void *elem, void *cl)
+{
+        (void)cl;
+        unsigned *p = elem;
+        *p += 1;
+}
+
+/* parallel mappers must visit every cell exactly once, on some thread */
+static void parallel_sums(A2 array)
+{
+        unsigned expected = expected_sum();
+        assert(methods->map_default_parallel != NULL);
+        assert(methods->small_map_default_parallel != NULL);
+
+        struct thread_sums sums = { { 0 }, { 0 } };
+        methods->map_default_parallel(array, THREADS, own_sum, sum_cell,
+                                      &sums);
+        unsigned sum = 0;
+        for (int t = 0; t < THREADS; t++)
+                sum += sums.sum[t];
+        assert(sum == expected);
+
+        /* with no closure factory, apply may still write its own cell */
+        methods->small_map_default_parallel(array, THREADS, NULL,
+                                            small_increment, NULL);
+        check_incremented(array);
+}
+
+/* Hilbert mappers must visit every cell exactly once */
+static void hilbert_sums(A2 array)
+{
+        unsigned expected = expected_sum();
+        if (methods->map_hilbert) {
+                unsigned sum = 0;
+                methods->map_hilbert(array, sum_cell, &sum);
+                assert(sum == expected);
+        }
+        if (methods->small_map_hilbert) {
+                unsigned sum = 0;
+                methods->small_map_hilbert(array, small_sum_cell, &sum);
+                assert(sum == expected);
+                methods->small_map_hilbert(array, small_increment, NULL);
+                check_incremented(array);
+        }
+}
+
+/* with a pool, an array made after one of the same size was freed gets
+ * the freed one's storage back */
+static void pooled_reuse(void)
+{
+        A2alloc_set_pool(1 << 20);
+        A2 first = methods->new(W, H, sizeof(unsigned));
+        void *storage = methods->at(first, 0, 0);
+        methods->free(&first);
+        A2 second = methods->new(W, H, sizeof(unsigned));
+        assert(methods->at(second, 0, 0) == storage);
+        methods->free(&second);
+        A2alloc_set_pool(0);
+}
+
 #if 0
 static void show(int i, int j, A2 a, void *elem, void *cl) 
 {
@@ -120,6 +298,377 @@ static inline void copy_unsigned(A2Methods_T methods, A2 a,
         *p = n;
 }
 
+static unsigned cell(A2Methods_T m, A2 a, int i, int j)
+{
+        return *(unsigned *)m->at(a, i, j);
+}
+
+/* a view through t and then u, and its copies into arrays of either
+ * suite, must hold what two Transform_tiled passes produce */
+static void view_compositions(void)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        A2Methods_T blocked = uarray2_methods_blocked;
+        A2Methods_T view_methods = uarray2_methods_view;
+        A2 array = plain->new(W, H, sizeof(unsigned));
+        for (int i = 0; i < W; i++)
+                for (int j = 0; j < H; j++)
+                        *(unsigned *)plain->at(array, i, j) = 1000 * i + j;
+
+        for (int t = TRANSFORM_ROTATE_0; t <= TRANSFORM_TRANSVERSE; t++) {
+                for (int u = TRANSFORM_ROTATE_0; u <= TRANSFORM_TRANSVERSE;
+                     u++) {
+                        int w1, h1, w2, h2;
+                        Transform_dimensions(t, W, H, &w1, &h1);
+                        Transform_dimensions(u, w1, h1, &w2, &h2);
+                        A2 once = plain->new(w1, h1, sizeof(unsigned));
+                        A2 twice = plain->new(w2, h2, sizeof(unsigned));
+                        Transform_tiled(t, plain, array, once);
+                        Transform_tiled(u, plain, once, twice);
+
+                        A2 first = A2view_new(array, plain, t);
+                        A2 view = A2view_transform(first, u);
+                        assert(A2view_composed(view)
+                               == Transform_compose(t, u));
+                        A2 tiled = A2view_materialize(view, plain);
+                        A2 mapped = A2view_materialize(view, blocked);
+                        assert(view_methods->width(view) == w2);
+                        assert(view_methods->height(view) == h2);
+                        for (int i = 0; i < w2; i++) {
+                                for (int j = 0; j < h2; j++) {
+                                        unsigned n = cell(plain, twice, i, j);
+                                        assert(cell(view_methods, view, i, j)
+                                               == n);
+                                        assert(cell(plain, tiled, i, j) == n);
+                                        assert(cell(blocked, mapped, i, j)
+                                               == n);
+                                }
+                        }
+                        view_methods->free(&first);
+                        view_methods->free(&view);
+                        plain->free(&tiled);
+                        blocked->free(&mapped);
+                        plain->free(&once);
+                        plain->free(&twice);
+                }
+        }
+        plain->free(&array);
+}
+
+/* every instruction set this CPU supports must give the tiled kernel the
+ * result of the scalar loops, which must agree with a view read cell by
+ * cell; the sizes are not multiples of any tile or vector square */
+static void simd_paths(void)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        A2Methods_T view_methods = uarray2_methods_view;
+        int sizes[] = { 3, 4, 12 };
+        int width = 291, height = 157;
+        for (int s = 0; s < 3; s++) {
+                int size = sizes[s];
+                A2 src = plain->new(width, height, size);
+                for (int i = 0; i < width; i++) {
+                        for (int j = 0; j < height; j++) {
+                                unsigned char *c = plain->at(src, i, j);
+                                for (int b = 0; b < size; b++)
+                                        c[b] = i * 7 + j * 13 + b * 31;
+                        }
+                }
+                for (int t = TRANSFORM_ROTATE_0; t <= TRANSFORM_TRANSVERSE;
+                     t++) {
+                        int w, h;
+                        Transform_dimensions(t, width, height, &w, &h);
+                        A2 scalar = plain->new(w, h, size);
+                        assert(Transform_set_simd(TRANSFORM_SIMD_SCALAR));
+                        Transform_tiled(t, plain, src, scalar);
+                        A2 view = A2view_new(src, plain, t);
+                        for (int i = 0; i < w; i++)
+                                for (int j = 0; j < h; j++)
+                                        assert(memcmp(plain->at(scalar, i, j),
+                                                      view_methods->at(view,
+                                                                       i, j),
+                                                      size) == 0);
+                        view_methods->free(&view);
+
+                        for (int simd = TRANSFORM_SIMD_AUTO;
+                             simd <= TRANSFORM_SIMD_AVX2; simd++) {
+                                if (!Transform_set_simd(simd))
+                                        continue;
+                                A2 dst = plain->new(w, h, size);
+                                Transform_tiled(t, plain, src, dst);
+                                for (int j = 0; j < h; j++)
+                                        assert(memcmp(plain->at(dst, 0, j),
+                                                      plain->at(scalar, 0, j),
+                                                      (size_t) w * size)
+                                               == 0);
+                                plain->free(&dst);
+                        }
+                        plain->free(&scalar);
+                }
+                plain->free(&src);
+        }
+        Transform_set_simd(TRANSFORM_SIMD_AUTO);
+}
+
+/* transforming a width by height array of suite m in place must leave
+ * what Transform_tiled writes to a second array */
+static void in_place_check(A2Methods_T m, Transform_T t, int width,
+                           int height, int blocksize)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        A2 array = m->new_with_blocksize(width, height, sizeof(unsigned),
+                                         blocksize);
+        A2 source = plain->new(width, height, sizeof(unsigned));
+        for (int i = 0; i < width; i++) {
+                for (int j = 0; j < height; j++) {
+                        copy_unsigned(m, array, i, j, 1000 * i + j);
+                        copy_unsigned(plain, source, i, j, 1000 * i + j);
+                }
+        }
+        int out_width, out_height;
+        Transform_dimensions(t, width, height, &out_width, &out_height);
+        A2 copy = plain->new(out_width, out_height, sizeof(unsigned));
+        Transform_tiled(t, plain, source, copy);
+        Transform_in_place(t, m, array);
+        for (int i = 0; i < out_width; i++)
+                for (int j = 0; j < out_height; j++)
+                        assert(cell(m, array, i, j) == cell(plain, copy, i, j));
+        m->free(&array);
+        plain->free(&source);
+        plain->free(&copy);
+}
+
+static void in_place_transforms(void)
+{
+        A2Methods_T suites[] = { uarray2_methods_plain,
+                                 uarray2_methods_blocked,
+                                 uarray2_methods_morton };
+        for (int s = 0; s < 3; s++) {
+                for (int t = TRANSFORM_ROTATE_0; t <= TRANSFORM_TRANSVERSE;
+                     t++) {
+                        in_place_check(suites[s], t, W, W, BS);
+                        if (Transform_in_place_ok(t, suites[s], W, H))
+                                in_place_check(suites[s], t, W, H, BS);
+                        /* a transposed row of 17 cells needs a second
+                         * line, leaving too little room to pad rows */
+                        if (Transform_in_place_ok(t, suites[s], 16, 17))
+                                in_place_check(suites[s], t, 16, 17, BS);
+                }
+        }
+        /* blocks long enough to be read through row pointers, which
+         * cycles of cells cross at their edges */
+        for (int t = TRANSFORM_ROTATE_0; t <= TRANSFORM_TRANSVERSE; t++) {
+                in_place_check(uarray2_methods_blocked, t, 21, 21, 8);
+                if (Transform_in_place_ok(t, uarray2_methods_blocked, 21, 19))
+                        in_place_check(uarray2_methods_blocked, t, 21, 19, 8);
+        }
+}
+
+/* the image in the 'n' bytes at 'ppm', read from a regular file (which
+ * the reader maps) if 'mapped' and otherwise from a memory stream (which
+ * it buffers); NULL if the reader finds the bytes bad */
+/* a stream holding the n bytes at ppm: a temporary file, which the
+ * reader maps, or one in memory, which it can only read forwards */
+static FILE *open_ppm(const char *ppm, size_t n, int mapped)
+{
+        FILE *fp;
+        if (mapped) {
+                fp = tmpfile();
+                assert(fp != NULL);
+                assert(fwrite(ppm, 1, n, fp) == n);
+                rewind(fp);
+        } else {
+                fp = fmemopen((void *) ppm, n, "rb");
+                assert(fp != NULL);
+        }
+        return fp;
+}
+
+static Pnm_ppm read_ppm(const char *ppm, size_t n, int mapped)
+{
+        FILE *fp = open_ppm(ppm, n, mapped);
+        Pnm_ppm img = NULL;
+        Ppmread_T reader = Ppmread_new(fp);
+        if (reader != NULL) {
+                img = Ppmread_image(reader, uarray2_methods_plain,
+                                    sizeof(struct Pnm_rgb));
+                Ppmread_free(&reader);
+        }
+        fclose(fp);
+        return img;
+}
+
+static void check_pixel(Pnm_ppm img, int i, int j, unsigned red,
+                        unsigned green, unsigned blue)
+{
+        struct Pnm_rgb *pixel = img->methods->at(img->pixels, i, j);
+        assert(pixel->red == red && pixel->green == green
+               && pixel->blue == blue);
+}
+
+/* plain and raw files, comments, 2 byte channels, and files the reader
+ * must turn down, through both the mapped and the buffered reader */
+static void ppm_reading(void)
+{
+        static const char plain[] = "P3\n# a comment\n2 1 # another\n"
+                                    "255\n1 2 3\n4 5 255\n";
+        static const char wide[] = "P6 1 1 1000\n\x03\xe8\x00\x01\x00\x02";
+        static const char raw[] = "P6\n2 1\n100\n\x01\x02\x03\x04\x05\x64";
+        /* the lengths count the zero bytes of 2 byte channels */
+#define BYTES(literal) { literal, sizeof(literal) - 1 }
+        static const struct { const char *bytes; size_t n; } bad[] = {
+                BYTES("P6 2 1 100\n\x01\x02\x03\x04\x05"),      /* short */
+                BYTES("P3 2 1 255\n1 2 3 4 5"),                  /* short */
+                BYTES("P6 2 1 100\n\x01\x02\x03\x04\x05\xc8"),  /* > 100 */
+                BYTES("P6 1 1 1000\n\x03\xe9\x00\x01\x00\x02"), /* > 1000 */
+                BYTES("P3 1 1 100\n1 2 101\n"),                 /* > 100 */
+                BYTES("P3 1 1 255\n1 x 3\n"),           /* not a number */
+                BYTES("P5 1 1 255\n\x01"),                /* not a ppm */
+                BYTES("hello\n"),                         /* not a ppm */
+        };
+#undef BYTES
+        for (int mapped = 0; mapped <= 1; mapped++) {
+                Pnm_ppm img = read_ppm(plain, sizeof(plain) - 1, mapped);
+                assert(img != NULL && img->width == 2 && img->height == 1);
+                check_pixel(img, 0, 0, 1, 2, 3);
+                check_pixel(img, 1, 0, 4, 5, 255);
+                Pnm_ppmfree(&img);
+
+                img = read_ppm(wide, sizeof(wide) - 1, mapped);
+                assert(img != NULL && img->denominator == 1000);
+                check_pixel(img, 0, 0, 1000, 1, 2);
+                Pnm_ppmfree(&img);
+
+                img = read_ppm(raw, sizeof(raw) - 1, mapped);
+                assert(img != NULL && img->denominator == 100);
+                check_pixel(img, 1, 0, 4, 5, 100);
+                Pnm_ppmfree(&img);
+
+                for (size_t k = 0; k < sizeof(bad) / sizeof(bad[0]); k++)
+                        assert(read_ppm(bad[k].bytes, bad[k].n, mapped)
+                               == NULL);
+        }
+}
+
+/* a width by height ppm, raw (P6) or plain (P3), whose pixels all
+ * differ from their neighbours'; the caller frees the bytes */
+static char *pattern_ppm(int width, int height, int raw, size_t *n)
+{
+        char *ppm;
+        FILE *fp = open_memstream(&ppm, n);
+        assert(fp != NULL);
+        fprintf(fp, "%s\n%d %d\n255\n", raw ? "P6" : "P3", width, height);
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                        int red = (i * 7 + j * 3) & 255;
+                        int green = (i ^ j) & 255;
+                        int blue = (i + j * 11) & 255;
+                        if (raw)
+                                fprintf(fp, "%c%c%c", red, green, blue);
+                        else
+                                fprintf(fp, "%d %d %d\n", red, green, blue);
+                }
+        }
+        assert(fclose(fp) == 0);
+        return ppm;
+}
+
+/* runs t on the image in ppm, into a temporary file, with Pipeline_run
+ * or, given a scratch directory, with Outofcore_run and max_memory, and
+ * checks what it wrote against Transform_tiled applied to src */
+static void check_run(Transform_T t, const char *ppm, size_t n, int mapped,
+                      Pnm_ppm src, size_t max_memory, const char *scratch)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        int size = sizeof(struct Pnm_rgb);
+        int w, h;
+        Transform_dimensions(t, src->width, src->height, &w, &h);
+        A2 expected = plain->new(w, h, size);
+        Transform_tiled(t, plain, src->pixels, expected);
+
+        FILE *in = open_ppm(ppm, n, mapped);
+        FILE *out = tmpfile();
+        assert(out != NULL);
+        Ppmread_T reader = Ppmread_new(in);
+        assert(reader != NULL);
+        Ppmwrite_T writer = Ppmwrite_new(out, w, h, 255, size);
+        if (scratch == NULL)
+                Pipeline_run(t, plain, size, reader, writer);
+        else
+                Outofcore_run(t, plain, size, reader, writer, max_memory,
+                              scratch);
+        assert(Ppmwrite_free(&writer));
+        Ppmread_free(&reader);
+        fclose(in);
+
+        rewind(out);
+        reader = Ppmread_new(out);
+        assert(reader != NULL);
+        Pnm_ppm result = Ppmread_image(reader, plain, size);
+        Ppmread_free(&reader);
+        fclose(out);
+        assert(result != NULL);
+        assert((int) result->width == w && (int) result->height == h);
+        for (int j = 0; j < h; j++)
+                assert(memcmp(plain->at(result->pixels, 0, j),
+                              plain->at(expected, 0, j),
+                              (size_t) w * size) == 0);
+        Pnm_ppmfree(&result);
+        plain->free(&expected);
+}
+
+/* every transform through the pipeline, from a raw file it can seek in
+ * (bands read backwards, strips of columns) and from inputs it can only
+ * read forwards (one whole result); 700 by 520 cells of 12 bytes make
+ * two bands of rows and two strips of columns, each with a short last
+ * one
+ */
+static void pipelines(void)
+{
+        int width = 700, height = 520;
+        struct { int raw, mapped; } inputs[] = { { 1, 1 }, { 1, 0 },
+                                                 { 0, 1 } };
+        for (int k = 0; k < 3; k++) {
+                size_t n;
+                char *ppm = pattern_ppm(width, height, inputs[k].raw, &n);
+                Pnm_ppm src = read_ppm(ppm, n, 1);
+                assert(src != NULL);
+                for (int t = TRANSFORM_ROTATE_0; t <= TRANSFORM_TRANSVERSE;
+                     t++)
+                        check_run(t, ppm, n, inputs[k].mapped, src, 0,
+                                  NULL);
+                Pnm_ppmfree(&src);
+                free(ppm);
+        }
+}
+
+/* every transform out of core, from a raw file it can seek in (bands
+ * written directly, the bottom one first when flipping rows) and from a
+ * stream it can only read forwards; max_memory holds two 7 row bands of
+ * the 97 by 61 image, so there are 9 bands and, for the pieces spilled
+ * and gathered again, 5 bands of the result, the last ones short; the
+ * scratch directory must be left empty
+ */
+static void out_of_core(void)
+{
+        int width = 97, height = 61;
+        size_t max_memory = 2 * 7 * width * sizeof(struct Pnm_rgb);
+        char scratch[] = "/tmp/a2test-XXXXXX";
+        assert(mkdtemp(scratch) != NULL);
+        size_t n;
+        char *ppm = pattern_ppm(width, height, 1, &n);
+        Pnm_ppm src = read_ppm(ppm, n, 1);
+        assert(src != NULL);
+        for (int mapped = 0; mapped <= 1; mapped++)
+                for (int t = TRANSFORM_ROTATE_0; t <= TRANSFORM_TRANSVERSE;
+                     t++)
+                        check_run(t, ppm, n, mapped, src, max_memory,
+                                  scratch);
+        Pnm_ppmfree(&src);
+        free(ppm);
+        assert(rmdir(scratch) == 0);
+}
+
 static void test_methods(A2Methods_T methods_under_test) 
 {
         methods = methods_under_test;
@@ -157,7 +706,12 @@ static void test_methods(A2Methods_T methods_under_test)
                         assert(*p == n);
                 }
         }
+        block_major_sums(array);
+        span_sums(array);
+        parallel_sums(array);
+        hilbert_sums(array);
         double_row_major_plus();
+        pooled_reuse();
         methods->free(&array);
 }
 
@@ -166,7 +720,15 @@ int main(int argc, char *argv[])
         assert(argc == 1);
         (void)argv;
         test_methods(uarray2_methods_plain);
-        /*  test_methods(uarray2_methods_blocked); */
+        test_methods(uarray2_methods_blocked);
+        test_methods(uarray2_methods_morton);
+        test_methods(uarray2_methods_view);
+        view_compositions();
+        simd_paths();
+        in_place_transforms();
+        ppm_reading();
+        pipelines();
+        out_of_core();
         printf("Passed.\n");  /* only if we reach this point without
                                * assertion failure
                                */
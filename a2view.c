@@ -0,0 +1,396 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <a2view.h>
+#include "assert.h"
+#include "a2plain.h"
+#include "workpool.h"
+#include "hilbert.h"
+
+/************************************************/
+/* A view is an array of another suite and the  */
+/* map from the view's indices to the array's.  */
+/************************************************/
+
+typedef A2Methods_UArray2 A2;
+
+/* the transforms are the signed permutations of the axes, so cell (i, j)
+ * of a view is cell (xi * i + xj * j + x0, yi * i + yj * j + y0) of its
+ * array, and each of xi, xj, yi, yj is -1, 0 or 1
+ */
+struct view {
+    A2          array;
+    A2Methods_T methods;    /* the array's */
+    int         owns;       /* the array is freed with the view */
+    int         width, height;
+    int         xi, xj, x0;
+    int         yi, yj, y0;
+};
+
+/* where each transform finds cell (i, j) of its result in a w by h
+ * source: column xi * i + xj * j + xw * (w - 1), and likewise the row
+ */
+static const struct {
+    signed char xi, xj, xw;
+    signed char yi, yj, yh;
+} maps[] = {
+    [TRANSFORM_ROTATE_0]        = {  1,  0, 0,   0,  1, 0 },
+    [TRANSFORM_ROTATE_90]       = {  0,  1, 0,  -1,  0, 1 },
+    [TRANSFORM_ROTATE_180]      = { -1,  0, 1,   0, -1, 1 },
+    [TRANSFORM_ROTATE_270]      = {  0, -1, 1,   1,  0, 0 },
+    [TRANSFORM_FLIP_HORIZONTAL] = { -1,  0, 1,   0,  1, 0 },
+    [TRANSFORM_FLIP_VERTICAL]   = {  1,  0, 0,   0, -1, 1 },
+    [TRANSFORM_TRANSPOSE]       = {  0,  1, 0,   1,  0, 0 },
+    [TRANSFORM_TRANSVERSE]      = {  0, -1, 1,  -1,  0, 1 },
+};
+
+#define NTRANSFORMS ((int) (sizeof(maps) / sizeof(maps[0])))
+
+static inline int column_of(struct view *v, int i, int j)
+{
+    return v->xi * i + v->xj * j + v->x0;
+}
+
+static inline int row_of(struct view *v, int i, int j)
+{
+    return v->yi * i + v->yj * j + v->y0;
+}
+
+/* a view of the whole of 'array', cell for cell */
+static struct view *identity(A2 array, A2Methods_T methods, int owns)
+{
+    assert(array != NULL && methods != NULL);
+    struct view *v = malloc(sizeof(*v));
+    assert(v != NULL);
+    v->array = array;
+    v->methods = methods;
+    v->owns = owns;
+    v->width = methods->width(array);
+    v->height = methods->height(array);
+    v->xi = 1; v->xj = 0; v->x0 = 0;
+    v->yi = 0; v->yj = 1; v->y0 = 0;
+    return v;
+}
+
+A2 A2view_new(A2 array, A2Methods_T methods, Transform_T t)
+{
+    struct view *v = identity(array, methods, 0);
+    A2 view = A2view_transform(v, t);
+    free(v);
+    return view;
+}
+
+/* cell (i, j) of the new view is cell (p, q) = maps[t] of the old one,
+ * so substituting p and q into the old view's map gives the new map
+ */
+A2 A2view_transform(A2 view, Transform_T t)
+{
+    struct view *old = view;
+    assert(old != NULL);
+    assert((int) t >= 0 && (int) t < NTRANSFORMS);
+    struct view *v = malloc(sizeof(*v));
+    assert(v != NULL);
+    *v = *old;
+    v->owns = 0;
+    Transform_dimensions(t, old->width, old->height, &v->width, &v->height);
+
+    int p0 = maps[t].xw * (old->width - 1);
+    int q0 = maps[t].yh * (old->height - 1);
+    v->xi = old->xi * maps[t].xi + old->xj * maps[t].yi;
+    v->xj = old->xi * maps[t].xj + old->xj * maps[t].yj;
+    v->x0 = old->xi * p0 + old->xj * q0 + old->x0;
+    v->yi = old->yi * maps[t].xi + old->yj * maps[t].yi;
+    v->yj = old->yi * maps[t].xj + old->yj * maps[t].yj;
+    v->y0 = old->yi * p0 + old->yj * q0 + old->y0;
+    return v;
+}
+
+/* the offsets follow from the axes and the dimensions, so matching the
+ * axes is enough */
+Transform_T A2view_composed(A2 view)
+{
+    struct view *v = view;
+    assert(v != NULL);
+    for (int t = 0; t < NTRANSFORMS; t++) {
+        if (maps[t].xi == v->xi && maps[t].xj == v->xj
+            && maps[t].yi == v->yi && maps[t].yj == v->yj)
+            return (Transform_T) t;
+    }
+    assert(0);
+    return TRANSFORM_ROTATE_0;
+}
+
+A2 A2view_array(A2 view, A2Methods_T *methods)
+{
+    struct view *v = view;
+    assert(v != NULL && methods != NULL);
+    *methods = v->methods;
+    return v->array;
+}
+
+struct copy_closure {
+    struct view *view;
+    int          size;
+};
+
+static void copy_cell(int i, int j, A2 array2, void *elem, void *vcl)
+{
+    struct copy_closure *cl = vcl;
+    struct view *v = cl->view;
+    (void) array2;
+    memcpy(elem, v->methods->at(v->array, column_of(v, i, j),
+                                row_of(v, i, j)), cl->size);
+}
+
+A2 A2view_materialize(A2 view, A2Methods_T methods)
+{
+    struct view *v = view;
+    assert(v != NULL && methods != NULL);
+    int size = v->methods->size(v->array);
+    A2 result = methods->new(v->width, v->height, size);
+    if (methods == v->methods && methods->span_at != NULL) {
+        Transform_tiled(A2view_composed(v), methods, v->array, result);
+    } else {
+        struct copy_closure cl = { v, size };
+        methods->map_default(result, copy_cell, &cl);
+    }
+    return result;
+}
+
+/************************************************/
+/* The A2Methods_T functions of a view.         */
+/************************************************/
+
+static A2 new(int width, int height, int size)
+{
+    return identity(uarray2_methods_plain->new(width, height, size),
+                    uarray2_methods_plain, 1);
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+    (void) blocksize;
+    return new(width, height, size);
+}
+
+static void a2free(A2 *array2p)
+{
+    assert(array2p != NULL && *array2p != NULL);
+    struct view *v = *array2p;
+    if (v->owns)
+        v->methods->free(&v->array);
+    free(v);
+    *array2p = NULL;
+}
+
+static int width(A2 array2)
+{
+    struct view *v = array2;
+    assert(v != NULL);
+    return v->width;
+}
+
+static int height(A2 array2)
+{
+    struct view *v = array2;
+    assert(v != NULL);
+    return v->height;
+}
+
+static int size(A2 array2)
+{
+    struct view *v = array2;
+    assert(v != NULL);
+    return v->methods->size(v->array);
+}
+
+static int blocksize(A2 array2)
+{
+    (void) array2;
+    return 1;
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+    struct view *v = array2;
+    assert(v != NULL);
+    assert(i >= 0 && i < v->width && j >= 0 && j < v->height);
+    return v->methods->at(v->array, column_of(v, i, j), row_of(v, i, j));
+}
+
+static void map_row_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+    struct view *v = array2;
+    for (int j = 0; j < v->height; j++)
+        for (int i = 0; i < v->width; i++)
+            apply(i, j, array2, at(array2, i, j), cl);
+}
+
+static void map_col_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+    struct view *v = array2;
+    for (int i = 0; i < v->width; i++)
+        for (int j = 0; j < v->height; j++)
+            apply(i, j, array2, at(array2, i, j), cl);
+}
+
+/* the default order is the array's own, with each cell's indices taken
+ * back to the view's: the axes are a signed permutation, so the inverse
+ * map is its transpose
+ */
+struct default_closure {
+    struct view        *view;
+    A2Methods_applyfun *apply;
+    void               *cl;
+};
+
+static void apply_in_view(int x, int y, A2 array, void *elem, void *vcl)
+{
+    struct default_closure *cl = vcl;
+    struct view *v = cl->view;
+    (void) array;
+    int i = v->xi * (x - v->x0) + v->yi * (y - v->y0);
+    int j = v->xj * (x - v->x0) + v->yj * (y - v->y0);
+    cl->apply(i, j, v, elem, cl->cl);
+}
+
+static void map_default(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+    struct view *v = array2;
+    struct default_closure mycl = { v, apply, cl };
+    v->methods->map_default(v->array, apply_in_view, &mycl);
+}
+
+static void small_map_row_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+    struct view *v = a2;
+    for (int j = 0; j < v->height; j++)
+        for (int i = 0; i < v->width; i++)
+            apply(at(a2, i, j), cl);
+}
+
+static void small_map_col_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+    struct view *v = a2;
+    for (int i = 0; i < v->width; i++)
+        for (int j = 0; j < v->height; j++)
+            apply(at(a2, i, j), cl);
+}
+
+/* the order does not show, so the array's own is used */
+static void small_map_default(A2 a2, A2Methods_smallapplyfun apply,
+                              void *cl)
+{
+    struct view *v = a2;
+    v->methods->small_map_default(v->array, apply, cl);
+}
+
+/* cells along a row of the view are adjacent only where they are along a
+ * row of the array, left to right; otherwise a span is one cell
+ */
+static A2Methods_Object *span_at(A2 array2, int i, int j, int *n)
+{
+    struct view *v = array2;
+    assert(v != NULL);
+    assert(i >= 0 && i < v->width && j >= 0 && j < v->height);
+    int x = column_of(v, i, j);
+    int y = row_of(v, i, j);
+    if (v->xi == 1 && v->methods->span_at != NULL)
+        return v->methods->span_at(v->array, x, y, n);
+    *n = 1;
+    return v->methods->at(v->array, x, y);
+}
+
+static void map_span_row_major(A2 array2, A2Methods_spanfun apply, void *cl)
+{
+    struct view *v = array2;
+    for (int j = 0; j < v->height; j++) {
+        int n;
+        for (int i = 0; i < v->width; i += n) {
+            A2Methods_Object *first = span_at(array2, i, j, &n);
+            apply(i, j, n, A2Methods_ALONG_ROW, array2, first, cl);
+        }
+    }
+}
+
+/* a parallel map gives each row to one task of Workpool_map */
+struct parallel_closure {
+    struct view             *view;
+    A2Methods_applyfun      *apply;       /* one of apply and small_apply */
+    A2Methods_smallapplyfun *small_apply;
+};
+
+static void map_row(int j, void *cl, void *vp)
+{
+    struct parallel_closure *p = vp;
+    for (int i = 0; i < p->view->width; i++) {
+        A2Methods_Object *elem = at(p->view, i, j);
+        if (p->apply != NULL)
+            p->apply(i, j, p->view, elem, cl);
+        else
+            p->small_apply(elem, cl);
+    }
+}
+
+static void map_row_major_parallel(A2 array2, int nthreads,
+                                   A2Methods_closurefun *make_cl,
+                                   A2Methods_applyfun apply, void *cl)
+{
+    struct parallel_closure p = { array2, apply, NULL };
+    Workpool_map(nthreads, p.view->height, map_row, &p, make_cl, cl);
+}
+
+static void small_map_row_major_parallel(A2 a2, int nthreads,
+                                         A2Methods_closurefun *make_cl,
+                                         A2Methods_smallapplyfun apply,
+                                         void *cl)
+{
+    struct parallel_closure p = { a2, NULL, apply };
+    Workpool_map(nthreads, p.view->height, map_row, &p, make_cl, cl);
+}
+
+static void map_hilbert(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+    Hilbert_map(width(array2), height(array2), at, array2, apply, cl);
+}
+
+static void small_map_hilbert(A2 a2, A2Methods_smallapplyfun apply, void *cl)
+{
+    Hilbert_small_map(width(a2), height(a2), at, a2, apply, cl);
+}
+
+static struct A2Methods_T uarray2_methods_view_struct = {
+    new,
+    new_with_blocksize,
+    a2free,
+    width,
+    height,
+    size,
+    blocksize,
+    at,
+    map_row_major,
+    map_col_major,
+    NULL,                /* map_block_major */
+    map_default,
+    small_map_row_major,
+    small_map_col_major,
+    NULL,                /* small_map_block_major */
+    small_map_default,
+    span_at,
+    map_span_row_major,
+    NULL,                /* map_span_block_major */
+    map_span_row_major,  /* map_span_default */
+    map_row_major_parallel,
+    NULL,                /* map_block_major_parallel */
+    map_row_major_parallel, /* map_default_parallel */
+    small_map_row_major_parallel,
+    NULL,                /* small_map_block_major_parallel */
+    small_map_row_major_parallel, /* small_map_default_parallel */
+    map_hilbert,
+    small_map_hilbert,
+    NULL,                /* transpose */
+};
+
+A2Methods_T uarray2_methods_view = &uarray2_methods_view_struct;
@@ -0,0 +1,47 @@
+#ifndef A2VIEW_INCLUDED
+#define A2VIEW_INCLUDED
+
+#include <a2methods.h>
+#include "transform.h"
+
+#define A2 A2Methods_UArray2
+
+extern A2Methods_T uarray2_methods_view;  /* functions for transformed views */
+
+/* A view shows the cells of an array of another method suite through one
+ * of the transforms of transform.h: cell (i, j) of the view is the cell
+ * of the array that the transform moves to (i, j). Nothing is copied, and
+ * storing through a view stores into the array. Transforming a view
+ * composes the two transforms into one over the same array, so a chain
+ * of rotations and flips costs no more to read than a single one.
+ *
+ * The suite's 'new' makes a plain array for the view to own; any other
+ * view's array must outlive it, and freeing a view frees only the view
+ * (and the array, if the view owns it).
+ */
+
+/* view of 'array', which belongs to 'methods', through t */
+extern A2 A2view_new(A2 array, A2Methods_T methods, Transform_T t);
+
+/* a new view, of the same array, of the result of applying t to 'view' */
+extern A2 A2view_transform(A2 view, Transform_T t);
+
+/* the single transform that takes the array to the view */
+extern Transform_T A2view_composed(A2 view);
+
+/* the array the view shows; *methods is set to the array's methods */
+extern A2 A2view_array(A2 view, A2Methods_T *methods);
+
+/* a new array of 'methods' holding the view's cells: written with
+ * Transform_tiled when methods are the array's own, otherwise by mapping
+ * the new array in its default order and reading each cell through the
+ * view
+ */
+extern A2 A2view_materialize(A2 view, A2Methods_T methods);
+
+/*
+ * it is a checked run-time error to pass a NULL view
+ * to any function in this interface
+ */
+#undef A2
+#endif
@@ -0,0 +1,266 @@
+/* HW3 - Locality
+ * blocktune.c
+ * Function: Chooses how many bytes the blocks of a block-major array
+ *           occupy: from the machine's cache sizes to begin with, or from
+ *           a calibration that times block-major rotations and keeps the
+ *           fastest block size, saved to a small file between runs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "blocktune.h"
+#include "cacheinfo.h"
+#include "cputiming.h"
+#include "uarray2b.h"
+
+/* Name of the calibration file in the cache directory */
+#define CACHE_FILE "ppmtrans-blocksize"
+
+/* Calibration rotates an array of 4 byte cells, far larger than the
+ * level 2 cache, a few times with each candidate, keeping the best; its
+ * sides are not powers of two, like most images', so that blocks hang
+ * over the edges as they would in use */
+#define CALIBRATE_WIDTH  2000
+#define CALIBRATE_HEIGHT 1500
+#define CALIBRATE_CELL   4
+#define CALIBRATE_TRIALS 5
+
+/* Smallest candidate, in bytes; candidates double up to twice the
+ * level 2 cache */
+#define MIN_BLOCK_BYTES 4096
+
+/* Bytes per block in use, 0 until chosen */
+static long block_bytes = 0;
+
+static int default_path(char *path, size_t n, int make_dir);
+static double time_rotation(int blocksize);
+static void fill_cell(void *elem, void *cl);
+static void rotate_cell(int col, int row, UArray2b_T array2b, void *elem,
+                        void *cl);
+
+/* long Blocktune_block_bytes(void)
+ * Parameters: None
+ *    Returns: the bytes one block should occupy
+ *       Does: Unless a calibration was adopted, uses the size of the
+ *             level 1 data cache: a rotation reads one block a row at a
+ *             time and writes another a column at a time, and the lines
+ *             of the column it has begun stay in level 1 until they are
+ *             full; the pair of blocks is kept within a quarter of the
+ *             level 2 cache on machines where it is small
+ *   if Error: None
+ */
+long Blocktune_block_bytes(void)
+{
+        if (block_bytes > 0) {
+                return block_bytes;
+        }
+        long l1d = CacheInfo_l1d_size();
+        long eighth = CacheInfo_l2_size() / 8;
+        block_bytes = l1d < eighth ? l1d : eighth;
+        return block_bytes;
+}
+
+/* int Blocktune_blocksize(int size)
+ * Parameters: int size - bytes in one cell
+ *    Returns: the side of the largest square block of such cells that
+ *             fits in Blocktune_block_bytes, at least 1
+ *       Does: Computes the square root of the cells that fit
+ *   if Error: raises assertion if size is not positive
+ */
+int Blocktune_blocksize(int size)
+{
+        assert(size > 0);
+        long cells = Blocktune_block_bytes() / size;
+        int blocksize = (int) sqrt((double) cells);
+        return blocksize > 0 ? blocksize : 1;
+}
+
+/* int Blocktune_load(const char *path)
+ * Parameters: const char *path - calibration file, or NULL for the
+ *                                default one
+ *    Returns: nonzero if a calibration was adopted
+ *       Does: Reads the level 1 and level 2 cache sizes the calibration
+ *             was made with and its block bytes, and adopts the block
+ *             bytes if the caches match this machine's, so that a home
+ *             directory shared between machines does not carry one
+ *             machine's answer to another
+ *   if Error: returns 0 if the file is missing, malformed or stale
+ */
+int Blocktune_load(const char *path)
+{
+        char buf[4096];
+        if (path == NULL) {
+                if (!default_path(buf, sizeof(buf), 0)) {
+                        return 0;
+                }
+                path = buf;
+        }
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) {
+                return 0;
+        }
+        long l1d, l2, bytes;
+        int fields = fscanf(fp, "%ld %ld %ld", &l1d, &l2, &bytes);
+        fclose(fp);
+        if (fields != 3 || l1d != CacheInfo_l1d_size()
+                        || l2 != CacheInfo_l2_size() || bytes <= 0) {
+                return 0;
+        }
+        block_bytes = bytes;
+        return 1;
+}
+
+/* int Blocktune_save(const char *path)
+ * Parameters: const char *path - calibration file, or NULL for the
+ *                                default one
+ *    Returns: nonzero if the file was written
+ *       Does: Writes the cache sizes and the block bytes in use on one
+ *             line, making the default directory if needed
+ *   if Error: returns 0 if the file cannot be written
+ */
+int Blocktune_save(const char *path)
+{
+        char buf[4096];
+        if (path == NULL) {
+                if (!default_path(buf, sizeof(buf), 1)) {
+                        return 0;
+                }
+                path = buf;
+        }
+        FILE *fp = fopen(path, "w");
+        if (fp == NULL) {
+                return 0;
+        }
+        fprintf(fp, "%ld %ld %ld\n", CacheInfo_l1d_size(),
+                CacheInfo_l2_size(), Blocktune_block_bytes());
+        return fclose(fp) == 0;
+}
+
+/* long Blocktune_calibrate(void)
+ * Parameters: None
+ *    Returns: the bytes per block adopted
+ *       Does: Rotates an array 90 degrees block by block with blocks of
+ *             MIN_BLOCK_BYTES, twice that, and so on up to twice the
+ *             level 2 cache, and adopts the block size of the quickest
+ *             rotation
+ *   if Error: raises assertion if failed mallocing
+ */
+long Blocktune_calibrate(void)
+{
+        long limit = 2 * CacheInfo_l2_size();
+        long best_bytes = Blocktune_block_bytes();
+        double best_time = -1;
+        for (long bytes = MIN_BLOCK_BYTES; bytes <= limit; bytes *= 2) {
+                int blocksize = (int) sqrt((double) bytes / CALIBRATE_CELL);
+                double time = time_rotation(blocksize);
+                if (best_time < 0 || time < best_time) {
+                        best_time = time;
+                        best_bytes = bytes;
+                }
+        }
+        block_bytes = best_bytes;
+        return block_bytes;
+}
+
+/* static int default_path(char *path, size_t n, int make_dir)
+ * Parameters: char *path - filled in with the default calibration file
+ *             size_t n - bytes path can hold
+ *             int make_dir - nonzero to make $HOME/.cache if missing
+ *    Returns: nonzero if there is a default place
+ *       Does: Uses $XDG_CACHE_HOME if set, otherwise $HOME/.cache
+ *   if Error: returns 0 if neither variable is set or the path is too
+ *             long
+ */
+static int default_path(char *path, size_t n, int make_dir)
+{
+        const char *dir = getenv("XDG_CACHE_HOME");
+        int length;
+        if (dir != NULL && *dir != '\0') {
+                length = snprintf(path, n, "%s/%s", dir, CACHE_FILE);
+        } else {
+                const char *home = getenv("HOME");
+                if (home == NULL || *home == '\0') {
+                        return 0;
+                }
+                length = snprintf(path, n, "%s/.cache", home);
+                if (length < 0 || (size_t) length >= n) {
+                        return 0;
+                }
+                if (make_dir) {
+                        mkdir(path, 0700);  /* fails harmlessly if there */
+                }
+                length = snprintf(path, n, "%s/.cache/%s", home, CACHE_FILE);
+        }
+        return length >= 0 && (size_t) length < n;
+}
+
+/* static double time_rotation(int blocksize)
+ * Parameters: int blocksize - side of the blocks to try
+ *    Returns: nanoseconds the quickest of CALIBRATE_TRIALS block-major 90
+ *             degree rotations took
+ *       Does: Makes and fills a source and a destination array with the
+ *             given blocks and times mapping the one into the other
+ *   if Error: raises assertion if failed mallocing
+ */
+static double time_rotation(int blocksize)
+{
+        UArray2b_T src = UArray2b_new(CALIBRATE_WIDTH, CALIBRATE_HEIGHT,
+                                      CALIBRATE_CELL, blocksize);
+        UArray2b_T dst = UArray2b_new(CALIBRATE_HEIGHT, CALIBRATE_WIDTH,
+                                      CALIBRATE_CELL, blocksize);
+        unsigned count = 0;
+        UArray2b_small_map(src, fill_cell, &count);
+        UArray2b_small_map(dst, fill_cell, &count);
+
+        double fastest = -1;
+        CPUTime_T timer = CPUTime_New();
+        for (int trial = 0; trial < CALIBRATE_TRIALS; trial++) {
+                CPUTime_Start(timer);
+                UArray2b_map(src, rotate_cell, dst);
+                double time = CPUTime_Stop(timer);
+                if (fastest < 0 || time < fastest) {
+                        fastest = time;
+                }
+        }
+        CPUTime_Free(&timer);
+
+        UArray2b_free(&src);
+        UArray2b_free(&dst);
+        return fastest;
+}
+
+/* static void fill_cell(void *elem, void *cl)
+ * Parameters: void *elem - a cell
+ *             void *cl - pointer to a running count
+ *    Returns: Nothing
+ *       Does: Stores the count in the cell and counts up, so every page
+ *             of the arrays is touched before anything is timed
+ *   if Error: None
+ */
+static void fill_cell(void *elem, void *cl)
+{
+        unsigned *count = cl;
+        *(unsigned *) elem = (*count)++;
+}
+
+/* static void rotate_cell(int col, int row, UArray2b_T array2b,
+ *                         void *elem, void *cl)
+ * Parameters: int col, int row - the source cell's place
+ *             UArray2b_T array2b - the source array
+ *             void *elem - the source cell
+ *             void *cl - the destination array
+ *    Returns: Nothing
+ *       Does: Copies the cell to where a 90 degree rotation puts it
+ *   if Error: None
+ */
+static void rotate_cell(int col, int row, UArray2b_T array2b, void *elem,
+                        void *cl)
+{
+        UArray2b_T dst = cl;
+        int height = UArray2b_height(array2b);
+        *(unsigned *) UArray2b_at(dst, height - row - 1, col) =
+                *(unsigned *) elem;
+}
@@ -0,0 +1,35 @@
+#ifndef BLOCKTUNE_INCLUDED
+#define BLOCKTUNE_INCLUDED
+
+/* The size of the blocks of block-major arrays on this machine. Until a
+ * calibration is loaded or run, blocks are sized from the cache geometry
+ * cacheinfo.h reports; a calibration times block-major rotations with a
+ * range of block sizes and keeps the fastest, and can be saved to a small
+ * file so that later runs start with it.
+ */
+
+/* bytes one block should occupy */
+extern long Blocktune_block_bytes(void);
+
+/* cells along one side of a block of cells of 'size' bytes, at least 1
+ * (checked runtime error if size is not positive)
+ */
+extern int  Blocktune_blocksize(int size);
+
+/* adopts the calibration saved in the file at 'path', or at the default
+ * place ($XDG_CACHE_HOME, else $HOME/.cache) if path is NULL; returns
+ * nonzero if there was one, made on a machine with the same caches
+ */
+extern int  Blocktune_load(const char *path);
+
+/* saves the block size in use to 'path' (NULL for the default place);
+ * returns nonzero on success
+ */
+extern int  Blocktune_save(const char *path);
+
+/* times rotations with each candidate block size, adopts the fastest and
+ * returns its bytes
+ */
+extern long Blocktune_calibrate(void);
+
+#endif
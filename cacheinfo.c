@@ -0,0 +1,165 @@
+/* HW3 - Locality
+ * cacheinfo.c
+ * Function: Reports the cache geometry of the machine, first asking
+ *           sysconf and then the sysfs description of cpu0's caches,
+ *           so that kernels can size their working sets to the caches
+ *           instead of to a fixed constant
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "cacheinfo.h"
+
+/* Used when neither sysconf nor sysfs know the answer */
+#define DEFAULT_LINE_SIZE 64
+#define DEFAULT_L1D_SIZE  (32 * 1024)
+#define DEFAULT_L2_SIZE   (256 * 1024)
+
+static long sysfs_cache_value(int level, const char *type, 
+                              const char *field);
+
+/* long CacheInfo_line_size(void)
+ * Parameters: None
+ *    Returns: number of bytes in a cache line
+ *       Does: Asks sysconf, then sysfs, defaulting to 64 bytes
+ *   if Error: None
+ */
+long CacheInfo_line_size(void)
+{
+        static long line_size = 0;
+        if (line_size > 0) {
+                return line_size;
+        }
+
+        long found = -1;
+#ifdef _SC_LEVEL1_DCACHE_LINESIZE
+        found = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+#endif
+        if (found <= 0) {
+                found = sysfs_cache_value(1, "Data", "coherency_line_size");
+        }
+        line_size = found > 0 ? found : DEFAULT_LINE_SIZE;
+        return line_size;
+}
+
+/* long CacheInfo_l1d_size(void)
+ * Parameters: None
+ *    Returns: number of bytes in the level 1 data cache
+ *       Does: Asks sysconf, then sysfs, defaulting to 32KB
+ *   if Error: None
+ */
+long CacheInfo_l1d_size(void)
+{
+        static long l1d_size = 0;
+        if (l1d_size > 0) {
+                return l1d_size;
+        }
+
+        long found = -1;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+        found = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+#endif
+        if (found <= 0) {
+                found = sysfs_cache_value(1, "Data", "size");
+        }
+        l1d_size = found > 0 ? found : DEFAULT_L1D_SIZE;
+        return l1d_size;
+}
+
+/* long CacheInfo_l2_size(void)
+ * Parameters: None
+ *    Returns: number of bytes in the level 2 cache
+ *       Does: Asks sysconf, then sysfs, defaulting to 256KB; never
+ *             reports less than the level 1 data cache
+ *   if Error: None
+ */
+long CacheInfo_l2_size(void)
+{
+        static long l2_size = 0;
+        if (l2_size > 0) {
+                return l2_size;
+        }
+
+        long found = -1;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+        found = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+        if (found <= 0) {
+                found = sysfs_cache_value(2, "Unified", "size");
+        }
+        if (found <= 0) {
+                found = DEFAULT_L2_SIZE;
+        }
+        l2_size = found > CacheInfo_l1d_size() ? found : CacheInfo_l1d_size();
+        return l2_size;
+}
+
+/* static long sysfs_cache_value(int level, const char *type, 
+ *                               const char *field)
+ * Parameters: int level - cache level wanted (1 for L1)
+ *             const char *type - cache type wanted ("Data" or "Unified")
+ *             const char *field - file to read from the cache's directory
+ *    Returns: the value of the field in bytes, or -1 if not found
+ *       Does: Scans /sys/devices/system/cpu/cpu0/cache/index* for the 
+ *             cache with the given level and type and reads one of its
+ *             fields, understanding a K or M suffix
+ *   if Error: returns -1
+ */
+static long sysfs_cache_value(int level, const char *type, 
+                              const char *field)
+{
+        char path[128];
+        for (int index = 0; index < 16; index++) {
+                int found_level = -1;
+                char found_type[32] = "";
+                FILE *fp;
+
+                snprintf(path, sizeof(path), 
+                         "/sys/devices/system/cpu/cpu0/cache/index%d/level",
+                         index);
+                fp = fopen(path, "r");
+                if (fp == NULL) {
+                        return -1;      /* no more caches described */
+                }
+                if (fscanf(fp, "%d", &found_level) != 1) {
+                        found_level = -1;
+                }
+                fclose(fp);
+
+                snprintf(path, sizeof(path), 
+                         "/sys/devices/system/cpu/cpu0/cache/index%d/type",
+                         index);
+                fp = fopen(path, "r");
+                if (fp != NULL) {
+                        if (fscanf(fp, "%31s", found_type) != 1) {
+                                found_type[0] = '\0';
+                        }
+                        fclose(fp);
+                }
+                if (found_level != level || strcmp(found_type, type) != 0) {
+                        continue;
+                }
+
+                long value = -1;
+                char suffix = '\0';
+                snprintf(path, sizeof(path), 
+                         "/sys/devices/system/cpu/cpu0/cache/index%d/%s",
+                         index, field);
+                fp = fopen(path, "r");
+                if (fp == NULL) {
+                        return -1;
+                }
+                if (fscanf(fp, "%ld%c", &value, &suffix) < 1) {
+                        value = -1;
+                }
+                fclose(fp);
+                if (suffix == 'K') {
+                        value *= 1024;
+                } else if (suffix == 'M') {
+                        value *= 1024 * 1024;
+                }
+                return value;
+        }
+        return -1;
+}
@@ -0,0 +1,18 @@
+#ifndef CACHEINFO_INCLUDED
+#define CACHEINFO_INCLUDED
+
+/* Geometry of the data caches of the machine we are running on, as
+ * reported by the C library or sysfs. Each query falls back to a
+ * conservative default when the machine does not report the value.
+ */
+
+/* bytes in one cache line */
+extern long CacheInfo_line_size(void);
+
+/* bytes in the level 1 data cache of one core */
+extern long CacheInfo_l1d_size(void);
+
+/* bytes in the level 2 cache of one core */
+extern long CacheInfo_l2_size(void);
+
+#endif
@@ -0,0 +1,270 @@
+/* HW3 - Locality
+ * hilbert.c
+ * Function: Generates the cells of an array in Hilbert curve order, one
+ *           after another, without recursion: the place of the next
+ *           cell along the curve is found by counting in base 4, and
+ *           only the levels of the curve whose digit changed are
+ *           worked out again.
+ */
+
+#include <stdlib.h>
+#include "assert.h"
+#include "hilbert.h"
+
+#define T Hilbert_T
+
+/* Most levels a tile's curve has: tiles are at most 2^15 cells across */
+#define MAX_LEVELS 15
+
+/* Orientations of a curve: bit 0 swaps x and y, bit 1 turns the curve
+ * half way round (x becomes 1 - x and y becomes 1 - y); the two commute,
+ * so combining orientations is exclusive or
+ */
+#define SWAP 1
+#define TURN 2
+
+/* Quadrant (x, y) of digit d of a curve in orientation 0, which runs
+ * from the top left corner down, across and up to the top right */
+static const unsigned char base_x[4] = { 0, 0, 1, 1 };
+static const unsigned char base_y[4] = { 0, 1, 1, 0 };
+
+/* Orientation of the curve in quadrant d, relative to its parent's */
+static const unsigned char child[4] = { SWAP, 0, 0, SWAP | TURN };
+
+/* Hilbert_T (uses the defined macro T)
+ * Purpose: Where the order is up to
+ * Data Structure: the array is covered by tiles_across * tiles_down
+ *                 tiles of side 2^levels, visited a row of tiles at a
+ *                 time (a column at a time if 'tall'); the curve of a
+ *                 tile has one base 4 digit per level, the top level
+ *                 first, and 'orient' holds the orientation of the curve
+ *                 each digit of 'd' is read in
+ * Math for Indexing: digit l of d picks a quadrant of a square of side
+ *                    2^(l + 1), which sets bit l of the cell's x and y
+ */
+struct T {
+        int width, height;
+        int levels;             /* of each tile's curve */
+        int tall;               /* tiles go down the columns first */
+        int tiles_across, tiles_down;
+        int tile;               /* number of the tile being walked */
+        int x0, y0;             /* its top left cell */
+        long d;                 /* place along its curve, -1 to start */
+        long last;              /* place of its last cell */
+        int x, y;               /* cell d of the curve, within the tile */
+        unsigned char orient[MAX_LEVELS];
+};
+
+static void start_tile(T hilbert);
+static void set_levels(T hilbert, int top, int digit);
+
+/* T Hilbert_new(int width, int height)
+ * Parameters: int width, int height - dimensions of the array
+ *    Returns: a new order, positioned before the first cell
+ *       Does: Picks the largest power of two tile side that fits in the
+ *             shorter dimension, halving it while the tiles would cover
+ *             more than a quarter again as many cells as the array has
+ *   if Error: raises assertions
+ *             if width or height is negative
+ *             if failed mallocing
+ */
+T Hilbert_new(int width, int height)
+{
+        assert(width >= 0 && height >= 0);
+        T hilbert = malloc(sizeof(*hilbert));
+        assert(hilbert != NULL);
+        hilbert->width = width;
+        hilbert->height = height;
+        hilbert->tall = height > width;
+
+        int shorter = width < height ? width : height;
+        int levels = 0;
+        while (levels < MAX_LEVELS && 2 << levels <= shorter) {
+                levels++;
+        }
+        long cells = (long) width * height;
+        for (;;) {
+                long side = 1L << levels;
+                long across = (width + side - 1) / side;
+                long down = (height + side - 1) / side;
+                if (levels == 0 || across * down * side * side
+                                   <= cells + cells / 4) {
+                        break;
+                }
+                levels--;
+        }
+        int side = 1 << levels;
+        hilbert->levels = levels;
+        hilbert->tiles_across = (width + side - 1) / side;
+        hilbert->tiles_down = (height + side - 1) / side;
+        hilbert->tile = 0;
+        start_tile(hilbert);
+        return hilbert;
+}
+
+/* void Hilbert_free(T *hilbert)
+ * Parameters: T *hilbert - the order to free
+ *    Returns: Nothing
+ *       Does: Frees it and overwrites the pointer with NULL
+ *   if Error: raises assertion if hilbert or *hilbert is null
+ */
+void Hilbert_free(T *hilbert)
+{
+        assert(hilbert != NULL && *hilbert != NULL);
+        free(*hilbert);
+        *hilbert = NULL;
+}
+
+/* int Hilbert_next(T hilbert, int *i, int *j)
+ * Parameters: T hilbert - the order
+ *             int *i, int *j - set to the next cell
+ *    Returns: nonzero if there was a next cell, 0 at the end
+ *       Does: Adds one to the place along the tile's curve: the lowest
+ *             digit that is not 3 goes up by one, the digits below it
+ *             become 0, and only those levels are worked out again.
+ *             Cells of edge tiles that lie outside the array are passed
+ *             over, and after a tile's last cell comes the next tile's
+ *             first
+ *   if Error: raises assertion if hilbert, i or j is null
+ */
+int Hilbert_next(T hilbert, int *i, int *j)
+{
+        assert(hilbert != NULL && i != NULL && j != NULL);
+        int tiles = hilbert->tiles_across * hilbert->tiles_down;
+        while (hilbert->tile < tiles) {
+                if (hilbert->d == hilbert->last) {
+                        hilbert->tile++;
+                        start_tile(hilbert);
+                        continue;
+                }
+                if (hilbert->d < 0) {
+                        hilbert->d = 0;
+                        hilbert->x = hilbert->y = 0;
+                        if (hilbert->levels > 0) {
+                                set_levels(hilbert, hilbert->levels - 1, 0);
+                        }
+                } else {
+                        long d = ++hilbert->d;
+                        int level = 0;
+                        while (((d >> (2 * level)) & 3) == 0) {
+                                level++;
+                        }
+                        set_levels(hilbert, level, (d >> (2 * level)) & 3);
+                }
+                int x = hilbert->x0 + hilbert->x;
+                int y = hilbert->y0 + hilbert->y;
+                if (x < hilbert->width && y < hilbert->height) {
+                        *i = x;
+                        *j = y;
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+/* void Hilbert_map(int width, int height, Hilbert_atfun *at,
+ *                  A2Methods_UArray2 array2, A2Methods_applyfun apply,
+ *                  void *cl)
+ * void Hilbert_small_map(int width, int height, Hilbert_atfun *at,
+ *                        A2Methods_UArray2 array2,
+ *                        A2Methods_smallapplyfun apply, void *cl)
+ * Parameters: int width, int height - dimensions of array2
+ *             Hilbert_atfun *at - finds a cell of array2
+ *             A2Methods_UArray2 array2 - the array mapped
+ *             apply, void *cl - called on each cell, with cl
+ *    Returns: Nothing
+ *       Does: Walks an order of the array's dimensions and calls apply
+ *             on each cell it gives
+ *   if Error: raises assertion if at or apply is null
+ */
+void Hilbert_map(int width, int height, Hilbert_atfun *at,
+                 A2Methods_UArray2 array2, A2Methods_applyfun apply,
+                 void *cl)
+{
+        assert(at != NULL && apply != NULL);
+        T order = Hilbert_new(width, height);
+        int i, j;
+        while (Hilbert_next(order, &i, &j)) {
+                apply(i, j, array2, at(array2, i, j), cl);
+        }
+        Hilbert_free(&order);
+}
+
+void Hilbert_small_map(int width, int height, Hilbert_atfun *at,
+                       A2Methods_UArray2 array2,
+                       A2Methods_smallapplyfun apply, void *cl)
+{
+        assert(at != NULL && apply != NULL);
+        T order = Hilbert_new(width, height);
+        int i, j;
+        while (Hilbert_next(order, &i, &j)) {
+                apply(at(array2, i, j), cl);
+        }
+        Hilbert_free(&order);
+}
+
+/* static void start_tile(T hilbert)
+ * Parameters: T hilbert - the order, with 'tile' set
+ *    Returns: Nothing
+ *       Does: Finds the tile's corner and orientation and puts the order
+ *             before its first cell. Tiles along a row run across their
+ *             top edge, and tiles down a column down their left edge, so
+ *             each starts next to where the one before ended
+ *   if Error: None
+ */
+static void start_tile(T hilbert)
+{
+        int tile = hilbert->tile;
+        if (tile >= hilbert->tiles_across * hilbert->tiles_down) {
+                return;
+        }
+        int across = hilbert->tall ? tile / hilbert->tiles_down
+                                   : tile % hilbert->tiles_across;
+        int down = hilbert->tall ? tile % hilbert->tiles_down
+                                 : tile / hilbert->tiles_across;
+        hilbert->x0 = across << hilbert->levels;
+        hilbert->y0 = down << hilbert->levels;
+        hilbert->d = -1;
+        hilbert->last = (1L << (2 * hilbert->levels)) - 1;
+        if (hilbert->levels > 0) {
+                hilbert->orient[hilbert->levels - 1] = hilbert->tall ? SWAP
+                                                                     : 0;
+        }
+}
+
+/* static void set_levels(T hilbert, int top, int digit)
+ * Parameters: T hilbert - the order
+ *             int top - highest level whose digit changed
+ *             int digit - its new digit; every lower digit is 0
+ *    Returns: Nothing
+ *       Does: Sets bits top down to 0 of x and y, and the orientations
+ *             of the levels below top, from the orientation of top
+ *   if Error: None
+ */
+static void set_levels(T hilbert, int top, int digit)
+{
+        unsigned mask = (2u << top) - 1;
+        int x = hilbert->x & ~mask;
+        int y = hilbert->y & ~mask;
+        for (int level = top; level >= 0; level--, digit = 0) {
+                int orient = hilbert->orient[level];
+                int bx = base_x[digit];
+                int by = base_y[digit];
+                if (orient & SWAP) {
+                        int swapped = bx;
+                        bx = by;
+                        by = swapped;
+                }
+                if (orient & TURN) {
+                        bx ^= 1;
+                        by ^= 1;
+                }
+                x |= bx << level;
+                y |= by << level;
+                if (level > 0) {
+                        hilbert->orient[level - 1] = orient ^ child[digit];
+                }
+        }
+        hilbert->x = x;
+        hilbert->y = y;
+}
@@ -0,0 +1,50 @@
+#ifndef HILBERT_INCLUDED
+#define HILBERT_INCLUDED
+
+#include "a2methods.h"
+
+#define T Hilbert_T
+typedef struct T *T;
+
+/* An order of the cells of a width by height array along Hilbert curves:
+ * the array is covered by square tiles with a power of two side, each
+ * walked along a Hilbert curve that enters at one corner and leaves at
+ * the next, so that consecutive tiles join up, and cells close together
+ * in the order are close together in both dimensions. The cells are
+ * made one at a time, each from the one before, in amortized constant
+ * time.
+ */
+
+/* starts the order of an array of the given dimensions
+ * (checked runtime error if either is negative)
+ */
+extern T    Hilbert_new (int width, int height);
+extern void Hilbert_free(T *hilbert);
+
+/* sets *i and *j to the column and row of the next cell and returns
+ * nonzero, or returns 0 once every cell has been given
+ */
+extern int  Hilbert_next(T hilbert, int *i, int *j);
+
+/* the 'at' of a methods suite: the cell at column i, row j of array2 */
+typedef A2Methods_Object *Hilbert_atfun(A2Methods_UArray2 array2, int i,
+                                        int j);
+
+/* call apply on every cell of array2, a width by height array whose
+ * cells 'at' finds, in Hilbert order; the order is the same whatever
+ * the array's layout, so every methods suite maps it with these
+ * (checked runtime error if at or apply is NULL)
+ */
+extern void Hilbert_map      (int width, int height, Hilbert_atfun *at,
+                              A2Methods_UArray2 array2,
+                              A2Methods_applyfun apply, void *cl);
+extern void Hilbert_small_map(int width, int height, Hilbert_atfun *at,
+                              A2Methods_UArray2 array2,
+                              A2Methods_smallapplyfun apply, void *cl);
+
+/*
+ * it is a checked run-time error to pass a NULL T
+ * to any function in this interface
+ */
+#undef T
+#endif
@@ -0,0 +1,405 @@
+/* HW3 - Locality
+ * outofcore.c
+ * Function: Transforming an image that does not fit in memory. Bands of
+ *           source rows are transformed one at a time into pieces of the
+ *           result, which are written straight out when they come in
+ *           the result's row order and otherwise spilled to a scratch
+ *           file and gathered back, a band of result rows at a time, by
+ *           a second pass.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "assert.h"
+#include "mem.h"
+#include "cputiming.h"
+#include "outofcore.h"
+
+#define A2 A2Methods_UArray2
+
+/* Bytes moved between the arrays and the scratch file per read or write,
+ * unless a single row is longer */
+#define IO_BYTES (1 << 20)
+
+/* struct outofcore
+ * Purpose: One out-of-core transformation. A band of band_rows source
+ *          rows starting at row j0 becomes a piece of the result which
+ *          is spilled, rows of it one after another, at byte
+ *          j0 * width * size of the scratch file
+ */
+struct outofcore {
+        Transform_T t;
+        A2Methods_T methods;
+        int size;
+        size_t max_memory;
+        Ppmread_T reader;
+        Ppmwrite_T writer;
+        int width, height;              /* of the source */
+        int out_width, out_height;
+        int band_rows;
+        int fd;                         /* the scratch file */
+        char *io;                       /* holds bytes read or written */
+        size_t io_bytes;
+};
+
+static void spill_piece(struct outofcore *o, A2 piece, int j0);
+static void gather_band(struct outofcore *o, A2 band, int y0);
+static void piece_rect(struct outofcore *o, int j0, int *x0, int *x1,
+                       int *y0, int *y1);
+static int rows_within(struct outofcore *o, long row_bytes);
+static void fit(struct outofcore *o, A2 *array, int width, int height);
+static int open_scratch(const char *dir);
+static void write_all(int fd, const char *buf, size_t n, off_t offset);
+static void read_all(int fd, char *buf, size_t n, off_t offset);
+static void row_to_bytes(A2Methods_T methods, A2 array, int y, char *to);
+static void bytes_to_row(A2Methods_T methods, A2 array, int x0, int y,
+                         const char *from, int n);
+
+/* double Outofcore_run(Transform_T t, A2Methods_T methods, int size,
+ *                      Ppmread_T reader, Ppmwrite_T writer,
+ *                      size_t max_memory, const char *scratch_dir)
+ * Parameters: Transform_T t - the transformation
+ *             A2Methods_T methods - methods of the bands
+ *             int size - cell size of the bands
+ *             Ppmread_T reader - the input, no rows read yet
+ *             Ppmwrite_T writer - the output, no rows written yet
+ *             size_t max_memory - bytes of cells to hold at most
+ *             const char *scratch_dir - where to make the scratch file
+ *    Returns: CPU time of the transform, in nanoseconds
+ *       Does: Reads bands small enough that a band and its piece fit in
+ *             max_memory. Pieces of transformations that keep the rows
+ *             in order go straight to the writer, and so do those of 180
+ *             degrees and the vertical flip when the reader can start at
+ *             the bottom band; otherwise every piece is spilled and the
+ *             result gathered in a second pass
+ *   if Error: raises assertions
+ *             if an argument is null
+ *             if the scratch file cannot be made, read or written
+ *             if the input ends early or holds a bad number
+ */
+double Outofcore_run(Transform_T t, A2Methods_T methods, int size,
+                     Ppmread_T reader, Ppmwrite_T writer,
+                     size_t max_memory, const char *scratch_dir)
+{
+        assert(methods != NULL && reader != NULL && writer != NULL);
+        assert(scratch_dir != NULL);
+        struct outofcore o;
+        o.t = t;
+        o.methods = methods;
+        o.size = size;
+        o.max_memory = max_memory;
+        o.reader = reader;
+        o.writer = writer;
+        o.width = Ppmread_width(reader);
+        o.height = Ppmread_height(reader);
+        Transform_dimensions(t, o.width, o.height, &o.out_width,
+                             &o.out_height);
+        o.band_rows = rows_within(&o, 2L * o.width * size);
+
+        int direct = !Transform_swaps(t) && (!Transform_flips_rows(t)
+                                             || Ppmread_seek(reader, 0));
+        int backwards = direct && Transform_flips_rows(t);
+        o.fd = -1;
+        o.io = NULL;
+        if (!direct) {
+                o.fd = open_scratch(scratch_dir);
+                int widest = o.width > o.out_width ? o.width : o.out_width;
+                o.io_bytes = IO_BYTES;
+                if ((size_t) widest * size > o.io_bytes) {
+                        o.io_bytes = (size_t) widest * size;
+                }
+                o.io = ALLOC(o.io_bytes);
+        }
+
+        /* Pass one: source bands in, pieces out */
+        CPUTime_T timer = CPUTime_New();
+        double elapsed = 0;
+        A2 band = NULL, piece = NULL;
+        for (int done = 0; done < o.height; done += o.band_rows) {
+                int rows = o.height - done < o.band_rows
+                           ? o.height - done : o.band_rows;
+                int j0 = done;
+                if (backwards) {
+                        j0 = o.height - done - rows;
+                        Ppmread_seek(reader, j0);
+                }
+                fit(&o, &band, o.width, rows);
+                int whole = Ppmread_rows(reader, methods, band, 0, rows);
+                assert(whole);
+
+                int piece_width, piece_height;
+                Transform_dimensions(t, o.width, rows, &piece_width,
+                                     &piece_height);
+                fit(&o, &piece, piece_width, piece_height);
+                CPUTime_Start(timer);
+                Transform_tiled(t, methods, band, piece);
+                elapsed += CPUTime_Stop(timer);
+
+                if (direct) {
+                        Ppmwrite_rows(writer, methods, piece, 0,
+                                      piece_height);
+                } else {
+                        spill_piece(&o, piece, j0);
+                }
+        }
+        methods->free(&band);
+        methods->free(&piece);
+        CPUTime_Free(&timer);
+        if (direct) {
+                return elapsed;
+        }
+
+        /* Pass two: bands of the result gathered from every piece */
+        int out_rows = rows_within(&o, (long) o.out_width * size);
+        A2 out = NULL;
+        for (int y0 = 0; y0 < o.out_height; y0 += out_rows) {
+                int rows = o.out_height - y0 < out_rows
+                           ? o.out_height - y0 : out_rows;
+                fit(&o, &out, o.out_width, rows);
+                gather_band(&o, out, y0);
+                Ppmwrite_rows(writer, methods, out, 0, rows);
+        }
+        methods->free(&out);
+        FREE(o.io);
+        close(o.fd);
+        return elapsed;
+}
+
+/* static void spill_piece(struct outofcore *o, A2 piece, int j0)
+ * Parameters: struct outofcore *o - the transformation
+ *             A2 piece - the piece made from the band at source row j0
+ *             int j0 - the band's first source row
+ *    Returns: Nothing
+ *       Does: Writes the rows of the piece, cells side by side, to the
+ *             piece's place in the scratch file, as few large writes as
+ *             the io buffer allows
+ *   if Error: raises the assertions of write_all
+ */
+static void spill_piece(struct outofcore *o, A2 piece, int j0)
+{
+        A2Methods_T methods = o->methods;
+        size_t row_bytes = (size_t) methods->width(piece) * o->size;
+        int height = methods->height(piece);
+        off_t offset = (off_t) j0 * o->width * o->size;
+        size_t used = 0;
+        for (int y = 0; y < height; y++) {
+                if (used + row_bytes > o->io_bytes) {
+                        write_all(o->fd, o->io, used, offset);
+                        offset += used;
+                        used = 0;
+                }
+                row_to_bytes(methods, piece, y, o->io + used);
+                used += row_bytes;
+        }
+        write_all(o->fd, o->io, used, offset);
+}
+
+/* static void gather_band(struct outofcore *o, A2 band, int y0)
+ * Parameters: struct outofcore *o - the transformation
+ *             A2 band - rows y0 onwards of the result, filled in
+ *             int y0 - result row held in row 0 of band
+ *    Returns: Nothing
+ *       Does: For every piece, reads the rows it shares with the band,
+ *             which lie together in the scratch file, and copies them to
+ *             the piece's columns of the band
+ *   if Error: raises the assertions of read_all
+ */
+static void gather_band(struct outofcore *o, A2 band, int y0)
+{
+        A2Methods_T methods = o->methods;
+        int y1 = y0 + methods->height(band);
+        for (int j0 = 0; j0 < o->height; j0 += o->band_rows) {
+                int px0, px1, py0, py1;
+                piece_rect(o, j0, &px0, &px1, &py0, &py1);
+                int first = py0 > y0 ? py0 : y0;
+                int last = py1 < y1 ? py1 : y1;
+                size_t row_bytes = (size_t) (px1 - px0) * o->size;
+                int batch = o->io_bytes / row_bytes;
+                for (int y = first; y < last; y += batch) {
+                        int rows = last - y < batch ? last - y : batch;
+                        off_t offset = (off_t) j0 * o->width * o->size
+                                       + (off_t) (y - py0) * row_bytes;
+                        read_all(o->fd, o->io, rows * row_bytes, offset);
+                        for (int r = 0; r < rows; r++) {
+                                bytes_to_row(methods, band, px0,
+                                             y + r - y0,
+                                             o->io + r * row_bytes,
+                                             px1 - px0);
+                        }
+                }
+        }
+}
+
+/* static void piece_rect(struct outofcore *o, int j0, int *x0, int *x1,
+ *                        int *y0, int *y1)
+ * Parameters: struct outofcore *o - the transformation
+ *             int j0 - first source row of a band
+ *             int *x0, int *x1, int *y0, int *y1 - set to the columns
+ *                     and rows of the result that the band's piece fills
+ *    Returns: Nothing
+ *       Does: The band's rows land in a range of result columns when the
+ *             transformation swaps and of result rows otherwise, counted
+ *             from the far end when it flips rows
+ *   if Error: None
+ */
+static void piece_rect(struct outofcore *o, int j0, int *x0, int *x1,
+                       int *y0, int *y1)
+{
+        int lo = j0;
+        int hi = j0 + o->band_rows < o->height ? j0 + o->band_rows
+                                               : o->height;
+        if (Transform_flips_rows(o->t)) {
+                int flipped = o->height - hi;
+                hi = o->height - lo;
+                lo = flipped;
+        }
+        if (Transform_swaps(o->t)) {
+                *x0 = lo;
+                *x1 = hi;
+                *y0 = 0;
+                *y1 = o->out_height;
+        } else {
+                *x0 = 0;
+                *x1 = o->out_width;
+                *y0 = lo;
+                *y1 = hi;
+        }
+}
+
+/* static int rows_within(struct outofcore *o, long row_bytes)
+ * Parameters: struct outofcore *o - the transformation
+ *             long row_bytes - bytes a row of the band costs
+ *    Returns: rows that fit in max_memory, a whole number of block rows
+ *             when the arrays are blocked, and at least one block row
+ *   if Error: None
+ */
+static int rows_within(struct outofcore *o, long row_bytes)
+{
+        A2 probe = o->methods->new(1, 1, o->size);
+        int blocksize = o->methods->blocksize(probe);
+        o->methods->free(&probe);
+        size_t rows = o->max_memory / row_bytes;
+        size_t longest = o->height > o->width ? o->height : o->width;
+        if (rows > longest) {           /* a band of the whole image */
+                rows = longest;
+        }
+        int whole = rows - rows % blocksize;
+        return whole > blocksize ? whole : blocksize;
+}
+
+/* static void fit(struct outofcore *o, A2 *array, int width, int height)
+ * Parameters: struct outofcore *o - the transformation
+ *             A2 *array - an array of o's methods, or NULL
+ *             int width, int height - dimensions it must have
+ *    Returns: Nothing
+ *       Does: Keeps *array if it has the dimensions, which is every time
+ *             but the first and the last, and otherwise replaces it
+ *   if Error: None
+ */
+static void fit(struct outofcore *o, A2 *array, int width, int height)
+{
+        A2Methods_T methods = o->methods;
+        if (*array != NULL && methods->width(*array) == width
+            && methods->height(*array) == height) {
+                return;
+        }
+        if (*array != NULL) {
+                methods->free(array);
+        }
+        *array = methods->new(width, height, o->size);
+}
+
+/* static int open_scratch(const char *dir)
+ * Parameters: const char *dir - directory to make the file in
+ *    Returns: a descriptor of a new, empty file open for reading and
+ *             writing, already unlinked so that it goes away with us
+ *   if Error: raises assertion if the file cannot be made
+ */
+static int open_scratch(const char *dir)
+{
+        static const char name[] = "/ppmtrans-XXXXXX";
+        char *path = ALLOC(strlen(dir) + sizeof(name));
+        strcpy(path, dir);
+        strcat(path, name);
+        int fd = mkstemp(path);
+        assert(fd >= 0);
+        unlink(path);
+        FREE(path);
+        return fd;
+}
+
+/* static void write_all(int fd, const char *buf, size_t n, off_t offset)
+ * static void read_all(int fd, char *buf, size_t n, off_t offset)
+ * Parameters: int fd - the scratch file
+ *             buf - the bytes
+ *             size_t n - how many
+ *             off_t offset - where in the file
+ *    Returns: Nothing
+ *       Does: Repeats pwrite or pread until all n bytes are moved
+ *   if Error: raises assertion if the file cannot be written or read, or
+ *             ends early
+ */
+static void write_all(int fd, const char *buf, size_t n, off_t offset)
+{
+        while (n > 0) {
+                ssize_t moved = pwrite(fd, buf, n, offset);
+                assert(moved > 0);
+                buf += moved;
+                n -= moved;
+                offset += moved;
+        }
+}
+
+static void read_all(int fd, char *buf, size_t n, off_t offset)
+{
+        while (n > 0) {
+                ssize_t moved = pread(fd, buf, n, offset);
+                assert(moved > 0);
+                buf += moved;
+                n -= moved;
+                offset += moved;
+        }
+}
+
+/* static void row_to_bytes(A2Methods_T methods, A2 array, int y,
+ *                          char *to)
+ * static void bytes_to_row(A2Methods_T methods, A2 array, int x0, int y,
+ *                          const char *from, int n)
+ * Parameters: A2Methods_T methods - methods of array
+ *             A2 array - the array
+ *             int x0, int y - first cell of the row to fill
+ *             to, from - cells side by side
+ *             int n - cells to fill
+ *    Returns: Nothing
+ *       Does: Copies row y of the array out, or n cells of it in, a span
+ *             of adjacent cells at a time
+ *   if Error: None
+ */
+static void row_to_bytes(A2Methods_T methods, A2 array, int y, char *to)
+{
+        int width = methods->width(array);
+        int size = methods->size(array);
+        for (int x = 0; x < width; ) {
+                int n;
+                char *from = methods->span_at(array, x, y, &n);
+                n = n < width - x ? n : width - x;
+                memcpy(to, from, (size_t) n * size);
+                to += (size_t) n * size;
+                x += n;
+        }
+}
+
+static void bytes_to_row(A2Methods_T methods, A2 array, int x0, int y,
+                         const char *from, int n)
+{
+        int size = methods->size(array);
+        for (int x = x0; x < x0 + n; ) {
+                int span;
+                char *to = methods->span_at(array, x, y, &span);
+                span = span < x0 + n - x ? span : x0 + n - x;
+                memcpy(to, from, (size_t) span * size);
+                from += (size_t) span * size;
+                x += span;
+        }
+}
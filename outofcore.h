@@ -0,0 +1,38 @@
+#ifndef OUTOFCORE_INCLUDED
+#define OUTOFCORE_INCLUDED
+
+#include <stddef.h>
+#include "a2methods.h"
+#include "ppmread.h"
+#include "ppmwrite.h"
+#include "transform.h"
+
+/* Transforms images bigger than memory, holding at most about
+ * 'max_memory' bytes of cells at a time.
+ *
+ * The input is read in bands of rows, and each band is transformed on
+ * its own into a piece of the result: a band of rows of it, or for the
+ * transformations that swap the dimensions (90 and 270 degrees,
+ * transpose, transverse) a strip of columns. When the pieces come out in
+ * the order of the result's rows they are written at once. Otherwise
+ * they are spilled, one after another, to a scratch file, and a second
+ * pass assembles bands of the result's rows from the rows of every piece
+ * and writes them: an external transpose in two sequential passes, which
+ * needs scratch space the size of the image and nothing else.
+ */
+
+/* runs t on the image 'reader' is positioned at, which has read no rows,
+ * into 'writer', made for the result and cells of 'size' bytes; bands
+ * are arrays of 'methods', as many rows as fit in max_memory but never
+ * fewer than one (or one row of blocks); the scratch file, if needed, is
+ * made in directory scratch_dir and removed before returning
+ *
+ * returns the CPU time, in nanoseconds, the transform itself took
+ * (checked runtime error if the scratch file cannot be made, read or
+ *  written)
+ */
+extern double Outofcore_run(Transform_T t, A2Methods_T methods, int size,
+                            Ppmread_T reader, Ppmwrite_T writer,
+                            size_t max_memory, const char *scratch_dir);
+
+#endif
@@ -0,0 +1,400 @@
+/* HW3 - Locality
+ * pipeline.c
+ * Function: Reading, transforming and writing an image as three stages
+ *           on three threads, connected by queues of bands of rows. Each
+ *           stage takes a band from the queue before it, fills or uses
+ *           it, and puts it on the queue after it; the bands then come
+ *           back empty, so the number of bands, and the memory they
+ *           take, never grows past the size of the rings. A result band
+ *           of a transformation that swaps rows and columns comes from a
+ *           strip of columns of the input, read as a band of its own.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "assert.h"
+#include "pipeline.h"
+
+#define A2 A2Methods_UArray2
+
+/* Bands in each ring: one being filled, one being used, one waiting */
+#define RING 3
+
+/* Bytes of cells a band holds, about */
+#define BAND_BYTES (4 << 20)
+
+/* Fewest bytes of each input row a strip of columns takes, so that a
+ * strip of a very tall image still reads whole cache lines of each row
+ * and a page of the input is not touched by too many strips */
+#define STRIP_ROW_BYTES 1024
+
+/* struct band
+ * Purpose: Some consecutive rows of an image: rows row0 to row0 + rows - 1
+ *          are rows 0 to rows - 1 of 'pixels'; or, for an input strip,
+ *          some consecutive columns, column row0 onwards of the image
+ *          being column 0 onwards of 'pixels'
+ */
+struct band {
+        A2 pixels;
+        int row0;
+        int rows;
+};
+
+/* struct queue
+ * Purpose: A bounded FIFO of bands between two threads; a NULL band
+ *          tells the taker that no more are coming
+ */
+struct queue {
+        struct band *items[RING + 1];
+        int head;
+        int count;
+        pthread_mutex_t lock;
+        pthread_cond_t changed;
+};
+
+/* struct pipeline
+ * Purpose: What the three stages share. Input bands go round through
+ *          free_in and full_in, result bands through free_out and
+ *          full_out; 'whole' is the result when it is not streamed
+ */
+struct pipeline {
+        Transform_T t;
+        A2Methods_T methods;
+        int size;
+        Ppmread_T reader;
+        Ppmwrite_T writer;
+        int width, height;              /* of the source */
+        int out_width;
+        int band_rows;
+        int backwards;                  /* bottom input band read first */
+        int strips;                     /* input read in column strips */
+        int streaming;                  /* result bands written as made */
+        A2 whole;
+
+        struct band in[RING], out[RING];
+        struct queue free_in, full_in, free_out, full_out;
+};
+
+static void queue_init(struct queue *q);
+static void queue_destroy(struct queue *q);
+static void queue_put(struct queue *q, struct band *band);
+static struct band *queue_take(struct queue *q);
+static int choose_band_rows(A2Methods_T methods, int width, int size);
+static int choose_strip_cols(struct pipeline *p);
+static void fit_band(struct pipeline *p, struct band *band, int width,
+                     int rows);
+static void *read_stage(void *vp);
+static void *write_stage(void *vp);
+static double thread_time(void);
+
+/* double Pipeline_run(Transform_T t, A2Methods_T methods, int size,
+ *                     Ppmread_T reader, Ppmwrite_T writer)
+ * Parameters: Transform_T t - the transformation
+ *             A2Methods_T methods - methods of the bands
+ *             int size - cell size of the bands
+ *             Ppmread_T reader - the input, no rows read yet
+ *             Ppmwrite_T writer - the output, no rows written yet
+ *    Returns: CPU time of the transform stage, in nanoseconds
+ *       Does: Decides whether the result can be streamed, starts the
+ *             reader (and, when streaming, the writer) thread, transforms
+ *             bands on this thread as they arrive, then waits for the
+ *             others and frees every band. A strip of input columns is
+ *             transformed as an image of its own, whose result is a band
+ *             of result rows
+ *   if Error: raises assertions
+ *             if an argument is null
+ *             if memory or a thread cannot be allocated
+ */
+double Pipeline_run(Transform_T t, A2Methods_T methods, int size,
+                    Ppmread_T reader, Ppmwrite_T writer)
+{
+        assert(methods != NULL && reader != NULL && writer != NULL);
+        struct pipeline p;
+        p.t = t;
+        p.methods = methods;
+        p.size = size;
+        p.reader = reader;
+        p.writer = writer;
+        p.width = Ppmread_width(reader);
+        p.height = Ppmread_height(reader);
+        int out_height;
+        Transform_dimensions(t, p.width, p.height, &p.out_width,
+                             &out_height);
+        p.band_rows = choose_band_rows(methods, p.width, size);
+        p.backwards = Transform_flips_rows(t) && !Transform_swaps(t)
+                      && Ppmread_seek(reader, 0);
+        p.strips = Transform_swaps(t) && Ppmread_seek(reader, 0);
+        if (p.strips) {
+                p.band_rows = choose_strip_cols(&p);
+        }
+        p.streaming = p.strips || (!Transform_swaps(t)
+                                   && (p.backwards
+                                       || !Transform_flips_rows(t)));
+        p.whole = NULL;
+        if (!p.streaming) {
+                p.whole = methods->new(p.out_width, out_height, size);
+        }
+
+        queue_init(&p.free_in);
+        queue_init(&p.full_in);
+        queue_init(&p.free_out);
+        queue_init(&p.full_out);
+        for (int k = 0; k < RING; k++) {
+                p.in[k].pixels = p.out[k].pixels = NULL;
+                queue_put(&p.free_in, &p.in[k]);
+                queue_put(&p.free_out, &p.out[k]);
+        }
+
+        pthread_t read_thread, write_thread;
+        int failed = pthread_create(&read_thread, NULL, read_stage, &p);
+        assert(failed == 0);
+        if (p.streaming) {
+                failed = pthread_create(&write_thread, NULL, write_stage,
+                                        &p);
+                assert(failed == 0);
+        }
+
+        double elapsed = 0;
+        struct band *in;
+        while ((in = queue_take(&p.full_in)) != NULL) {
+                double start = thread_time();
+                if (p.strips) {
+                        int cols = methods->width(in->pixels);
+                        struct band *out = queue_take(&p.free_out);
+                        fit_band(&p, out, p.out_width, cols);
+                        Transform_tiled(t, methods, in->pixels, out->pixels);
+                        queue_put(&p.full_out, out);
+                } else if (p.streaming) {
+                        struct band *out = queue_take(&p.free_out);
+                        fit_band(&p, out, p.out_width, in->rows);
+                        out->row0 = p.backwards
+                                    ? p.height - in->row0 - in->rows
+                                    : in->row0;
+                        Transform_tiled_band(t, methods, in->pixels,
+                                             in->row0, p.height,
+                                             out->pixels, out->row0);
+                        queue_put(&p.full_out, out);
+                } else {
+                        Transform_tiled_band(t, methods, in->pixels,
+                                             in->row0, p.height,
+                                             p.whole, 0);
+                }
+                elapsed += thread_time() - start;
+                queue_put(&p.free_in, in);
+        }
+
+        pthread_join(read_thread, NULL);
+        if (p.streaming) {
+                queue_put(&p.full_out, NULL);
+                pthread_join(write_thread, NULL);
+        } else {
+                Ppmwrite_rows(writer, methods, p.whole, 0, out_height);
+                methods->free(&p.whole);
+        }
+
+        for (int k = 0; k < RING; k++) {
+                if (p.in[k].pixels != NULL) {
+                        methods->free(&p.in[k].pixels);
+                }
+                if (p.out[k].pixels != NULL) {
+                        methods->free(&p.out[k].pixels);
+                }
+        }
+        queue_destroy(&p.free_in);
+        queue_destroy(&p.full_in);
+        queue_destroy(&p.free_out);
+        queue_destroy(&p.full_out);
+        return elapsed;
+}
+
+/* static void *read_stage(void *vp)
+ * Parameters: void *vp - the struct pipeline
+ *    Returns: NULL
+ *       Does: Reads the input a band at a time, from the top or, when
+ *             reading backwards, from the bottom, and queues each band
+ *             for the transform, then queues NULL. Strips of columns go
+ *             from the left, or from the right if the transformation
+ *             puts the right of the input at the top of the result
+ *   if Error: raises assertion if the input ends early or holds a bad
+ *             number
+ */
+static void *read_stage(void *vp)
+{
+        struct pipeline *p = vp;
+        for (int done = 0; p->strips && done < p->width; 
+             done += p->band_rows) {
+                int cols = p->width - done < p->band_rows
+                           ? p->width - done : p->band_rows;
+                struct band *band = queue_take(&p->free_in);
+                fit_band(p, band, cols, p->height);
+                band->row0 = Transform_flips_cols(p->t) 
+                             ? p->width - done - cols : done;
+                int whole = Ppmread_columns(p->reader, p->methods,
+                                            band->pixels, band->row0);
+                assert(whole);
+                queue_put(&p->full_in, band);
+        }
+        for (int done = 0; done < p->height; done += p->band_rows) {
+                if (p->strips) {
+                        break;
+                }
+                int rows = p->height - done < p->band_rows
+                           ? p->height - done : p->band_rows;
+                struct band *band = queue_take(&p->free_in);
+                fit_band(p, band, p->width, rows);
+                band->row0 = done;
+                if (p->backwards) {
+                        band->row0 = p->height - done - rows;
+                        Ppmread_seek(p->reader, band->row0);
+                }
+                int whole = Ppmread_rows(p->reader, p->methods, 
+                                         band->pixels, 0, rows);
+                assert(whole);
+                queue_put(&p->full_in, band);
+        }
+        queue_put(&p->full_in, NULL);
+        return NULL;
+}
+
+/* static void *write_stage(void *vp)
+ * Parameters: void *vp - the struct pipeline
+ *    Returns: NULL
+ *       Does: Writes result bands in the order they are queued, which is
+ *             top to bottom, until it takes NULL
+ *   if Error: None beyond those of Ppmwrite_rows
+ */
+static void *write_stage(void *vp)
+{
+        struct pipeline *p = vp;
+        struct band *band;
+        while ((band = queue_take(&p->full_out)) != NULL) {
+                Ppmwrite_rows(p->writer, p->methods, band->pixels, 0,
+                              band->rows);
+                queue_put(&p->free_out, band);
+        }
+        return NULL;
+}
+
+/* static int choose_band_rows(A2Methods_T methods, int width, int size)
+ * Parameters: A2Methods_T methods - methods of the bands
+ *             int width - width of a band
+ *             int size - cell size
+ *    Returns: rows in a band: about BAND_BYTES of cells, and a whole
+ *             number of block rows when the arrays are blocked, so that
+ *             no band carries a partly used row of blocks but the last
+ *   if Error: None
+ */
+static int choose_band_rows(A2Methods_T methods, int width, int size)
+{
+        long row_bytes = (long) width * size;
+        int rows = row_bytes > 0 ? BAND_BYTES / row_bytes : 1;
+        A2 probe = methods->new(1, 1, size);
+        int blocksize = methods->blocksize(probe);
+        methods->free(&probe);
+        rows -= rows % blocksize;
+        return rows > blocksize ? rows : blocksize;
+}
+
+/* static int choose_strip_cols(struct pipeline *p)
+ * Parameters: struct pipeline *p - a pipeline reading strips
+ *    Returns: columns in a strip: as many as make a result band of about
+ *             BAND_BYTES, but no fewer than take STRIP_ROW_BYTES of each
+ *             input row, rounded up to whole blocks of the result
+ *   if Error: None
+ */
+static int choose_strip_cols(struct pipeline *p)
+{
+        int cols = choose_band_rows(p->methods, p->out_width, p->size);
+        int pixel_bytes = Ppmread_denominator(p->reader) > 255 ? 6 : 3;
+        int fewest = (STRIP_ROW_BYTES + pixel_bytes - 1) / pixel_bytes;
+        if (cols < fewest) {
+                A2 probe = p->methods->new(1, 1, p->size);
+                int blocksize = p->methods->blocksize(probe);
+                p->methods->free(&probe);
+                cols = (fewest + blocksize - 1) / blocksize * blocksize;
+        }
+        return cols;
+}
+
+/* static void fit_band(struct pipeline *p, struct band *band, int width,
+ *                      int rows)
+ * Parameters: struct pipeline *p - the pipeline
+ *             struct band *band - the band
+ *             int width - width the band must have
+ *             int rows - rows the band must have
+ *    Returns: Nothing
+ *       Does: Keeps the band's array if it has the right shape, which is
+ *             every time but the first and the last, and otherwise
+ *             replaces it
+ *   if Error: None
+ */
+static void fit_band(struct pipeline *p, struct band *band, int width,
+                     int rows)
+{
+        A2Methods_T methods = p->methods;
+        band->rows = rows;
+        if (band->pixels != NULL && methods->height(band->pixels) == rows
+            && methods->width(band->pixels) == width) {
+                return;
+        }
+        if (band->pixels != NULL) {
+                methods->free(&band->pixels);
+        }
+        band->pixels = methods->new(width, rows, p->size);
+}
+
+/* static double thread_time(void)
+ * Returns: CPU time of the calling thread, in nanoseconds
+ */
+static double thread_time(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/* Queues of bands: put blocks while the queue is full, take while it is
+ * empty; a queue never holds more than the RING bands of its ring plus
+ * the NULL that ends it
+ */
+
+static void queue_init(struct queue *q)
+{
+        q->head = 0;
+        q->count = 0;
+        pthread_mutex_init(&q->lock, NULL);
+        pthread_cond_init(&q->changed, NULL);
+}
+
+static void queue_destroy(struct queue *q)
+{
+        pthread_mutex_destroy(&q->lock);
+        pthread_cond_destroy(&q->changed);
+}
+
+static void queue_put(struct queue *q, struct band *band)
+{
+        pthread_mutex_lock(&q->lock);
+        while (q->count == RING + 1) {
+                pthread_cond_wait(&q->changed, &q->lock);
+        }
+        q->items[(q->head + q->count) % (RING + 1)] = band;
+        q->count++;
+        pthread_cond_broadcast(&q->changed);
+        pthread_mutex_unlock(&q->lock);
+}
+
+static struct band *queue_take(struct queue *q)
+{
+        pthread_mutex_lock(&q->lock);
+        while (q->count == 0) {
+                pthread_cond_wait(&q->changed, &q->lock);
+        }
+        struct band *band = q->items[q->head];
+        q->head = (q->head + 1) % (RING + 1);
+        q->count--;
+        pthread_cond_broadcast(&q->changed);
+        pthread_mutex_unlock(&q->lock);
+        return band;
+}
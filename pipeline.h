@@ -0,0 +1,36 @@
+#ifndef PIPELINE_INCLUDED
+#define PIPELINE_INCLUDED
+
+#include "a2methods.h"
+#include "ppmread.h"
+#include "ppmwrite.h"
+#include "transform.h"
+
+/* Transforms an image a band of rows at a time, with a reader thread
+ * decoding bands of the input, the calling thread transforming them and
+ * a writer thread writing bands of the result, the three passing bands
+ * through bounded rings so that at most a few bands exist at once.
+ *
+ * Result bands are written as soon as they are made. When the rows of
+ * the result come from the rows of the source (0 and 180 degrees, the
+ * flips), an input band makes a result band; 180 degrees and the
+ * vertical flip read the input bottom band first. Otherwise (90 and 270
+ * degrees, transpose, transverse) a band of result rows comes from a
+ * strip of input columns, read from every row of the file. Both reading
+ * backwards and reading strips need an input Ppmread_seek can move about
+ * in (a raw, mapped file); when the input can only be read forwards,
+ * every input band is instead transformed into one whole result, which
+ * is written at the end: one image in memory instead of two, with
+ * reading overlapping the transform.
+ */
+
+/* runs t on the image 'reader' is positioned at, which has read no rows,
+ * into 'writer', which was made for the result and arrays of cells of
+ * 'size' bytes; bands are arrays of 'methods'
+ *
+ * returns the CPU time, in nanoseconds, the transform itself took
+ */
+extern double Pipeline_run(Transform_T t, A2Methods_T methods, int size,
+                           Ppmread_T reader, Ppmwrite_T writer);
+
+#endif
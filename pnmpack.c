@@ -0,0 +1,131 @@
+/* HW3 - Locality
+ * pnmpack.c
+ * Function: Converts the pixels of a ppm between struct Pnm_rgb cells and
+ *           packed cells of one byte per channel. A pixel of 3 or 4 bytes
+ *           instead of 12 cuts the memory and the memory traffic of every
+ *           pass over an image by a factor of 3 to 4.
+ */
+
+#include <stdlib.h>
+#include "assert.h"
+#include "pnmpack.h"
+
+#define A2 A2Methods_UArray2
+
+/* int Pnmpack_best_size(unsigned denominator)
+ * Parameters: unsigned denominator - largest channel value of an image
+ *    Returns: the smallest cell size the rotation kernels handle well
+ *       Does: Prefers 4 byte cells to 3 byte ones: they cost a third more
+ *             memory but are aligned, so they move as single words and
+ *             have SIMD transpose kernels
+ *   if Error: None
+ */
+int Pnmpack_best_size(unsigned denominator)
+{
+        if (denominator <= 255) {
+                return PNMPACK_ALIGNED;
+        }
+        return (int) sizeof(struct Pnm_rgb);
+}
+
+/* static inline void load(const char *cell, int size, unsigned rgb[3])
+ * Parameters: const char *cell - the pixel's cell
+ *             int size - cell size, packed or sizeof(struct Pnm_rgb)
+ *             unsigned rgb[3] - set to the red, green and blue channels
+ *    Returns: Nothing
+ *   if Error: None
+ */
+static inline void load(const char *cell, int size, unsigned rgb[3])
+{
+        if (size == (int) sizeof(struct Pnm_rgb)) {
+                const struct Pnm_rgb *pixel = (const struct Pnm_rgb *) cell;
+                rgb[0] = pixel->red;
+                rgb[1] = pixel->green;
+                rgb[2] = pixel->blue;
+        } else {
+                const unsigned char *bytes = (const unsigned char *) cell;
+                rgb[0] = bytes[0];
+                rgb[1] = bytes[1];
+                rgb[2] = bytes[2];
+        }
+}
+
+/* static inline void store(char *cell, int size, const unsigned rgb[3])
+ * Parameters: char *cell - the pixel's cell
+ *             int size - cell size, packed or sizeof(struct Pnm_rgb)
+ *             const unsigned rgb[3] - the red, green and blue channels
+ *    Returns: Nothing
+ *       Does: Packed cells of 4 bytes get a zero last byte, so that equal
+ *             pixels are equal cells
+ *   if Error: None
+ */
+static inline void store(char *cell, int size, const unsigned rgb[3])
+{
+        if (size == (int) sizeof(struct Pnm_rgb)) {
+                struct Pnm_rgb *pixel = (struct Pnm_rgb *) cell;
+                pixel->red = rgb[0];
+                pixel->green = rgb[1];
+                pixel->blue = rgb[2];
+        } else {
+                unsigned char *bytes = (unsigned char *) cell;
+                bytes[0] = rgb[0];
+                bytes[1] = rgb[1];
+                bytes[2] = rgb[2];
+                if (size == PNMPACK_ALIGNED) {
+                        bytes[3] = 0;
+                }
+        }
+}
+
+/* void Pnmpack_convert(Pnm_ppm img, int size)
+ * Parameters: Pnm_ppm img - the image to convert
+ *             int size - the new cell size
+ *    Returns: Nothing
+ *       Does: Copies the pixels into a new array, walking both arrays a
+ *             row at a time in runs of cells adjacent in both, then frees
+ *             the old array; the two arrays exist together while copying
+ *   if Error: raises assertions
+ *             if img is null
+ *             if size is not a cell size of this interface
+ *             if size is packed and the denominator is above 255
+ */
+void Pnmpack_convert(Pnm_ppm img, int size)
+{
+        assert(img != NULL);
+        assert(size == PNMPACK_TIGHT || size == PNMPACK_ALIGNED
+               || size == (int) sizeof(struct Pnm_rgb));
+        assert(size == (int) sizeof(struct Pnm_rgb)
+               || img->denominator <= 255);
+
+        const struct A2Methods_T *methods = img->methods;
+        A2 from = img->pixels;
+        int from_size = methods->size(from);
+        if (from_size == size) {
+                return;
+        }
+        A2 to = methods->new(img->width, img->height, size);
+        int width = img->width;
+        int height = img->height;
+
+        for (int j = 0; j < height; j++) {
+                int i = 0;
+                while (i < width) {
+                        int from_n, to_n;
+                        const char *from_cell = methods->span_at(from, i, j,
+                                                                 &from_n);
+                        char *to_cell = methods->span_at(to, i, j, &to_n);
+                        int n = from_n < to_n ? from_n : to_n;
+                        for (int k = 0; k < n; k++) {
+                                unsigned rgb[3];
+                                load(from_cell, from_size, rgb);
+                                store(to_cell, size, rgb);
+                                from_cell += from_size;
+                                to_cell += size;
+                        }
+                        i += n;
+                }
+        }
+
+        methods->free(&from);
+        img->pixels = to;
+}
@@ -0,0 +1,31 @@
+#ifndef PNMPACK_INCLUDED
+#define PNMPACK_INCLUDED
+
+#include "pnm.h"
+
+/* Packed storage for the pixels of a Pnm_ppm whose denominator is at
+ * most 255. A packed pixel holds one byte per channel, red first, in a
+ * cell of 3 bytes, or of 4 bytes whose last byte is unused; an unpacked
+ * pixel is a struct Pnm_rgb. The cell size of img->pixels tells which
+ * form an image is in.
+ */
+
+/* cell sizes of the packed forms */
+#define PNMPACK_TIGHT   3
+#define PNMPACK_ALIGNED 4
+
+/* the cell size to store an image with this denominator in:
+ * PNMPACK_ALIGNED when every channel fits in a byte,
+ * sizeof(struct Pnm_rgb) otherwise
+ */
+extern int Pnmpack_best_size(unsigned denominator);
+
+/* replaces img->pixels by an array of the same methods whose cells are
+ * 'size' bytes, converting every pixel; size is PNMPACK_TIGHT,
+ * PNMPACK_ALIGNED or sizeof(struct Pnm_rgb)
+ * (checked runtime error if a packed size is asked for an image whose
+ *  denominator is above 255)
+ */
+extern void Pnmpack_convert(Pnm_ppm img, int size);
+
+#endif
@@ -0,0 +1,606 @@
+/* HW3 - Locality
+ * ppmread.c
+ * Function: Reads ppm files without going through stdio a byte at a time.
+ *           The bytes of the file come either from a memory mapping of
+ *           the whole file or from a large buffer refilled with fread, and
+ *           the raw format is decoded a span of adjacent cells at a time,
+ *           so rows land directly in the rows or block rows of the array.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "pnmpack.h"
+#include "ppmread.h"
+
+#define T Ppmread_T
+#define A2 A2Methods_UArray2
+
+/* Bytes asked of fread at a time when the file cannot be mapped */
+#define READ_CHUNK (1 << 20)
+
+/* Bytes of a mapped file decoded between giving their pages back */
+#define RELEASE_BYTES (1 << 22)
+
+/* Ppmread_T (uses the defined macro T)
+ * Purpose: The header of a ppm and a window onto the bytes after it.
+ *          For a mapped file, data holds the whole file; otherwise it is
+ *          a buffer of which bytes pos to end are still unread, refilled
+ *          from fp when a row needs more than it holds
+ */
+struct T {
+        FILE *fp;
+        int raw;                  /* P6 rather than P3 */
+        unsigned width, height, denominator;
+        int channel_bytes;        /* 1, or 2 when the denominator > 255 */
+        int rows_read;
+        size_t raster;            /* offset of the first pixel */
+        int bad;                  /* set when a number could not be read */
+
+        unsigned char *data;
+        size_t pos, end;
+        size_t capacity;          /* of the buffer, 0 when mapped */
+        size_t mapped;            /* length of the mapping, 0 if none */
+        size_t released;          /* mapped bytes before it given back */
+};
+
+static void map_or_buffer(T reader);
+static void release(T reader);
+static size_t ensure(T reader, size_t n);
+static int peek(T reader);
+static unsigned header_number(T reader);
+static unsigned plain_number(T reader);
+static int raw_in_range(T reader, const unsigned char *bytes, int n);
+static void decode_raw(T reader, char *cell, int size, int n);
+static int decode_plain(T reader, char *cell, int size, int n);
+
+/* T Ppmread_new(FILE *fp)
+ * Parameters: FILE *fp - the file to read, positioned at its start
+ *    Returns: a reader positioned at the first pixel, or NULL if the
+ *             file does not start with a ppm header
+ *       Does: Maps or starts buffering the file and parses the magic
+ *             number, width, height and denominator, skipping comments
+ *   if Error: raises assertion if fp is null or memory cannot be
+ *             allocated
+ */
+T Ppmread_new(FILE *fp)
+{
+        assert(fp != NULL);
+        T reader = malloc(sizeof(*reader));
+        assert(reader != NULL);
+        reader->fp = fp;
+        reader->rows_read = 0;
+        reader->bad = 0;
+        reader->data = NULL;
+        reader->pos = reader->end = 0;
+        reader->capacity = 0;
+        reader->mapped = 0;
+        reader->released = 0;
+        map_or_buffer(reader);
+
+        char kind = 0;
+        if (ensure(reader, 2) >= 2 && reader->data[reader->pos] == 'P') {
+                kind = reader->data[reader->pos + 1];
+        }
+        if (kind != '6' && kind != '3') {
+                Ppmread_free(&reader);
+                return NULL;
+        }
+        reader->raw = kind == '6';
+        reader->pos += 2;
+
+        reader->width = header_number(reader);
+        reader->height = header_number(reader);
+        reader->denominator = header_number(reader);
+        reader->channel_bytes = reader->denominator > 255 ? 2 : 1;
+
+        /* A single whitespace byte separates the header from the raster */
+        int c = peek(reader);
+        if (reader->bad || reader->denominator == 0 
+            || reader->denominator > 65535
+            || !(c == ' ' || c == '\t' || c == '\n' || c == '\r')) {
+                Ppmread_free(&reader);
+                return NULL;
+        }
+        reader->pos++;
+        reader->raster = reader->pos;
+        return reader;
+}
+
+/* void Ppmread_free(T *reader)
+ * Parameters: T *reader - pointer to the reader to free
+ *    Returns: Nothing
+ *       Does: Unmaps or frees the bytes of the file and the reader, and
+ *             overwrites the pointer with NULL; the file stays open
+ *   if Error: raises assertion if reader or *reader is null
+ */
+void Ppmread_free(T *reader)
+{
+        assert(reader != NULL && *reader != NULL);
+        T r = *reader;
+        if (r->mapped > 0) {
+                munmap(r->data, r->mapped);
+        } else {
+                free(r->data);
+        }
+        free(r);
+        *reader = NULL;
+}
+
+/* unsigned Ppmread_width(T reader), Ppmread_height(T reader),
+ *          Ppmread_denominator(T reader)
+ * Parameters: T reader - the reader
+ *    Returns: the width, height or denominator given by the header
+ *   if Error: raises assertion if reader is null
+ */
+unsigned Ppmread_width(T reader)
+{
+        assert(reader != NULL);
+        return reader->width;
+}
+
+unsigned Ppmread_height(T reader)
+{
+        assert(reader != NULL);
+        return reader->height;
+}
+
+unsigned Ppmread_denominator(T reader)
+{
+        assert(reader != NULL);
+        return reader->denominator;
+}
+
+/* int Ppmread_rows(T reader, A2Methods_T methods, A2 pixels, int j0,
+ *                  int nrows)
+ * Parameters: T reader - the reader
+ *             A2Methods_T methods - methods of pixels
+ *             A2 pixels - where the rows go
+ *             int j0 - row of pixels receiving the next row of the file
+ *             int nrows - number of rows to read
+ *    Returns: nonzero if every row was read, 0 if the file ended early
+ *             or held a bad number or a value above the denominator
+ *       Does: Walks each row in spans of adjacent cells (a whole row of a
+ *             plain array, one row of a block of a blocked one) and
+ *             decodes the span's pixels with one call, having made sure
+ *             beforehand that a raw row is in memory in one piece. Pages
+ *             of a mapped file are given back as they are decoded, so
+ *             that the file and the array it fills are not both
+ *             resident at once
+ *   if Error: raises assertions
+ *             if an argument is null or the rows are out of range
+ *             if the width of pixels differs from the image's
+ *             if the cells are packed but a channel takes 2 bytes
+ */
+int Ppmread_rows(T reader, A2Methods_T methods, A2 pixels, int j0,
+                 int nrows)
+{
+        assert(reader != NULL && methods != NULL && pixels != NULL);
+        assert(methods->width(pixels) == (int) reader->width);
+        assert(j0 >= 0 && nrows >= 0);
+        assert(j0 + nrows <= methods->height(pixels));
+        assert(reader->rows_read + nrows <= (int) reader->height);
+
+        int size = methods->size(pixels);
+        assert(size == (int) sizeof(struct Pnm_rgb)
+               || reader->channel_bytes == 1);
+        int width = reader->width;
+        size_t row_bytes = (size_t) width * 3 * reader->channel_bytes;
+
+        for (int j = j0; j < j0 + nrows; j++) {
+                if (reader->raw && ensure(reader, row_bytes) < row_bytes) {
+                        return 0;
+                }
+                int i = 0;
+                while (i < width) {
+                        int n;
+                        char *cell = methods->span_at(pixels, i, j, &n);
+                        if (reader->raw) {
+                                if (!raw_in_range(reader, reader->data 
+                                                  + reader->pos, n)) {
+                                        return 0;
+                                }
+                                decode_raw(reader, cell, size, n);
+                        } else if (!decode_plain(reader, cell, size, n)) {
+                                return 0;
+                        }
+                        i += n;
+                }
+                reader->rows_read++;
+                if (reader->mapped > 0
+                    && reader->pos - reader->released >= RELEASE_BYTES) {
+                        release(reader);
+                }
+        }
+        return 1;
+}
+
+/* int Ppmread_seek(T reader, int row)
+ * Parameters: T reader - the reader
+ *             int row - row of the image to read next
+ *    Returns: 1 if the next Ppmread_rows starts at that row, 0 if the
+ *             reader cannot move (it only reads forwards)
+ *       Does: Rows of a raw mapped file are at known offsets, so such a
+ *             reader can jump to any of them
+ *   if Error: raises assertions
+ *             if reader is null
+ *             if row is not between 0 and the height of the image
+ */
+int Ppmread_seek(T reader, int row)
+{
+        assert(reader != NULL);
+        assert(row >= 0 && row <= (int) reader->height);
+        if (!reader->raw || reader->mapped == 0) {
+                return 0;
+        }
+        size_t row_bytes = (size_t) reader->width * 3 * reader->channel_bytes;
+        reader->pos = reader->raster + row * row_bytes;
+        reader->rows_read = row;
+        if (reader->released > reader->pos) {
+                reader->released = reader->pos - reader->pos
+                                   % sysconf(_SC_PAGESIZE);
+        }
+        return 1;
+}
+
+/* int Ppmread_columns(T reader, A2Methods_T methods, A2 pixels, int i0)
+ * Parameters: T reader - a reader of a raw mapped file
+ *             A2Methods_T methods - methods of pixels
+ *             A2 pixels - where the columns go
+ *             int i0 - first column of the image to decode
+ *    Returns: nonzero if the file holds every row and every value was
+ *             within the denominator
+ *       Does: Decodes, from each row of the mapping, the span of pixels
+ *             that starts at column i0 and is as wide as pixels, without
+ *             moving the reader
+ *   if Error: raises assertions
+ *             if an argument is null
+ *             if the reader is not of a raw mapped file
+ *             if pixels is not as tall as the image or the columns are
+ *             outside it
+ *             if the cells are packed but a channel takes 2 bytes
+ */
+int Ppmread_columns(T reader, A2Methods_T methods, A2 pixels, int i0)
+{
+        assert(reader != NULL && methods != NULL && pixels != NULL);
+        assert(reader->raw && reader->mapped > 0);
+        int width = methods->width(pixels);
+        assert(methods->height(pixels) == (int) reader->height);
+        assert(i0 >= 0 && i0 + width <= (int) reader->width);
+        int size = methods->size(pixels);
+        assert(size == (int) sizeof(struct Pnm_rgb)
+               || reader->channel_bytes == 1);
+
+        size_t pixel_bytes = 3 * reader->channel_bytes;
+        size_t row_bytes = (size_t) reader->width * pixel_bytes;
+        if (reader->raster + reader->height * row_bytes > reader->mapped) {
+                return 0;       /* the file ends early */
+        }
+        size_t saved = reader->pos;
+        int ok = 1;
+        for (int j = 0; ok && j < (int) reader->height; j++) {
+                reader->pos = reader->raster + j * row_bytes 
+                              + i0 * pixel_bytes;
+                int i = 0;
+                while (i < width) {
+                        int n;
+                        char *cell = methods->span_at(pixels, i, j, &n);
+                        if (!raw_in_range(reader, reader->data 
+                                          + reader->pos, n)) {
+                                ok = 0;
+                                break;
+                        }
+                        decode_raw(reader, cell, size, n);
+                        i += n;
+                }
+        }
+        reader->pos = saved;
+        return ok;
+}
+
+/* Pnm_ppm Ppmread_image(T reader, A2Methods_T methods, int size)
+ * Parameters: T reader - a reader that has read no rows yet
+ *             A2Methods_T methods - methods of the new image
+ *             int size - cell size, PNMPACK_TIGHT, PNMPACK_ALIGNED or
+ *                        sizeof(struct Pnm_rgb)
+ *    Returns: the image, which Pnm_ppmfree frees, or NULL if the file
+ *             ended early or held a bad number
+ *       Does: Allocates the array and reads every row into it
+ *   if Error: raises assertions
+ *             if memory cannot be allocated
+ *             as for Ppmread_rows
+ */
+Pnm_ppm Ppmread_image(T reader, A2Methods_T methods, int size)
+{
+        assert(reader != NULL && methods != NULL);
+        assert(reader->rows_read == 0);
+        assert(size == PNMPACK_TIGHT || size == PNMPACK_ALIGNED
+               || size == (int) sizeof(struct Pnm_rgb));
+
+        Pnm_ppm img = malloc(sizeof(*img));
+        assert(img != NULL);
+        img->width = reader->width;
+        img->height = reader->height;
+        img->denominator = reader->denominator;
+        img->methods = methods;
+        img->pixels = methods->new(img->width, img->height, size);
+        if (!Ppmread_rows(reader, methods, img->pixels, 0, img->height)) {
+                Pnm_ppmfree(&img);
+                return NULL;
+        }
+        return img;
+}
+
+/* static void map_or_buffer(T reader)
+ * Parameters: T reader - a reader with no bytes yet
+ *    Returns: Nothing
+ *       Does: Maps a regular file whole, telling the kernel it will be
+ *             read in order; anything else (or a failed mapping) gets an
+ *             empty buffer for ensure to fill
+ *   if Error: None
+ */
+static void map_or_buffer(T reader)
+{
+        struct stat st;
+        int fd = fileno(reader->fp);
+        if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+            && st.st_size > 0 && ftell(reader->fp) == 0) {
+                void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                                 fd, 0);
+                if (map != MAP_FAILED) {
+                        madvise(map, st.st_size, MADV_SEQUENTIAL);
+                        reader->data = map;
+                        reader->end = st.st_size;
+                        reader->mapped = st.st_size;
+                }
+        }
+}
+
+/* static void release(T reader)
+ * Parameters: T reader - a reader of a mapped file
+ *    Returns: Nothing
+ *       Does: Drops the whole pages between the last release and the
+ *             next byte to decode. The mapping is private and read only,
+ *             so reading them again, after Ppmread_seek, only faults
+ *             them back in from the file
+ *   if Error: None
+ */
+static void release(T reader)
+{
+        size_t upto = reader->pos - reader->pos % sysconf(_SC_PAGESIZE);
+        if (upto > reader->released) {
+                madvise(reader->data + reader->released,
+                        upto - reader->released, MADV_DONTNEED);
+                reader->released = upto;
+        }
+}
+
+/* static size_t ensure(T reader, size_t n)
+ * Parameters: T reader - the reader
+ *             size_t n - number of bytes wanted in memory
+ *    Returns: the number of unread bytes in memory, which is at least n
+ *             unless the file ends first
+ *       Does: For a buffered reader, moves the unread bytes to the front
+ *             of the buffer, grows it if n bytes would not fit, and reads
+ *             until n bytes are in or the file ends
+ *   if Error: raises assertion if memory cannot be allocated
+ */
+static size_t ensure(T reader, size_t n)
+{
+        size_t have = reader->end - reader->pos;
+        if (have >= n || reader->mapped > 0) {
+                return have;
+        }
+
+        memmove(reader->data, reader->data + reader->pos, have);
+        reader->pos = 0;
+        reader->end = have;
+        size_t wanted = n > READ_CHUNK ? n : READ_CHUNK;
+        if (reader->capacity < wanted) {
+                reader->data = realloc(reader->data, wanted);
+                assert(reader->data != NULL);
+                reader->capacity = wanted;
+        }
+        while (reader->end < n) {
+                size_t got = fread(reader->data + reader->end, 1,
+                                   reader->capacity - reader->end,
+                                   reader->fp);
+                if (got == 0) {
+                        break;
+                }
+                reader->end += got;
+        }
+        return reader->end - reader->pos;
+}
+
+/* static int peek(T reader)
+ * Parameters: T reader - the reader
+ *    Returns: the next unread byte, without consuming it, or EOF
+ *   if Error: None
+ */
+static int peek(T reader)
+{
+        if (ensure(reader, 1) == 0) {
+                return EOF;
+        }
+        return reader->data[reader->pos];
+}
+
+/* static unsigned header_number(T reader)
+ * Parameters: T reader - the reader, within the header
+ *    Returns: the next number of the header
+ *       Does: Skips whitespace and comments, which run from '#' to the
+ *             end of the line, then reads decimal digits
+ *   if Error: sets the reader's bad flag if no number follows
+ */
+static unsigned header_number(T reader)
+{
+        int c = peek(reader);
+        while (c == ' ' || c == '\t' || c == '\n' || c == '\r'
+               || c == '#') {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                reader->pos++;
+                                c = peek(reader);
+                        }
+                } else {
+                        reader->pos++;
+                        c = peek(reader);
+                }
+        }
+        return plain_number(reader);
+}
+
+/* static unsigned plain_number(T reader)
+ * Parameters: T reader - the reader
+ *    Returns: the number starting at the next non-whitespace byte, or
+ *             0 if there is none
+ *   if Error: sets the reader's bad flag
+ *             if no digit follows
+ *             if the number does not fit in an unsigned
+ */
+static unsigned plain_number(T reader)
+{
+        int c = peek(reader);
+        while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                reader->pos++;
+                c = peek(reader);
+        }
+        if (!(c >= '0' && c <= '9')) {
+                reader->bad = 1;
+                return 0;
+        }
+        unsigned long n = 0;
+        while (c >= '0' && c <= '9') {
+                n = n * 10 + (c - '0');
+                if (n > 0xffffffffUL) {
+                        reader->bad = 1;
+                        return 0;
+                }
+                reader->pos++;
+                c = peek(reader);
+        }
+        return n;
+}
+
+/* static int raw_in_range(T reader, const unsigned char *bytes, int n)
+ * Parameters: T reader - a raw reader
+ *             const unsigned char *bytes - the bytes of n pixels
+ *             int n - number of pixels
+ *    Returns: nonzero if no channel of the pixels is above the
+ *             denominator
+ *       Does: Looks at the channels only when the denominator is below
+ *             the largest value a channel's bytes can hold
+ *   if Error: None
+ */
+static int raw_in_range(T reader, const unsigned char *bytes, int n)
+{
+        unsigned denominator = reader->denominator;
+        size_t channels = (size_t) n * 3;
+        if (reader->channel_bytes == 1) {
+                if (denominator >= 255) {
+                        return 1;
+                }
+                unsigned char top = 0;
+                for (size_t k = 0; k < channels; k++) {
+                        top = bytes[k] > top ? bytes[k] : top;
+                }
+                return top <= denominator;
+        }
+        if (denominator >= 65535) {
+                return 1;
+        }
+        for (size_t k = 0; k < channels; k++, bytes += 2) {
+                if ((unsigned) (bytes[0] << 8 | bytes[1]) > denominator) {
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+/* static void decode_raw(T reader, char *cell, int size, int n)
+ * Parameters: T reader - a raw reader with the bytes of n pixels in
+ *                        memory
+ *             char *cell - first of n adjacent cells
+ *             int size - cell size
+ *             int n - number of pixels
+ *    Returns: Nothing
+ *       Does: Copies 3 byte pixels as they are, and widens them into
+ *             4 byte or struct Pnm_rgb cells; channels of 2 bytes are
+ *             big endian
+ *   if Error: None
+ */
+static void decode_raw(T reader, char *cell, int size, int n)
+{
+        const unsigned char *bytes = reader->data + reader->pos;
+        reader->pos += (size_t) n * 3 * reader->channel_bytes;
+
+        if (size == PNMPACK_TIGHT) {
+                memcpy(cell, bytes, (size_t) n * 3);
+        } else if (size == PNMPACK_ALIGNED) {
+                unsigned char *to = (unsigned char *) cell;
+                for (int k = 0; k < n; k++, to += 4, bytes += 3) {
+                        to[0] = bytes[0];
+                        to[1] = bytes[1];
+                        to[2] = bytes[2];
+                        to[3] = 0;
+                }
+        } else if (reader->channel_bytes == 1) {
+                struct Pnm_rgb *to = (struct Pnm_rgb *) cell;
+                for (int k = 0; k < n; k++, bytes += 3) {
+                        to[k].red = bytes[0];
+                        to[k].green = bytes[1];
+                        to[k].blue = bytes[2];
+                }
+        } else {
+                struct Pnm_rgb *to = (struct Pnm_rgb *) cell;
+                for (int k = 0; k < n; k++, bytes += 6) {
+                        to[k].red = bytes[0] << 8 | bytes[1];
+                        to[k].green = bytes[2] << 8 | bytes[3];
+                        to[k].blue = bytes[4] << 8 | bytes[5];
+                }
+        }
+}
+
+/* static int decode_plain(T reader, char *cell, int size, int n)
+ * Parameters: T reader - a plain (P3) reader
+ *             char *cell - first of n adjacent cells
+ *             int size - cell size
+ *             int n - number of pixels
+ *    Returns: nonzero if all n pixels were read
+ *       Does: Parses three numbers per pixel and stores them in the form
+ *             the cell size calls for
+ *   if Error: returns 0
+ *             if the file ends early or holds a bad number
+ *             if a value is above the denominator
+ */
+static int decode_plain(T reader, char *cell, int size, int n)
+{
+        for (int k = 0; k < n; k++, cell += size) {
+                unsigned rgb[3];
+                for (int c = 0; c < 3; c++) {
+                        rgb[c] = plain_number(reader);
+                        if (reader->bad || rgb[c] > reader->denominator) {
+                                return 0;
+                        }
+                }
+                if (size == (int) sizeof(struct Pnm_rgb)) {
+                        struct Pnm_rgb *pixel = (struct Pnm_rgb *) cell;
+                        pixel->red = rgb[0];
+                        pixel->green = rgb[1];
+                        pixel->blue = rgb[2];
+                } else {
+                        unsigned char *bytes = (unsigned char *) cell;
+                        bytes[0] = rgb[0];
+                        bytes[1] = rgb[1];
+                        bytes[2] = rgb[2];
+                        if (size == PNMPACK_ALIGNED) {
+                                bytes[3] = 0;
+                        }
+                }
+        }
+        return 1;
+}
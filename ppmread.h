@@ -0,0 +1,69 @@
+#ifndef PPMREAD_INCLUDED
+#define PPMREAD_INCLUDED
+
+#include <stdio.h>
+#include "a2methods.h"
+#include "pnm.h"
+
+#define T Ppmread_T
+typedef struct T *T;
+
+/* A reader of raw (P6) and plain (P3) ppm files that decodes whole rows
+ * at a time straight into the cells of an A2Methods array, packed (see
+ * pnmpack.h) or struct Pnm_rgb. A regular file is memory mapped; any
+ * other stream, such as a pipe on stdin, is read in large blocks.
+ */
+
+/* reads the header of the ppm on fp; the pixels are left for
+ * Ppmread_rows or Ppmread_image. Returns NULL, having read some of fp,
+ * if fp does not start with a ppm header
+ */
+extern T        Ppmread_new (FILE *fp);
+/* frees the reader but does not close its file */
+extern void     Ppmread_free(T *reader);
+
+extern unsigned Ppmread_width      (T reader);
+extern unsigned Ppmread_height     (T reader);
+extern unsigned Ppmread_denominator(T reader);
+
+/* decodes the next 'nrows' rows of the file into rows j0 to j0 + nrows - 1
+ * of 'pixels', whose width must be the image's; the cell size of
+ * 'pixels' says whether it is packed. Returns 0 if the file ends early
+ * or holds a bad number or a value above the denominator, which leaves
+ * the rows from there on undecoded, and nonzero otherwise
+ * (checked runtime error if the cells are packed and the denominator is
+ *  above 255)
+ */
+extern int      Ppmread_rows(T reader, A2Methods_T methods,
+                             A2Methods_UArray2 pixels, int j0, int nrows);
+
+/* decodes columns i0 to i0 + width - 1 of every row of the file into
+ * 'pixels', which is 'width' cells wide and as tall as the image, for a
+ * reader Ppmread_seek can move; returns 0 if the file ends early or a
+ * value is above the denominator, nonzero otherwise. The reader's place
+ * is left where it was
+ * (checked runtime error if the reader cannot move about the file or the
+ *  columns are outside the image, and as for Ppmread_rows)
+ */
+extern int      Ppmread_columns(T reader, A2Methods_T methods,
+                                A2Methods_UArray2 pixels, int i0);
+
+/* makes 'row' the next row Ppmread_rows reads, returning nonzero, if the
+ * reader can move about the file (a raw file that is memory mapped);
+ * otherwise returns 0 and the reader stays where it was
+ */
+extern int      Ppmread_seek(T reader, int row);
+
+/* decodes every row into a new image of the given methods whose cells are
+ * 'size' bytes, as for Pnmpack_convert; must come before any call to
+ * Ppmread_rows. Returns NULL, freeing the image, where Ppmread_rows
+ * would return 0
+ */
+extern Pnm_ppm  Ppmread_image(T reader, A2Methods_T methods, int size);
+
+/*
+ * it is a checked run-time error to pass a NULL T
+ * to any function in this interface
+ */
+#undef T
+#endif
@@ -6,22 +6,39 @@
  * HW3 - Locality
  * ppmtrans.c
  * Function: Ppmtrans takes a ppm file as a parameter and applies a rotation
- *           of 0, 90, 180, or 270 degree rotations using a specifed mapping
- *           method of row-major, col-major, or block major mapping. Ppmtrans
- *           also supports timing these rotations using the -time command
- *           line argument and stores this timing data in a specified file
- *           which will be the next argument of the command line after -time.        
+ *           of 0, 90, 180, or 270 degree rotations, a horizontal or vertical
+ *           flip, a transpose or a transverse using a specifed mapping
+ *           method of row-major, col-major, block major or Morton (Z) order
+ *           mapping. Several transformations may be given; they are
+ *           combined into the one with the same effect, and the image is
+ *           moved once. Ppmtrans also supports timing these rotations using
+ *           the -time command line argument and stores this timing data in
+ *           a specified file which will be the next argument of the
+ *           command line after -time.        
  */
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "assert.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2morton.h"
 #include "pnm.h"
 #include "cputiming.h"
+#include "transform.h"
+#include "workpool.h"
+#include "pnmpack.h"
+#include "ppmread.h"
+#include "ppmwrite.h"
+#include "pipeline.h"
+#include "outofcore.h"
+#include "blocktune.h"
+#include "a2alloc.h"
+#include "a2view.h"
 
 #define A2 A2Methods_UArray2
 
@@ -32,18 +49,51 @@ static void
 usage(const char *progname)
 {
     fprintf(stderr, "Usage: %s [-rotate <angle>] "
-                    "[-{row,col,block}-major] [filename]\n",
-                    progname);
+                    "[-flip {horizontal,vertical}] [-transpose] "
+                    "[-transverse]\n"
+                    "       [-{row,col,block,morton}-major] [-hilbert-major] "
+                    "[-kernel {map,tiled,view}]\n"
+                    "       [-cache-oblivious] [-simd {auto,scalar,sse2,avx2}] "
+                    "[-threads <n>] [-pack {auto,3,4,none}]\n"
+                    "       [-pipeline] "
+                    "[-max-memory <bytes>[K|M|G]] [-scratch-dir <dir>] "
+                    "[-populate] [-in-place]\n"
+                    "       [filename]\n"
+                    "       %s -batch [options] {input output}...\n"
+                    "       %s -batch-list <file> [options]\n"
+                    "       %s -calibrate\n",
+                    progname, progname, progname, progname);
     exit(1);
 }
 
 
 
+/* how rotate_img moves pixels: by mapping an apply function over the
+ * input, or with the tiled or the cache-oblivious kernel of transform.h;
+ * or not at all, the result being a view of the input (see a2view.h)
+ * that the writer reads through; or within the input, which becomes the
+ * result
+ */
+typedef enum {
+    KERNEL_MAP, KERNEL_TILED, KERNEL_OBLIVIOUS, KERNEL_VIEW, 
+    KERNEL_IN_PLACE
+} Kernel;
+
 FILE *create_file(int i, int argc, char *argv[]);
 
-Pnm_ppm rotate_img(int rotation, Pnm_ppm input_img, A2Methods_mapfun *map, 
-                   A2Methods_T methods, char *time_file_name);
+Pnm_ppm rotate_img(Transform_T transform, Pnm_ppm input_img, 
+                   A2Methods_mapfun *map, 
+                   A2Methods_parallelmapfun *parallel_map, int threads,
+                   A2Methods_T methods, Kernel kernel, Workpool_T pool, 
+                   char *time_file_name);
       
+/* the closure of the apply functions: the image they write, and the
+ * size of its cells, found once instead of for every pixel */
+struct rotation {
+    Pnm_ppm img;
+    int     size;
+};
+
 /* apply functions to be mapped */
 void rotate_0(int input_col, int input_row, A2 input_img, void *elem, 
                void *new_img);
@@ -51,14 +101,66 @@ void rotate_90(int input_col, int input_row, A2 input_img, void *elem,
                void *new_img);
 void rotate_180(int input_col, int input_row, A2 input_img, void *elem, 
                 void *new_img);
+void rotate_270(int input_col, int input_row, A2 input_img, void *elem, 
+                void *new_img);
+void flip_horizontal(int input_col, int input_row, A2 input_img, void *elem,
+                     void *new_img);
+void flip_vertical(int input_col, int input_row, A2 input_img, void *elem, 
+                   void *new_img);
+void transpose(int input_col, int input_row, A2 input_img, void *elem, 
+               void *new_img);
+void transverse(int input_col, int input_row, A2 input_img, void *elem, 
+                void *new_img);
 
-void print_time(char *time_file_name, double time_elapsed, int num_pixels,
-                int rotation);
+/* the apply function carrying out each transform */
+static A2Methods_applyfun *const apply_functions[] = {
+    [TRANSFORM_ROTATE_0]        = rotate_0,
+    [TRANSFORM_ROTATE_90]       = rotate_90,
+    [TRANSFORM_ROTATE_180]      = rotate_180,
+    [TRANSFORM_ROTATE_270]      = rotate_270,
+    [TRANSFORM_FLIP_HORIZONTAL] = flip_horizontal,
+    [TRANSFORM_FLIP_VERTICAL]   = flip_vertical,
+    [TRANSFORM_TRANSPOSE]       = transpose,
+    [TRANSFORM_TRANSVERSE]      = transverse,
+};
+
+void print_time(char *time_file_name, double time_elapsed, long num_pixels,
+                Transform_T transform, const char *note);
+
+/* Most bytes of freed arrays a batch keeps to make the next images' from */
+#define BATCH_POOL (256 << 20)
+
+int run_batch(char *progname, char *list_name, int nfiles, char *files[],
+              Transform_T transform, A2Methods_T methods, 
+              A2Methods_mapfun *map, Kernel kernel, int pack, int threads,
+              char *time_file_name);
+
+void check_options(char *progname, int batch, Kernel kernel, 
+                   int kernel_given, int threads, int hilbert, 
+                   int pipeline, size_t max_memory, 
+                   A2Methods_parallelmapfun *parallel_map, 
+                   const char *scratch_dir);
+
+int run_bands(char *progname, Ppmread_T *reader, Transform_T transform,
+              A2Methods_T methods, int pack, int pipeline, 
+              size_t max_memory, const char *scratch_dir, 
+              char *time_file_name);
 
 int main(int argc, char *argv[]) 
 {
     char *time_file_name = NULL;
-    int   rotation       = 0;
+    Transform_T transform = TRANSFORM_ROTATE_0;  /* all of them, composed */
+    Kernel kernel        = KERNEL_MAP;
+    int   kernel_given   = 0;    /* a kernel was asked for by name */
+    int   threads        = 1;
+    int   pack           = 0;    /* cell size asked for, 0 for automatic */
+    int   pipeline       = 0;    /* read, transform and write in bands */
+    int   hilbert        = 0;    /* map along Hilbert curves */
+    int   calibrate      = 0;    /* time block sizes and save the best */
+    int   batch          = 0;    /* the arguments are pairs of files */
+    char *list_name      = NULL; /* file listing the pairs, for a batch */
+    size_t max_memory    = 0;    /* bytes of cells at most, 0 for no limit */
+    char *scratch_dir    = getenv("TMPDIR");
     int   i;
 
     /* default to UArray2 methods */
@@ -91,25 +193,171 @@ int main(int argc, char *argv[])
         } else if (strcmp(argv[i], "-block-major") == 0) {
             SET_METHODS(uarray2_methods_blocked, map_block_major,
                         "block-major");
+        } else if (strcmp(argv[i], "-morton-major") == 0) {
+            SET_METHODS(uarray2_methods_morton, map_default,
+                        "morton-order");
+        } else if (strcmp(argv[i], "-hilbert-major") == 0) {
+            hilbert = 1;
         } else if (strcmp(argv[i], "-rotate") == 0) {
             if (!(i + 1 < argc)) {      /* no rotate value */
                 usage(argv[0]);
             }
             char *endptr;
-            rotation = strtol(argv[++i], &endptr, 10);
-            if (!(rotation == 0 || rotation == 90 ||
-                rotation == 180)) {
-                    fprintf(stderr, "Rotation must be 0, 90, or 180\n");
+            int rotation = strtol(argv[++i], &endptr, 10);
+            if (!(*endptr == '\0')) {    /* Not a number */
                     usage(argv[0]);
             }
-            if (!(*endptr == '\0')) {    /* Not a number */
+            Transform_T step = TRANSFORM_ROTATE_0;
+            if (rotation == 0) {
+                step = TRANSFORM_ROTATE_0;
+            } else if (rotation == 90) {
+                step = TRANSFORM_ROTATE_90;
+            } else if (rotation == 180) {
+                step = TRANSFORM_ROTATE_180;
+            } else if (rotation == 270) {
+                step = TRANSFORM_ROTATE_270;
+            } else {
+                    fprintf(stderr, "Rotation must be 0, 90, 180 or 270\n");
                     usage(argv[0]);
             }
+            transform = Transform_compose(transform, step);
+        } else if (strcmp(argv[i], "-flip") == 0) {
+            if (!(i + 1 < argc)) {      /* no flip direction */
+                usage(argv[0]);
+            }
+            i++;
+            Transform_T step = TRANSFORM_ROTATE_0;
+            if (strcmp(argv[i], "horizontal") == 0) {
+                step = TRANSFORM_FLIP_HORIZONTAL;
+            } else if (strcmp(argv[i], "vertical") == 0) {
+                step = TRANSFORM_FLIP_VERTICAL;
+            } else {
+                fprintf(stderr, "Flip must be horizontal or vertical\n");
+                usage(argv[0]);
+            }
+            transform = Transform_compose(transform, step);
+        } else if (strcmp(argv[i], "-transpose") == 0) {
+            transform = Transform_compose(transform, TRANSFORM_TRANSPOSE);
+        } else if (strcmp(argv[i], "-transverse") == 0) {
+            transform = Transform_compose(transform, TRANSFORM_TRANSVERSE);
+        } else if (strcmp(argv[i], "-kernel") == 0) {
+            if (!(i + 1 < argc)) {      /* no kernel name */
+                usage(argv[0]);
+            }
+            i++;
+            kernel_given = 1;
+            if (strcmp(argv[i], "map") == 0) {
+                kernel = KERNEL_MAP;
+            } else if (strcmp(argv[i], "tiled") == 0) {
+                kernel = KERNEL_TILED;
+            } else if (strcmp(argv[i], "view") == 0) {
+                kernel = KERNEL_VIEW;
+            } else {
+                fprintf(stderr, "Kernel must be map, tiled or view\n");
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-cache-oblivious") == 0) {
+            kernel = KERNEL_OBLIVIOUS;
+            kernel_given = 1;
+        } else if (strcmp(argv[i], "-in-place") == 0) {
+            kernel = KERNEL_IN_PLACE;
+            kernel_given = 1;
+        } else if (strcmp(argv[i], "-simd") == 0) {
+            if (!(i + 1 < argc)) {      /* no instruction set */
+                usage(argv[0]);
+            }
+            i++;
+            Transform_simd simd;
+            if (strcmp(argv[i], "auto") == 0) {
+                simd = TRANSFORM_SIMD_AUTO;
+            } else if (strcmp(argv[i], "scalar") == 0) {
+                simd = TRANSFORM_SIMD_SCALAR;
+            } else if (strcmp(argv[i], "sse2") == 0) {
+                simd = TRANSFORM_SIMD_SSE2;
+            } else if (strcmp(argv[i], "avx2") == 0) {
+                simd = TRANSFORM_SIMD_AVX2;
+            } else {
+                fprintf(stderr, "SIMD must be auto, scalar, sse2 or avx2\n");
+                usage(argv[0]);
+            }
+            if (!Transform_set_simd(simd)) {
+                fprintf(stderr, "%s: this CPU does not support %s\n",
+                        argv[0], argv[i]);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "-threads") == 0) {
+            if (!(i + 1 < argc)) {      /* no thread count */
+                usage(argv[0]);
+            }
+            char *endptr;
+            threads = strtol(argv[++i], &endptr, 10);
+            if (!(*endptr == '\0') || threads < 1) {
+                fprintf(stderr, "Threads must be a positive number\n");
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-pack") == 0) {
+            if (!(i + 1 < argc)) {      /* no packing */
+                usage(argv[0]);
+            }
+            i++;
+            if (strcmp(argv[i], "auto") == 0) {
+                pack = 0;
+            } else if (strcmp(argv[i], "3") == 0) {
+                pack = PNMPACK_TIGHT;
+            } else if (strcmp(argv[i], "4") == 0) {
+                pack = PNMPACK_ALIGNED;
+            } else if (strcmp(argv[i], "none") == 0) {
+                pack = sizeof(struct Pnm_rgb);
+            } else {
+                fprintf(stderr, "Pack must be auto, 3, 4 or none\n");
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-pipeline") == 0) {
+            pipeline = 1;
+        } else if (strcmp(argv[i], "-max-memory") == 0) {
+            if (!(i + 1 < argc)) {      /* no byte count */
+                usage(argv[0]);
+            }
+            char *endptr;
+            long long bytes = strtoll(argv[++i], &endptr, 10);
+            if (*endptr == 'K' || *endptr == 'k') {
+                bytes <<= 10;
+                endptr++;
+            } else if (*endptr == 'M' || *endptr == 'm') {
+                bytes <<= 20;
+                endptr++;
+            } else if (*endptr == 'G' || *endptr == 'g') {
+                bytes <<= 30;
+                endptr++;
+            }
+            if (!(*endptr == '\0') || bytes < 1) {
+                fprintf(stderr, "Max memory must be a positive number of "
+                                "bytes\n");
+                usage(argv[0]);
+            }
+            max_memory = bytes;
+        } else if (strcmp(argv[i], "-scratch-dir") == 0) {
+            if (!(i + 1 < argc)) {      /* no directory */
+                usage(argv[0]);
+            }
+            scratch_dir = argv[++i];
+        } else if (strcmp(argv[i], "-populate") == 0) {
+            A2alloc_set_populate(1);
+        } else if (strcmp(argv[i], "-calibrate") == 0) {
+            calibrate = 1;
+        } else if (strcmp(argv[i], "-batch") == 0) {
+            batch = 1;
+        } else if (strcmp(argv[i], "-batch-list") == 0) {
+            if (!(i + 1 < argc)) {      /* no list file */
+                usage(argv[0]);
+            }
+            batch = 1;
+            list_name = argv[++i];
         } else if (strcmp(argv[i], "-time") == 0) {
             time_file_name = argv[++i];             /* TIME FILE */
         } else if (*argv[i] == '-') {
             fprintf(stderr, "%s: unknown option '%s'\n", argv[0], argv[i]);
-        } else if (argc - i > 1) {
+        } else if (argc - i > 1 && !batch) {
             fprintf(stderr, "Too many arguments\n");
             usage(argv[0]);
         } else {
@@ -117,27 +365,262 @@ int main(int argc, char *argv[])
         }
     }
 
+    /* a calibration only picks the block size block-major arrays will
+     * use from now on, saving it for -block-major to find at startup */
+    if (calibrate) {
+        long bytes = Blocktune_calibrate();
+        if (!Blocktune_save(NULL)) {
+            fprintf(stderr, "%s: cannot save the calibration\n", argv[0]);
+            exit(1);
+        }
+        fprintf(stderr, "%s: block-major blocks will be %ld bytes\n",
+                argv[0], bytes);
+        exit(0);
+    }
+    if (methods == uarray2_methods_blocked) {
+        Blocktune_load(NULL);
+    }
+
+    /* Hilbert order keeps whichever layout was chosen and only changes
+     * the order its cells are mapped in */
+    if (hilbert) {
+        map = methods->map_hilbert;
+        if (map == NULL) {
+            fprintf(stderr, "%s does not support hilbert-order mapping\n",
+                    argv[0]);
+            exit(1);
+        }
+    }
+
+    /* the map kernel shares out rows or blocks among the threads, so
+     * only row-major and block-major mapping can use several */
+    A2Methods_parallelmapfun *parallel_map = NULL;
+    if (map == methods->map_row_major) {
+        parallel_map = methods->map_row_major_parallel;
+    } else if (map == methods->map_block_major) {
+        parallel_map = methods->map_block_major_parallel;
+    }
+    if (scratch_dir == NULL || *scratch_dir == '\0') {
+        scratch_dir = "/tmp";
+    }
+    check_options(argv[0], batch, kernel, kernel_given, threads, hilbert,
+                  pipeline, max_memory, parallel_map, scratch_dir);
+
+    /* a batch shares out whole files among the threads instead, each
+     * file being transformed on one thread */
+    if (batch) {
+        exit(run_batch(argv[0], list_name, argc - i, argv + i, transform,
+                       methods, map, kernel, pack, threads, 
+                       time_file_name));
+    }
+    Workpool_T pool = NULL;
+    if (threads > 1 && kernel == KERNEL_TILED) {
+        pool = Workpool_new(threads);
+    }
+
     /* initializes file pointer to the ppm file passed as a command line arg */
     FILE *file = create_file(i, argc, argv);
 
     /* initializes input_img from the file contents of the file pointer */
-    Pnm_ppm input_img = Pnm_ppmread(file, methods);
+    Ppmread_T reader = Ppmread_new(file);
+    if (reader == NULL) {
+        fprintf(stderr, "%s: the input is not a ppm\n", argv[0]);
+        exit(1);
+    }
+    /* packs the pixels when their channels fit in bytes; the rotated
+     * image is made with the same cell size */
+    unsigned denominator = Ppmread_denominator(reader);
+    if (pack == 0) {
+        pack = Pnmpack_best_size(denominator);
+    }
+    if (pack != (int) sizeof(struct Pnm_rgb) && denominator > 255) {
+        fprintf(stderr, "%s: cannot pack channels up to %u in bytes\n",
+                argv[0], denominator);
+        exit(1);
+    }
+    if (kernel == KERNEL_IN_PLACE
+        && !Transform_in_place_ok(transform, methods, Ppmread_width(reader),
+                                  Ppmread_height(reader))) {
+        fprintf(stderr, "%s: -in-place swaps rows and columns only of a "
+                        "square image, or with -row-major or -col-major\n",
+                argv[0]);
+        exit(1);
+    }
+
+    /* a pipeline, or an out-of-core run, never holds the whole input */
+    if (pipeline || max_memory > 0) {
+        int status = run_bands(argv[0], &reader, transform, methods, pack,
+                               pipeline, max_memory, scratch_dir, 
+                               time_file_name);
+        fclose(file);
+        exit(status);
+    }
+
+    Pnm_ppm input_img = Ppmread_image(reader, methods, pack);
+    Ppmread_free(&reader);
+    if (input_img == NULL) {
+        fprintf(stderr, "%s: the input ends early or holds a bad number\n",
+                argv[0]);
+        exit(1);
+    }
     /* applies rotation on input_img and initializes new rotated version */
-    Pnm_ppm rotated_img = rotate_img(rotation, input_img, map, methods, 
-                                     time_file_name);
+    Pnm_ppm rotated_img = rotate_img(transform, input_img, map, 
+                                     parallel_map, threads, methods, 
+                                     kernel, pool, time_file_name);
 
     /* Writes to terminal by default, but supports piping to file */
-    Pnm_ppmwrite(stdout, rotated_img);
+    if (!Ppmwrite_image(stdout, rotated_img)) {
+        fprintf(stderr, "%s: cannot write the output\n", argv[0]);
+        exit(1);
+    }
 
     /* Freeing allocated memory of input_img and rotated_img and closes file */
+    if (rotated_img != input_img) {
+        Pnm_ppmfree(&rotated_img);
+    }
     Pnm_ppmfree(&input_img);
-    Pnm_ppmfree(&rotated_img);
     fclose(file);
+    if (pool != NULL) {
+        Workpool_free(&pool);
+    }
     
     /* Exits with EXIT_SUCCESS after successful completion  */
     exit(EXIT_SUCCESS);
 }
 
+/* void check_options(char *progname, int batch, Kernel kernel, 
+ *                    int kernel_given, int threads, int hilbert, 
+ *                    int pipeline, size_t max_memory, 
+ *                    A2Methods_parallelmapfun *parallel_map, 
+ *                    const char *scratch_dir)
+ * Parameters: char *progname - name to report errors under
+ *             int batch - the arguments are pairs of files
+ *             Kernel kernel, int kernel_given - the kernel, and whether
+ *                                    it was asked for by name
+ *             int threads, int hilbert, int pipeline, 
+ *             size_t max_memory - the options given, as main keeps them
+ *             A2Methods_parallelmapfun *parallel_map - the chosen order
+ *                                    of mapping shared among threads, or
+ *                                    NULL if it cannot be
+ *             const char *scratch_dir - where out-of-core runs spill
+ *    Returns: Nothing
+ *       Does: Checks that the options asked for can be used together
+ *   if Error: exits with a message naming the options that cannot
+ */
+void check_options(char *progname, int batch, Kernel kernel, 
+                   int kernel_given, int threads, int hilbert, 
+                   int pipeline, size_t max_memory, 
+                   A2Methods_parallelmapfun *parallel_map, 
+                   const char *scratch_dir)
+{
+    /* a batch transforms each file on one thread, whatever the kernel */
+    if (batch) {
+        if (pipeline || max_memory > 0) {
+            fprintf(stderr, "%s: -batch cannot be used with -pipeline or "
+                            "-max-memory\n", progname);
+            exit(1);
+        }
+        return;
+    }
+    if (threads > 1 && kernel == KERNEL_MAP && parallel_map == NULL) {
+        fprintf(stderr, "%s: -threads needs -kernel tiled or row-major, "
+                        "block-major or morton-order mapping\n", progname);
+        exit(1);
+    }
+    if (kernel == KERNEL_OBLIVIOUS && threads > 1) {
+        fprintf(stderr, "%s: -cache-oblivious runs on one thread\n",
+                progname);
+        exit(1);
+    }
+    if (kernel == KERNEL_VIEW && threads > 1) {
+        fprintf(stderr, "%s: -kernel view copies nothing and cannot use "
+                        "-threads\n", progname);
+        exit(1);
+    }
+    if (kernel == KERNEL_IN_PLACE 
+        && (threads > 1 || pipeline || max_memory > 0)) {
+        fprintf(stderr, "%s: -in-place cannot be used with -threads, "
+                        "-pipeline or -max-memory\n", progname);
+        exit(1);
+    }
+    /* bands are always moved by the tiled kernel */
+    if ((pipeline || max_memory > 0) 
+        && (hilbert || (kernel_given && kernel != KERNEL_TILED))) {
+        fprintf(stderr, "%s: -pipeline and -max-memory only use the tiled "
+                        "kernel, in row order\n", progname);
+        exit(1);
+    }
+    if (pipeline && threads > 1) {
+        fprintf(stderr, "%s: -pipeline runs its own threads and cannot "
+                        "be used with -threads\n", progname);
+        exit(1);
+    }
+    if (max_memory > 0 && (pipeline || threads > 1)) {
+        fprintf(stderr, "%s: -max-memory cannot be used with -pipeline "
+                        "or -threads\n", progname);
+        exit(1);
+    }
+    if (max_memory > 0 && access(scratch_dir, W_OK | X_OK) != 0) {
+        fprintf(stderr, "%s: cannot make scratch files in %s\n", progname,
+                scratch_dir);
+        exit(1);
+    }
+}
+
+/* int run_bands(char *progname, Ppmread_T *reader, 
+ *               Transform_T transform, A2Methods_T methods, int pack, 
+ *               int pipeline, size_t max_memory, 
+ *               const char *scratch_dir, char *time_file_name)
+ * Parameters: char *progname - name to report errors under
+ *             Ppmread_T *reader - the input, which has read no rows;
+ *                                 freed and set to NULL
+ *             Transform_T transform, A2Methods_T methods, int pack - how
+ *                                 the image is transformed, bands being
+ *                                 arrays of methods with cells of pack
+ *                                 bytes
+ *             int pipeline - read, transform and write at once
+ *             size_t max_memory - bytes of cells at most, 0 for no limit
+ *             const char *scratch_dir - where to spill when out of core
+ *             char *time_file_name - where to report timing, or NULL
+ *    Returns: EXIT_SUCCESS if the result was written to stdout, else 1
+ *       Does: Never holds the whole input: bands of it are read,
+ *             transformed by the tiled kernel and written as they come,
+ *             by Outofcore_run when max_memory is given and otherwise by
+ *             Pipeline_run
+ *   if Error: reports an output that cannot be written
+ */
+int run_bands(char *progname, Ppmread_T *reader, Transform_T transform,
+              A2Methods_T methods, int pack, int pipeline, 
+              size_t max_memory, const char *scratch_dir, 
+              char *time_file_name)
+{
+    assert(pipeline || max_memory > 0);
+    unsigned width = Ppmread_width(*reader);
+    unsigned height = Ppmread_height(*reader);
+    int out_width, out_height;
+    Transform_dimensions(transform, width, height, &out_width, 
+                         &out_height);
+    Ppmwrite_T writer = Ppmwrite_new(stdout, out_width, out_height,
+                                     Ppmread_denominator(*reader), pack);
+    double time_elapsed;
+    if (max_memory > 0) {
+        time_elapsed = Outofcore_run(transform, methods, pack, *reader,
+                                     writer, max_memory, scratch_dir);
+    } else {
+        time_elapsed = Pipeline_run(transform, methods, pack, *reader,
+                                    writer);
+    }
+    int written = Ppmwrite_free(&writer);
+    Ppmread_free(reader);
+    if (!written) {
+        fprintf(stderr, "%s: cannot write the output\n", progname);
+        return 1;
+    }
+    print_time(time_file_name, time_elapsed, (long) width * height,
+               transform, NULL);
+    return EXIT_SUCCESS;
+}
+
 /* FILE *create_file(int i, int argc, char *argv[])
  * Parameters: int i - integer expressing the current command line argument
  *                     being collected, this determines if input is collected
@@ -163,95 +646,158 @@ FILE *create_file(int i, int argc, char *argv[])
     return fp;
 }
 
-Pnm_ppm rotate_img(int rotation, Pnm_ppm input_img, A2Methods_mapfun *map, 
-                   A2Methods_T methods, char *time_file_name)
+/* Pnm_ppm rotate_img(Transform_T transform, Pnm_ppm input_img, 
+ *                    A2Methods_mapfun *map, 
+ *                    A2Methods_parallelmapfun *parallel_map, int threads,
+ *                    A2Methods_T methods, Kernel kernel, Workpool_T pool, 
+ *                    char *time_file_name)
+ * Parameters: Transform_T transform - the rotation, flip or transpose
+ *             Pnm_ppm input_img - the image to rotate
+ *             A2Methods_mapfun *map - mapping function used by KERNEL_MAP
+ *             A2Methods_parallelmapfun *parallel_map - the same order of 
+ *                               mapping, shared among threads
+ *             int threads - threads KERNEL_MAP uses, 1 to use only map
+ *             A2Methods_T methods - methods of the input and output arrays
+ *             Kernel kernel - how the pixels are moved
+ *             Workpool_T pool - threads sharing the tiled kernel's work,
+ *                               or NULL to use only this thread
+ *             char *time_file_name - where to report timing, or NULL
+ *    Returns: a newly allocated transformed copy of input_img, or for
+ *             KERNEL_IN_PLACE input_img itself, transformed
+ *       Does: Allocates the output image and times only the transform,
+ *             which takes a single pass over the pixels whatever it is
+ */
+Pnm_ppm rotate_img(Transform_T transform, Pnm_ppm input_img, 
+                   A2Methods_mapfun *map, 
+                   A2Methods_parallelmapfun *parallel_map, int threads,
+                   A2Methods_T methods, Kernel kernel, Workpool_T pool, 
+                   char *time_file_name)
 {
-    int num_pixels = input_img->width * input_img->height;
-    int rgb_pixel_size = sizeof(struct Pnm_rgb);
+    long num_pixels = (long) input_img->width * input_img->height;
+    int pixel_size = methods->size(input_img->pixels);
+
+    /* the pixels trade places within the input, and nothing is made */
+    if (kernel == KERNEL_IN_PLACE) {
+        CPUTime_T time = CPUTime_New();
+        CPUTime_Start(time);
+        Transform_in_place(transform, methods, input_img->pixels);
+        double time_elapsed = CPUTime_Stop(time);
+        input_img->width = methods->width(input_img->pixels);
+        input_img->height = methods->height(input_img->pixels);
+        print_time(time_file_name, time_elapsed, num_pixels, transform,
+                   NULL);
+        CPUTime_Free(&time);
+        return input_img;
+    }
    
     Pnm_ppm rotated_img = malloc(sizeof(*input_img));
     assert(rotated_img != NULL);
     
     rotated_img->denominator = input_img->denominator;
     rotated_img->methods = methods; 
-    
-    CPUTime_T time = CPUTime_New();
-    double time_elapsed = 0;
-    if (rotation == 0) {
-        rotated_img->width = input_img->width;
-        rotated_img->height = input_img->height;
-        rotated_img->pixels = methods->new(rotated_img->width, 
-                                           rotated_img->height, 
-                                           rgb_pixel_size);
 
-        CPUTime_Start(time);
-        map(input_img->pixels, rotate_0, rotated_img);
-        time_elapsed = CPUTime_Stop(time);
-    }
-    if (rotation == 90) {
-        rotated_img->width = input_img->height;
-        rotated_img->height = input_img->width;
+    int rotated_width, rotated_height;
+    Transform_dimensions(transform, input_img->width, input_img->height,
+                         &rotated_width, &rotated_height);
+    rotated_img->width = rotated_width;
+    rotated_img->height = rotated_height;
+    if (kernel != KERNEL_VIEW) {
         rotated_img->pixels = methods->new(rotated_img->width, 
                                            rotated_img->height, 
-                                           rgb_pixel_size);
-                                           
-        CPUTime_Start(time);
-        map(input_img->pixels, rotate_90, rotated_img);
-        time_elapsed = CPUTime_Stop(time);
+                                           pixel_size);
     }
-    if (rotation == 180) {
-        rotated_img->width = input_img->width;
-        rotated_img->height = input_img->height;
-        rotated_img->pixels = methods->new(rotated_img->width, 
-                                           rotated_img->height, 
-                                           rgb_pixel_size);
+    
+    struct rotation rotation = { rotated_img, pixel_size };
+    CPUTime_T time = CPUTime_New();
+    double time_elapsed = 0;
 
-        CPUTime_Start(time);
-        map(input_img->pixels, rotate_180, rotated_img);
-        time_elapsed = CPUTime_Stop(time);
+    CPUTime_Start(time);
+    if (kernel == KERNEL_VIEW) {
+        /* the pixels move only when they are written out */
+        rotated_img->methods = uarray2_methods_view;
+        rotated_img->pixels = A2view_new(input_img->pixels, methods, 
+                                         transform);
+    } else if (kernel == KERNEL_TILED && pool != NULL) {
+        Transform_tiled_parallel(transform, methods, input_img->pixels, 
+                                 rotated_img->pixels, pool);
+    } else if (kernel == KERNEL_TILED) {
+        Transform_tiled(transform, methods, input_img->pixels, 
+                        rotated_img->pixels);
+    } else if (kernel == KERNEL_OBLIVIOUS) {
+        Transform_oblivious(transform, methods, input_img->pixels, 
+                            rotated_img->pixels);
+    } else if (threads > 1) {
+        /* each apply writes only its own output pixel, so the threads
+         * can share the rotation as their closure */
+        parallel_map(input_img->pixels, threads, NULL, 
+                     apply_functions[transform], &rotation);
+    } else {
+        map(input_img->pixels, apply_functions[transform], &rotation);
     }
+    time_elapsed = CPUTime_Stop(time);
     
-    print_time(time_file_name, time_elapsed, num_pixels, rotation);
+    /* a view's pixels are moved band by band as the writer packs them,
+     * which is not timed, so the time is only that of making the view */
+    print_time(time_file_name, time_elapsed, num_pixels, transform,
+               kernel == KERNEL_VIEW 
+               ? "The view moved no pixels: they are moved as the output "
+                 "is written, which was not timed" 
+               : NULL);
     
     CPUTime_Free(&time);
     
     return rotated_img;
 }
 
+/* static inline void copy_pixel(int size, void *to, const void *from)
+ * Parameters: int size - bytes in a cell of either image
+ *             void *to - cell of the image being written
+ *             const void *from - cell of the input image
+ *    Returns: Nothing
+ *       Does: Copies a pixel in whichever form, packed or not, the images
+ *             store it
+ */
+static inline void copy_pixel(int size, void *to, const void *from)
+{
+    if (size == (int) sizeof(struct Pnm_rgb)) {
+        *(Pnm_rgb) to = *(const struct Pnm_rgb *) from;
+    } else {
+        memcpy(to, from, size);
+    }
+}
+
 void rotate_0(int input_col, int input_row, A2 input_img, void *elem, 
                void *new_img)
 {
     (void) input_img;
-    Pnm_ppm rotated_img = new_img;
+    struct rotation *rotation = new_img;
+    Pnm_ppm rotated_img = rotation->img;
     
     int rotated_col = input_col;
     int rotated_row = input_row;
   
-    Pnm_rgb input_pixel = (Pnm_rgb) elem;
-
-    Pnm_rgb rotated_pixel = rotated_img->methods->at(rotated_img->pixels, 
-                                                     rotated_col,
-                                                     rotated_row);
-    *rotated_pixel = *input_pixel;
+    void *rotated_pixel = rotated_img->methods->at(rotated_img->pixels, 
+                                                   rotated_col,
+                                                   rotated_row);
+    copy_pixel(rotation->size, rotated_pixel, elem);
 }
 
 void rotate_90(int input_col, int input_row, A2 input_img, void *elem, 
                void *new_img)
 {
     (void) input_img;
-    Pnm_ppm rotated_img = (Pnm_ppm) new_img;
+    struct rotation *rotation = new_img;
+    Pnm_ppm rotated_img = rotation->img;
 
     int input_height = rotated_img->width;
     
     int rotated_col = input_height - input_row - 1;
     int rotated_row = input_col;
     
-    Pnm_rgb input_pixel = (Pnm_rgb) elem;
-
-    Pnm_rgb rotated_pixel = rotated_img->methods->at(rotated_img->pixels, 
-                                                     rotated_col,
-                                                     rotated_row);
-    *rotated_pixel = *input_pixel;
+    void *rotated_pixel = rotated_img->methods->at(rotated_img->pixels, 
+                                                   rotated_col,
+                                                   rotated_row);
+    copy_pixel(rotation->size, rotated_pixel, elem);
 }
 
 void rotate_180(int input_col, int input_row, A2 input_img, void *elem, 
@@ -259,7 +805,8 @@ void rotate_180(int input_col, int input_row, A2 input_img, void *elem,
 {
     (void) input_img;
     
-    Pnm_ppm rotated_img = new_img;
+    struct rotation *rotation = new_img;
+    Pnm_ppm rotated_img = rotation->img;
     
     int input_width = rotated_img->width;
     int input_height = rotated_img->height;
@@ -267,16 +814,364 @@ void rotate_180(int input_col, int input_row, A2 input_img, void *elem,
     int rotated_col = input_width - input_col - 1;
     int rotated_row = input_height - input_row - 1;
     
-    Pnm_rgb input_pixel = (Pnm_rgb) elem;
+    void *rotated_pixel = rotated_img->methods->at(rotated_img->pixels, 
+                                                   rotated_col,
+                                                   rotated_row);
+    copy_pixel(rotation->size, rotated_pixel, elem);
+}
+
+void rotate_270(int input_col, int input_row, A2 input_img, void *elem, 
+                void *new_img)
+{
+    (void) input_img;
+    struct rotation *rotation = new_img;
+    Pnm_ppm rotated_img = rotation->img;
+
+    int input_width = rotated_img->height;
+
+    int rotated_col = input_row;
+    int rotated_row = input_width - input_col - 1;
+
+    void *rotated_pixel = rotated_img->methods->at(rotated_img->pixels, 
+                                                   rotated_col,
+                                                   rotated_row);
+    copy_pixel(rotation->size, rotated_pixel, elem);
+}
+
+void flip_horizontal(int input_col, int input_row, A2 input_img, void *elem,
+                     void *new_img)
+{
+    (void) input_img;
+    struct rotation *rotation = new_img;
+    Pnm_ppm rotated_img = rotation->img;
+
+    int input_width = rotated_img->width;
+
+    int rotated_col = input_width - input_col - 1;
+    int rotated_row = input_row;
+
+    void *rotated_pixel = rotated_img->methods->at(rotated_img->pixels, 
+                                                   rotated_col,
+                                                   rotated_row);
+    copy_pixel(rotation->size, rotated_pixel, elem);
+}
+
+void flip_vertical(int input_col, int input_row, A2 input_img, void *elem, 
+                   void *new_img)
+{
+    (void) input_img;
+    struct rotation *rotation = new_img;
+    Pnm_ppm rotated_img = rotation->img;
+
+    int input_height = rotated_img->height;
+
+    int rotated_col = input_col;
+    int rotated_row = input_height - input_row - 1;
+
+    void *rotated_pixel = rotated_img->methods->at(rotated_img->pixels, 
+                                                   rotated_col,
+                                                   rotated_row);
+    copy_pixel(rotation->size, rotated_pixel, elem);
+}
+
+void transpose(int input_col, int input_row, A2 input_img, void *elem, 
+               void *new_img)
+{
+    (void) input_img;
+    struct rotation *rotation = new_img;
+    Pnm_ppm rotated_img = rotation->img;
+
+    int rotated_col = input_row;
+    int rotated_row = input_col;
+
+    void *rotated_pixel = rotated_img->methods->at(rotated_img->pixels, 
+                                                   rotated_col,
+                                                   rotated_row);
+    copy_pixel(rotation->size, rotated_pixel, elem);
+}
+
+void transverse(int input_col, int input_row, A2 input_img, void *elem, 
+                void *new_img)
+{
+    (void) input_img;
+    struct rotation *rotation = new_img;
+    Pnm_ppm rotated_img = rotation->img;
+
+    int input_height = rotated_img->width;
+    int input_width = rotated_img->height;
+
+    int rotated_col = input_height - input_row - 1;
+    int rotated_row = input_width - input_col - 1;
+
+    void *rotated_pixel = rotated_img->methods->at(rotated_img->pixels, 
+                                                   rotated_col,
+                                                   rotated_row);
+    copy_pixel(rotation->size, rotated_pixel, elem);
+}
+
+/* struct batch
+ * Purpose: What run_batch shares with the threads transforming its files
+ * Data Structure: files holds the name of each input followed by the
+ *                 name of its output; pixels is set for each pair to the
+ *                 pixels of its image, or -1 if it failed
+ */
+struct batch {
+    char             **files;
+    int                njobs;
+    Transform_T        transform;
+    A2Methods_T        methods;
+    A2Methods_mapfun  *map;
+    Kernel             kernel;
+    int                pack;     /* cell size asked for, 0 for automatic */
+    const char        *progname;
+    long              *pixels;
+};
+
+static char **read_batch_list(const char *progname, const char *list_name,
+                              int *nfiles);
+static void batch_file(int job, int thread, void *cl);
+static Pnm_ppm batch_read(struct batch *batch, const char *in_name);
+
+/* int run_batch(char *progname, char *list_name, int nfiles, 
+ *               char *files[], Transform_T transform, 
+ *               A2Methods_T methods, A2Methods_mapfun *map, 
+ *               Kernel kernel, int pack, int threads, 
+ *               char *time_file_name)
+ * Parameters: char *progname - name to report errors under
+ *             char *list_name - file listing the pairs, or NULL
+ *             int nfiles, char *files[] - the pairs on the command line,
+ *                                         used if list_name is NULL
+ *             Transform_T transform, A2Methods_T methods, 
+ *             A2Methods_mapfun *map, Kernel kernel, int pack - how each
+ *                                         image is transformed, as for
+ *                                         a single image
+ *             int threads - files transformed at once
+ *             char *time_file_name - where to report timing, or NULL
+ *    Returns: EXIT_SUCCESS if every file was transformed, else 1
+ *       Does: Transforms each input file into its output file, sharing
+ *             the files out among a Workpool's threads. Freed arrays are
+ *             pooled (see a2alloc.h), so an image the size of one done
+ *             before reuses its storage, already faulted in. The time
+ *             reported is the CPU time of the whole batch, reading and
+ *             writing included
+ *   if Error: exits with a message if the pairs are incomplete or the
+ *             list cannot be read; a file that cannot be opened, read
+ *             or written is reported and the rest are still done
+ */
+int run_batch(char *progname, char *list_name, int nfiles, char *files[],
+              Transform_T transform, A2Methods_T methods, 
+              A2Methods_mapfun *map, Kernel kernel, int pack, int threads,
+              char *time_file_name)
+{
+    if (list_name != NULL) {
+        if (nfiles > 0) {
+            fprintf(stderr, "%s: -batch-list takes no file arguments\n",
+                    progname);
+            exit(1);
+        }
+        files = read_batch_list(progname, list_name, &nfiles);
+    }
+    if (nfiles % 2 != 0) {
+        fprintf(stderr, "%s: %s has no output file\n", progname,
+                files[nfiles - 1]);
+        exit(1);
+    }
+
+    struct batch batch = { files, nfiles / 2, transform, methods, map,
+                           kernel, pack, progname, NULL };
+    batch.pixels = calloc(batch.njobs > 0 ? batch.njobs : 1, 
+                          sizeof(*batch.pixels));
+    assert(batch.pixels != NULL);
+    A2alloc_set_pool(BATCH_POOL);
+
+    CPUTime_T time = CPUTime_New();
+    CPUTime_Start(time);
+    Workpool_T pool = Workpool_new(threads);
+    Workpool_run(pool, batch.njobs, batch_file, &batch);
+    Workpool_free(&pool);
+    double time_elapsed = CPUTime_Stop(time);
+    CPUTime_Free(&time);
+
+    long num_pixels = 0;
+    int status = EXIT_SUCCESS;
+    for (int job = 0; job < batch.njobs; job++) {
+        if (batch.pixels[job] < 0) {
+            status = 1;
+        } else {
+            num_pixels += batch.pixels[job];
+        }
+    }
+    print_time(time_file_name, time_elapsed, num_pixels, transform, NULL);
 
-    Pnm_rgb rotated_pixel = rotated_img->methods->at(rotated_img->pixels, 
-                                                     rotated_col,
-                                                     rotated_row);
-    *rotated_pixel = *input_pixel;
+    A2alloc_set_pool(0);
+    free(batch.pixels);
+    if (list_name != NULL) {
+        for (int k = 0; k < nfiles; k++) {
+            free(files[k]);
+        }
+        free(files);
+    }
+    return status;
 }
 
-void print_time(char *time_file_name, double time_elapsed, int num_pixels, 
-                int rotation)
+/* static char **read_batch_list(const char *progname, 
+ *                               const char *list_name, int *nfiles)
+ * Parameters: const char *progname - name to report errors under
+ *             const char *list_name - the list file
+ *             int *nfiles - set to the number of names read
+ *    Returns: a malloced array of malloced file names, an input followed
+ *             by its output
+ *       Does: Reads the names separated by white space, one pair to a
+ *             line by convention; lines starting with '#' are comments
+ *   if Error: exits with a message if the list cannot be opened
+ */
+static char **read_batch_list(const char *progname, const char *list_name,
+                              int *nfiles)
+{
+    FILE *list = strcmp(list_name, "-") == 0 ? stdin 
+                                             : fopen(list_name, "r");
+    if (list == NULL) {
+        fprintf(stderr, "%s: cannot open %s\n", progname, list_name);
+        exit(1);
+    }
+
+    int n = 0, capacity = 16;
+    char **names = malloc(capacity * sizeof(*names));
+    assert(names != NULL);
+    char line[4096];
+    while (fgets(line, sizeof(line), list) != NULL) {
+        if (line[0] == '#') {
+            continue;
+        }
+        for (char *name = strtok(line, " \t\r\n"); name != NULL; 
+             name = strtok(NULL, " \t\r\n")) {
+            if (n == capacity) {
+                capacity *= 2;
+                names = realloc(names, capacity * sizeof(*names));
+                assert(names != NULL);
+            }
+            names[n] = malloc(strlen(name) + 1);
+            assert(names[n] != NULL);
+            strcpy(names[n], name);
+            n++;
+        }
+    }
+    if (list != stdin) {
+        fclose(list);
+    }
+    *nfiles = n;
+    return names;
+}
+
+/* static void batch_file(int job, int thread, void *cl)
+ * Parameters: int job - number of the pair of files to do
+ *             int thread - the thread doing it (unused)
+ *             void *cl - the struct batch
+ *    Returns: Nothing
+ *       Does: Reads the input, transforms it on this thread with the
+ *             batch's kernel and writes the output, recording the
+ *             number of pixels. The output is only created once the
+ *             whole input has been read
+ *   if Error: reports an input that cannot be opened or read and an
+ *             output that cannot be opened or written, removes an output
+ *             file that could not be written whole (but not a device),
+ *             and leaves the job's pixels at -1
+ */
+static void batch_file(int job, int thread, void *cl)
+{
+    struct batch *batch = cl;
+    const char *in_name = batch->files[2 * job];
+    const char *out_name = batch->files[2 * job + 1];
+    (void) thread;
+    batch->pixels[job] = -1;
+
+    Pnm_ppm input_img = batch_read(batch, in_name);
+    if (input_img == NULL) {
+        return;
+    }
+    /* opened for reading too, so that the writer can map it */
+    FILE *out = fopen(out_name, "w+b");
+    if (out == NULL) {
+        fprintf(stderr, "%s: cannot open %s\n", batch->progname, 
+                out_name);
+        Pnm_ppmfree(&input_img);
+        return;
+    }
+
+    Pnm_ppm rotated_img = rotate_img(batch->transform, input_img, 
+                                     batch->map, NULL, 1, batch->methods,
+                                     batch->kernel, NULL, NULL);
+    int written = Ppmwrite_image(out, rotated_img);
+    if (fclose(out) != 0 || !written) {
+        fprintf(stderr, "%s: cannot write %s\n", batch->progname, 
+                out_name);
+        struct stat st;
+        if (stat(out_name, &st) == 0 && S_ISREG(st.st_mode)) {
+            remove(out_name);
+        }
+    } else {
+        batch->pixels[job] = (long) input_img->width * input_img->height;
+    }
+    if (rotated_img != input_img) {
+        Pnm_ppmfree(&rotated_img);
+    }
+    Pnm_ppmfree(&input_img);
+}
+
+/* static Pnm_ppm batch_read(struct batch *batch, const char *in_name)
+ * Parameters: struct batch *batch - the batch
+ *             const char *in_name - one of its input files
+ *    Returns: the image in the file, packed as the batch asks, or NULL
+ *       Does: Opens, reads and closes the file, checking that the batch's
+ *             packing and kernel can take the image
+ *   if Error: reports a file that cannot be opened, is not a ppm, ends
+ *             early or holds a bad number, or that the packing or
+ *             kernel cannot take, and returns NULL
+ */
+static Pnm_ppm batch_read(struct batch *batch, const char *in_name)
+{
+    FILE *in = fopen(in_name, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "%s: cannot open %s\n", batch->progname, in_name);
+        return NULL;
+    }
+    Ppmread_T reader = Ppmread_new(in);
+    if (reader == NULL) {
+        fprintf(stderr, "%s: %s is not a ppm\n", batch->progname, in_name);
+        fclose(in);
+        return NULL;
+    }
+
+    unsigned denominator = Ppmread_denominator(reader);
+    int pack = batch->pack;
+    if (pack == 0) {
+        pack = Pnmpack_best_size(denominator);
+    }
+    Pnm_ppm img = NULL;
+    if (pack != (int) sizeof(struct Pnm_rgb) && denominator > 255) {
+        fprintf(stderr, "%s: cannot pack channels up to %u in bytes "
+                        "in %s\n", batch->progname, denominator, in_name);
+    } else if (batch->kernel == KERNEL_IN_PLACE
+               && !Transform_in_place_ok(batch->transform, batch->methods,
+                                         Ppmread_width(reader),
+                                         Ppmread_height(reader))) {
+        fprintf(stderr, "%s: -in-place swaps rows and columns only of a "
+                        "square image, or with -row-major or -col-major, "
+                        "unlike %s\n", batch->progname, in_name);
+    } else {
+        img = Ppmread_image(reader, batch->methods, pack);
+        if (img == NULL) {
+            fprintf(stderr, "%s: %s ends early or holds a bad number\n",
+                    batch->progname, in_name);
+        }
+    }
+    Ppmread_free(&reader);
+    fclose(in);
+    return img;
+}
+
+void print_time(char *time_file_name, double time_elapsed, long num_pixels, 
+                Transform_T transform, const char *note)
 {
     if (time_file_name != NULL) {
         FILE *time_file = fopen(time_file_name, "w+");
@@ -284,12 +1179,15 @@ void print_time(char *time_file_name, double time_elapsed, int num_pixels,
         
         double time_per_pixel = time_elapsed / num_pixels;
         
-        fprintf(time_file, "Number of pixels: %u\n", num_pixels);
+        fprintf(time_file, "Number of pixels: %ld\n", num_pixels);
         fprintf(time_file, 
-                "Rotation of %u degrees was computed in %.0f nanoseconds\n", 
-                rotation, time_elapsed);
+                "%s was computed in %.0f nanoseconds\n", 
+                Transform_name(transform), time_elapsed);
         fprintf(time_file, "Time per pixel: %.0f nanoseconds\n", 
                 time_per_pixel);
+        if (note != NULL) {
+            fprintf(time_file, "%s\n", note);
+        }
                 
         fclose(time_file);   
     }
@@ -0,0 +1,579 @@
+/* HW3 - Locality
+ * ppmwrite.c
+ * Function: Writes raw ppm files in bulk. The pixels of a band of rows
+ *           are packed into one large buffer, with SSE shuffles doing
+ *           four cells at a time when the CPU has them, and the buffer
+ *           goes to the file descriptor in a single write; a regular
+ *           file open for reading and writing is instead sized up front,
+ *           mapped, and packed into directly, so no copy is written.
+ */
+
+#define _GNU_SOURCE             /* F_SETPIPE_SZ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "assert.h"
+#include "pnmpack.h"
+#include "ppmwrite.h"
+#include "a2view.h"
+#include "transform.h"
+
+/* Bytes of packed rows gathered before each write */
+#define BAND_BYTES (1 << 20)
+
+/* Slack after a packed row: the vector packers store 16 bytes to keep 12 */
+#define SLACK 16
+
+/* Pipe capacity asked for, so that each write moves a whole band */
+#define PIPE_BYTES (1 << 20)
+
+#define T Ppmwrite_T
+#define A2 A2Methods_UArray2
+
+/* packs n adjacent cells into 3n bytes (or 6n for 2 byte channels) */
+typedef void packfun(unsigned char *out, const unsigned char *cells, int n);
+
+/* Ppmwrite_T (uses the defined macro T)
+ * Purpose: An output ppm whose header is waiting to go out with the first
+ *          band, and a buffer of band_rows packed rows, 'pending' of them
+ *          filled and not yet written
+ */
+struct T {
+        int fd;
+        char header[64];
+        int header_len;         /* 0 once the header is written */
+        unsigned height;
+        int rows_written;       /* including the pending ones */
+        packfun *pack;
+        int size;               /* cell size the writer was made for */
+        int channel_bytes;
+        size_t row_bytes;       /* of a packed row */
+        unsigned char *band;
+        int band_rows;
+        int pending;
+        int failed;             /* a write failed; nothing more is sent */
+};
+
+static packfun pack3, pack4, pack12, pack12_wide;
+static packfun *pack4_best(void);
+static packfun *pack12_best(void);
+static packfun *choose_pack(int size, unsigned denominator);
+static void pack_row(A2Methods_T methods, A2 pixels, packfun *pack,
+                     int channel_bytes, int j, unsigned char *out);
+static A2 view_band(A2 view, int j0, int nrows, A2Methods_T *methods);
+static int flush_band(T writer);
+static int write_mapped(FILE *fp, Pnm_ppm img);
+static int write_all(int fd, struct iovec *iov, int count);
+
+/* T Ppmwrite_new(FILE *fp, unsigned width, unsigned height,
+ *                unsigned denominator, int size)
+ * Parameters: FILE *fp - where to write
+ *             unsigned width, height, denominator - of the image
+ *             int size - cell size of the arrays its rows will come from
+ *    Returns: a writer expecting the first row
+ *       Does: Flushes fp, prepares the header, picks the packer for the
+ *             cells and allocates a band buffer of about BAND_BYTES; a
+ *             pipe is asked to grow so that a band fits in it
+ *   if Error: raises assertions
+ *             if fp is null or memory cannot be allocated
+ *             if size is packed and the denominator is above 255
+ */
+T Ppmwrite_new(FILE *fp, unsigned width, unsigned height,
+               unsigned denominator, int size)
+{
+        assert(fp != NULL);
+        int wide = denominator > 255;
+        assert(!wide || size == (int) sizeof(struct Pnm_rgb));
+        T writer = malloc(sizeof(*writer));
+        assert(writer != NULL);
+
+        int flushed = fflush(fp);
+        assert(flushed == 0);
+        writer->fd = fileno(fp);
+        assert(writer->fd >= 0);
+        writer->header_len = snprintf(writer->header, sizeof(writer->header),
+                                      "P6\n%u %u\n%u\n", width, height,
+                                      denominator);
+        writer->height = height;
+        writer->rows_written = 0;
+        writer->pack = choose_pack(size, denominator);
+        writer->size = size;
+        writer->channel_bytes = wide ? 2 : 1;
+        writer->row_bytes = (size_t) width * 3 * writer->channel_bytes;
+        writer->band_rows = writer->row_bytes > 0
+                            ? BAND_BYTES / writer->row_bytes : 0;
+        if (writer->band_rows < 1) {
+                writer->band_rows = 1;
+        }
+        writer->pending = 0;
+        writer->failed = 0;
+        int failed = posix_memalign((void **) &writer->band, 64,
+                                    writer->band_rows * writer->row_bytes
+                                    + SLACK);
+        assert(failed == 0);
+
+#ifdef F_SETPIPE_SZ
+        struct stat st;
+        if (fstat(writer->fd, &st) == 0 && S_ISFIFO(st.st_mode)) {
+                fcntl(writer->fd, F_SETPIPE_SZ, PIPE_BYTES); /* a hint */
+        }
+#endif
+        return writer;
+}
+
+/* void Ppmwrite_rows(T writer, A2Methods_T methods, A2 pixels, int j0,
+ *                    int nrows)
+ * Parameters: T writer - the writer
+ *             A2Methods_T methods - methods of pixels
+ *             A2 pixels - holds the rows
+ *             int j0 - row of pixels that is the next row of the image
+ *             int nrows - number of rows to write
+ *    Returns: Nothing
+ *       Does: Packs the rows into the band buffer, writing the buffer
+ *             out each time it fills. Rows of a view are first copied out
+ *             of the viewed array a band at a time by the tiled kernel.
+ *             Once a write has failed nothing more is written, and
+ *             Ppmwrite_free reports it
+ *   if Error: raises assertions
+ *             if an argument is null, or the rows are out of range
+ *             if the cells of pixels are not the size given to
+ *             Ppmwrite_new
+ *             if more rows are written than the image has
+ */
+void Ppmwrite_rows(T writer, A2Methods_T methods, A2 pixels, int j0,
+                   int nrows)
+{
+        assert(writer != NULL && methods != NULL && pixels != NULL);
+        assert(methods->size(pixels) == writer->size);
+        assert(j0 >= 0 && nrows >= 0);
+        assert(j0 + nrows <= methods->height(pixels));
+        assert(writer->rows_written + nrows <= (int) writer->height);
+
+        while (methods == uarray2_methods_view && nrows > 0) {
+                int n = nrows < writer->band_rows ? nrows : writer->band_rows;
+                A2Methods_T band_methods;
+                A2 band = view_band(pixels, j0, n, &band_methods);
+                if (band == NULL) {
+                        break;  /* read through the view, below */
+                }
+                Ppmwrite_rows(writer, band_methods, band, 0, n);
+                band_methods->free(&band);
+                j0 += n;
+                nrows -= n;
+        }
+        for (int j = j0; j < j0 + nrows; j++) {
+                pack_row(methods, pixels, writer->pack, 
+                         writer->channel_bytes, j,
+                         writer->band + writer->pending * writer->row_bytes);
+                writer->pending++;
+                if (writer->pending == writer->band_rows) {
+                        flush_band(writer);
+                }
+        }
+        writer->rows_written += nrows;
+}
+
+/* int Ppmwrite_free(T *writer)
+ * Parameters: T *writer - pointer to the writer to free
+ *    Returns: nonzero if the whole image was written, 0 if a write failed
+ *       Does: Writes whatever is pending (at least the header), frees the
+ *             writer and overwrites the pointer with NULL; the file stays
+ *             open
+ *   if Error: raises assertions
+ *             if writer or *writer is null
+ *             if fewer rows were written than the image has
+ */
+int Ppmwrite_free(T *writer)
+{
+        assert(writer != NULL && *writer != NULL);
+        T w = *writer;
+        assert(w->rows_written == (int) w->height);
+        if (w->pending > 0 || w->header_len > 0) {
+                flush_band(w);
+        }
+        int written = !w->failed;
+        free(w->band);
+        free(w);
+        *writer = NULL;
+        return written;
+}
+
+/* int Ppmwrite_image(FILE *fp, Pnm_ppm img)
+ * Parameters: FILE *fp - where to write
+ *             Pnm_ppm img - the image, packed or not
+ *    Returns: nonzero if the image was written, 0 if a write failed
+ *       Does: Packs straight into a mapping of the output when it can be
+ *             mapped, and otherwise writes every row through a writer
+ *   if Error: raises assertions
+ *             if fp or img is null
+ *             if memory cannot be allocated
+ */
+int Ppmwrite_image(FILE *fp, Pnm_ppm img)
+{
+        assert(fp != NULL && img != NULL);
+        int flushed = fflush(fp);
+        assert(flushed == 0);
+        if (write_mapped(fp, img)) {
+                return 1;
+        }
+
+        A2Methods_T methods = (A2Methods_T) img->methods;
+        T writer = Ppmwrite_new(fp, img->width, img->height, 
+                                img->denominator,
+                                methods->size(img->pixels));
+        Ppmwrite_rows(writer, methods, img->pixels, 0, img->height);
+        return Ppmwrite_free(&writer);
+}
+
+/* static packfun *choose_pack(int size, unsigned denominator)
+ * Parameters: int size - cell size
+ *             unsigned denominator - of the image
+ *    Returns: the fastest packer for such cells on this CPU
+ *   if Error: None
+ */
+static packfun *choose_pack(int size, unsigned denominator)
+{
+        if (size == PNMPACK_TIGHT) {
+                return pack3;
+        } else if (size == PNMPACK_ALIGNED) {
+                return pack4_best();
+        } else if (denominator > 255) {
+                return pack12_wide;
+        }
+        return pack12_best();
+}
+
+/* static void pack_row(A2Methods_T methods, A2 pixels, packfun *pack,
+ *                      int channel_bytes, int j, unsigned char *out)
+ * Parameters: A2Methods_T methods - methods of pixels
+ *             A2 pixels - the array
+ *             packfun *pack - packer for its cells
+ *             int channel_bytes - bytes per channel in the file
+ *             int j - the row
+ *             unsigned char *out - where the row's bytes go, with SLACK
+ *                                  bytes to spare after them
+ *    Returns: Nothing
+ *       Does: Packs the row one span of adjacent cells at a time
+ *   if Error: None
+ */
+static void pack_row(A2Methods_T methods, A2 pixels, packfun *pack,
+                     int channel_bytes, int j, unsigned char *out)
+{
+        int width = methods->width(pixels);
+        int i = 0;
+        while (i < width) {
+                int n;
+                const unsigned char *cells = methods->span_at(pixels, i, j,
+                                                              &n);
+                pack(out, cells, n);
+                out += (size_t) n * 3 * channel_bytes;
+                i += n;
+        }
+}
+
+/* static A2 view_band(A2 view, int j0, int nrows, A2Methods_T *methods)
+ * Parameters: A2 view - an array of the view suite (see a2view.h)
+ *             int j0 - first row of the view wanted
+ *             int nrows - number of rows wanted
+ *             A2Methods_T *methods - set to the methods of the result
+ *    Returns: a new array of the viewed array's methods holding rows j0
+ *             to j0 + nrows - 1 of the view, or NULL if those methods
+ *             have no span_at for the tiled kernel
+ *       Does: Copies the rows out of the viewed array with
+ *             Transform_tiled_band, which reads the array a tile at a
+ *             time instead of a cell at a time through the view
+ *   if Error: raises assertion if memory cannot be allocated
+ */
+static A2 view_band(A2 view, int j0, int nrows, A2Methods_T *methods)
+{
+        A2Methods_T array_methods;
+        A2 array = A2view_array(view, &array_methods);
+        if (array_methods->span_at == NULL
+            || array_methods == uarray2_methods_view) {
+                return NULL;
+        }
+        A2 band = array_methods->new(uarray2_methods_view->width(view),
+                                     nrows, array_methods->size(array));
+        Transform_tiled_band(A2view_composed(view), array_methods, array,
+                             0, array_methods->height(array), band, j0);
+        *methods = array_methods;
+        return band;
+}
+
+/* static int flush_band(T writer)
+ * Parameters: T writer - the writer
+ *    Returns: nonzero if the rows were written, 0 if this or an earlier
+ *             write failed
+ *       Does: Writes the pending rows, preceded by the header the first
+ *             time, with a single writev; after a failure the rows are
+ *             dropped instead
+ *   if Error: None, a failure is recorded in the writer
+ */
+static int flush_band(T writer)
+{
+        struct iovec iov[2];
+        int count = 0;
+        if (writer->header_len > 0) {
+                iov[count].iov_base = writer->header;
+                iov[count].iov_len = writer->header_len;
+                count++;
+                writer->header_len = 0;
+        }
+        iov[count].iov_base = writer->band;
+        iov[count].iov_len = writer->pending * writer->row_bytes;
+        count++;
+        if (!writer->failed && !write_all(writer->fd, iov, count)) {
+                writer->failed = 1;
+        }
+        writer->pending = 0;
+        return !writer->failed;
+}
+
+/* static int write_mapped(FILE *fp, Pnm_ppm img)
+ * Parameters: FILE *fp - the output, already flushed
+ *             Pnm_ppm img - the image
+ *    Returns: 1 if the image was written, 0 if fp cannot be mapped
+ *       Does: When fp is a regular file open for reading and writing
+ *             without O_APPEND, reserves the blocks to hold the image
+ *             from its current offset, maps that range (from the page holding
+ *             the offset), packs every row into the mapping and leaves
+ *             the offset after the image. A descriptor opened write only,
+ *             as a shell's '>' does, cannot be mapped for writing. Rows
+ *             of a view are copied out a band at a time, as by
+ *             Ppmwrite_rows
+ *   if Error: None, the caller writes the image some other way (as it
+ *             does when the blocks cannot be reserved)
+ */
+static int write_mapped(FILE *fp, Pnm_ppm img)
+{
+        int fd = fileno(fp);
+        struct stat st;
+        int flags = fd >= 0 ? fcntl(fd, F_GETFL) : -1;
+        if (flags < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+            || (flags & O_ACCMODE) != O_RDWR || (flags & O_APPEND)) {
+                return 0;
+        }
+        off_t start = lseek(fd, 0, SEEK_CUR);
+        if (start < 0) {
+                return 0;
+        }
+
+        A2Methods_T methods = (A2Methods_T) img->methods;
+        int size = methods->size(img->pixels);
+        packfun *pack = choose_pack(size, img->denominator);
+        int channel_bytes = img->denominator > 255 ? 2 : 1;
+        char header[64];
+        size_t header_len = snprintf(header, sizeof(header), 
+                                     "P6\n%u %u\n%u\n", img->width, 
+                                     img->height, img->denominator);
+        size_t row_bytes = (size_t) img->width * 3 * channel_bytes;
+
+        size_t total = header_len + row_bytes * img->height;
+        long page = sysconf(_SC_PAGESIZE);
+        off_t base = start - start % page;
+        size_t skip = start - base;
+        /* The blocks are reserved up front: stores into a sparse
+         * mapping with no disk behind them would raise SIGBUS */
+        if (posix_fallocate(fd, start, total) != 0) {
+                int restored = ftruncate(fd, st.st_size);
+                (void) restored;
+                return 0;
+        }
+        unsigned char *map = mmap(NULL, skip + total, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, fd, base);
+        if (map == MAP_FAILED) {
+                int restored = ftruncate(fd, st.st_size);
+                (void) restored;
+                return 0;
+        }
+
+        unsigned char *out = map + skip;
+        memcpy(out, header, header_len);
+        out += header_len;
+
+        /* The vector packers overrun a row by up to SLACK bytes, so the
+         * last row, which has nothing after it, is packed via a buffer */
+        int height = img->height;
+        int band_rows = row_bytes > 0 && row_bytes < BAND_BYTES
+                        ? BAND_BYTES / row_bytes : 1;
+        for (int j0 = 0; j0 < height; j0 += band_rows) {
+                int n = height - j0 < band_rows ? height - j0 : band_rows;
+                A2Methods_T rows_methods = methods;
+                A2 rows = img->pixels;
+                int first = j0;
+                A2 band = NULL;
+                if (methods == uarray2_methods_view) {
+                        band = view_band(img->pixels, j0, n, &rows_methods);
+                }
+                if (band != NULL) {
+                        rows = band;
+                        first = 0;
+                }
+                for (int k = 0; k < n; k++, out += row_bytes) {
+                        if (j0 + k < height - 1 || size == PNMPACK_TIGHT) {
+                                pack_row(rows_methods, rows, pack,
+                                         channel_bytes, first + k, out);
+                                continue;
+                        }
+                        unsigned char *row = malloc(row_bytes + SLACK);
+                        assert(row != NULL);
+                        pack_row(rows_methods, rows, pack, channel_bytes,
+                                 first + k, row);
+                        memcpy(out, row, row_bytes);
+                        free(row);
+                }
+                if (band != NULL) {
+                        rows_methods->free(&band);
+                }
+        }
+        munmap(map, skip + total);
+        lseek(fd, start + total, SEEK_SET);
+        return 1;
+}
+
+/* static int write_all(int fd, struct iovec *iov, int count)
+ * Parameters: int fd - the output
+ *             struct iovec *iov - buffers to write, in order (modified)
+ *             int count - number of buffers
+ *    Returns: 1 once every byte is written, 0 if a write fails (the disk
+ *             is full, the reader of a pipe has gone...)
+ *       Does: Calls writev until it has taken everything, stepping past
+ *             what each call wrote and retrying on EINTR
+ *   if Error: None
+ */
+static int write_all(int fd, struct iovec *iov, int count)
+{
+        while (count > 0) {
+                ssize_t written = writev(fd, iov, count);
+                if (written < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (written < 0) {
+                        return 0;
+                }
+                while (count > 0 && (size_t) written >= iov->iov_len) {
+                        written -= iov->iov_len;
+                        iov++;
+                        count--;
+                }
+                if (count > 0) {
+                        iov->iov_base = (char *) iov->iov_base + written;
+                        iov->iov_len -= written;
+                }
+        }
+        return 1;
+}
+
+/* Scalar packers, one per cell form */
+
+static void pack3(unsigned char *out, const unsigned char *cells, int n)
+{
+        memcpy(out, cells, (size_t) n * 3);
+}
+
+static void pack4(unsigned char *out, const unsigned char *cells, int n)
+{
+        for (int k = 0; k < n; k++, out += 3, cells += 4) {
+                out[0] = cells[0];
+                out[1] = cells[1];
+                out[2] = cells[2];
+        }
+}
+
+static void pack12(unsigned char *out, const unsigned char *cells, int n)
+{
+        const struct Pnm_rgb *pixel = (const struct Pnm_rgb *) cells;
+        for (int k = 0; k < n; k++, out += 3) {
+                out[0] = pixel[k].red;
+                out[1] = pixel[k].green;
+                out[2] = pixel[k].blue;
+        }
+}
+
+static void pack12_wide(unsigned char *out, const unsigned char *cells,
+                        int n)
+{
+        const struct Pnm_rgb *pixel = (const struct Pnm_rgb *) cells;
+        for (int k = 0; k < n; k++, out += 6) {
+                out[0] = pixel[k].red >> 8;
+                out[1] = pixel[k].red;
+                out[2] = pixel[k].green >> 8;
+                out[3] = pixel[k].green;
+                out[4] = pixel[k].blue >> 8;
+                out[5] = pixel[k].blue;
+        }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+/* static void pack4_ssse3(unsigned char *out, const unsigned char *cells,
+ *                         int n)
+ * Does: Drops the pad byte of four cells with one byte shuffle and stores
+ *       the 12 bytes kept (plus 4 that the next store overwrites)
+ */
+__attribute__((target("ssse3")))
+static void pack4_ssse3(unsigned char *out, const unsigned char *cells,
+                        int n)
+{
+        const __m128i keep = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+                                           12, 13, 14, -1, -1, -1, -1);
+        int k = 0;
+        for (; k + 4 <= n; k += 4, out += 12, cells += 16) {
+                __m128i x = _mm_loadu_si128((const __m128i *) cells);
+                _mm_storeu_si128((__m128i *) out, _mm_shuffle_epi8(x, keep));
+        }
+        pack4(out, cells, n - k);
+}
+
+/* static void pack12_sse2(unsigned char *out, const unsigned char *cells,
+ *                         int n)
+ * Does: Narrows the twelve 32-bit channels of four struct Pnm_rgb cells,
+ *       all at most 255, to bytes with two saturating packs, which keep
+ *       them in order
+ */
+__attribute__((target("sse2")))
+static void pack12_sse2(unsigned char *out, const unsigned char *cells,
+                        int n)
+{
+        int k = 0;
+        for (; k + 4 <= n; k += 4, out += 12, cells += 48) {
+                __m128i a = _mm_loadu_si128((const __m128i *) cells);
+                __m128i b = _mm_loadu_si128((const __m128i *) (cells + 16));
+                __m128i c = _mm_loadu_si128((const __m128i *) (cells + 32));
+                __m128i ab = _mm_packs_epi32(a, b);
+                __m128i cc = _mm_packs_epi32(c, c);
+                _mm_storeu_si128((__m128i *) out, _mm_packus_epi16(ab, cc));
+        }
+        pack12(out, cells, n - k);
+}
+
+static packfun *pack4_best(void)
+{
+        return __builtin_cpu_supports("ssse3") ? pack4_ssse3 : pack4;
+}
+
+static packfun *pack12_best(void)
+{
+        return __builtin_cpu_supports("sse2") ? pack12_sse2 : pack12;
+}
+
+#else   /* not x86: only the scalar packers exist */
+
+static packfun *pack4_best(void)
+{
+        return pack4;
+}
+
+static packfun *pack12_best(void)
+{
+        return pack12;
+}
+
+#endif
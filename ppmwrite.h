@@ -0,0 +1,47 @@
+#ifndef PPMWRITE_INCLUDED
+#define PPMWRITE_INCLUDED
+
+#include <stdio.h>
+#include "a2methods.h"
+#include "pnm.h"
+
+#define T Ppmwrite_T
+typedef struct T *T;
+
+/* Writes raw (P6) ppm files from images whose cells are packed (see
+ * pnmpack.h) or struct Pnm_rgb. Pixels are packed into the bytes of the
+ * file many rows at a time and handed to the kernel in large writes, or
+ * stored straight into a memory mapping when the output is a regular
+ * file open for reading and writing.
+ */
+
+/* writes img to fp, after flushing anything fp has buffered; returns 0
+ * if a write fails (the disk is full...), nonzero otherwise
+ */
+extern int  Ppmwrite_image(FILE *fp, Pnm_ppm img);
+
+/* a writer for an image sent a band of rows at a time, from arrays whose
+ * cells are 'size' bytes; fp is flushed first and then written through
+ * its file descriptor
+ */
+extern T    Ppmwrite_new (FILE *fp, unsigned width, unsigned height,
+                          unsigned denominator, int size);
+/* writes rows j0 to j0 + nrows - 1 of 'pixels', whose width must be the
+ * image's, as the next rows of the image
+ */
+extern void Ppmwrite_rows(T writer, A2Methods_T methods,
+                          A2Methods_UArray2 pixels, int j0, int nrows);
+/* writes what is still buffered and frees the writer; the file stays
+ * open. Returns 0 if any write failed, after which the rest were not
+ * tried, and nonzero otherwise (checked runtime error if not every row
+ * was given to Ppmwrite_rows)
+ */
+extern int  Ppmwrite_free(T *writer);
+
+/*
+ * it is a checked run-time error to pass a NULL T
+ * to any function in this interface
+ */
+#undef T
+
+#endif
@@ -0,0 +1,1020 @@
+/* HW3 - Locality
+ * transform.c
+ * Function: Kernels that apply a geometric transformation (rotation,
+ *           flip, transpose or transverse) to a 2D array of cells.
+ *           Instead of calling back once per cell, the tiled kernel
+ *           walks the destination in cache sized tiles and copies cells
+ *           between memory spans of the source and the destination, so
+ *           column writes of a 90 degree rotation stay within a tile
+ *           that fits in the L1 cache. Transformations can also be done
+ *           in place, cycle by cycle, after an in place transpose when
+ *           they change the dimensions.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "transform.h"
+#include "cacheinfo.h"
+#include "transform_simd.h"
+
+#define A2 A2Methods_UArray2
+
+/* Limits on the side of a tile, in cells */
+#define MIN_TILE 8
+#define MAX_TILE 256
+
+/* Side, in cells, at which Transform_oblivious stops halving: small
+ * enough for any cache, big enough to keep the copy loops busy */
+#define OBLIVIOUS_BASE 32
+
+/* struct mapping
+ * Purpose: Describes where destination cell (x, y) comes from in the
+ *          source, which is enough to describe every transformation
+ * Math for Indexing: with W and H the width and height of the source,
+ *                    if swap is 0 then x indexes source columns and y
+ *                    source rows, otherwise y indexes source columns and
+ *                    x source rows; flip_i reverses the source column
+ *                    index (i becomes W - 1 - i) and flip_j reverses the
+ *                    source row index (j becomes H - 1 - j)
+ */
+struct mapping {
+        int swap;
+        int flip_i;
+        int flip_j;
+};
+
+static const struct mapping mappings[] = {
+        [TRANSFORM_ROTATE_0]        = { 0, 0, 0 },
+        [TRANSFORM_ROTATE_90]       = { 1, 0, 1 },
+        [TRANSFORM_ROTATE_180]      = { 0, 1, 1 },
+        [TRANSFORM_ROTATE_270]      = { 1, 1, 0 },
+        [TRANSFORM_FLIP_HORIZONTAL] = { 0, 1, 0 },
+        [TRANSFORM_FLIP_VERTICAL]   = { 0, 0, 1 },
+        [TRANSFORM_TRANSPOSE]       = { 1, 0, 0 },
+        [TRANSFORM_TRANSVERSE]      = { 1, 1, 1 },
+};
+
+static const char *const names[] = {
+        [TRANSFORM_ROTATE_0]        = "Rotation of 0 degrees",
+        [TRANSFORM_ROTATE_90]       = "Rotation of 90 degrees",
+        [TRANSFORM_ROTATE_180]      = "Rotation of 180 degrees",
+        [TRANSFORM_ROTATE_270]      = "Rotation of 270 degrees",
+        [TRANSFORM_FLIP_HORIZONTAL] = "Horizontal flip",
+        [TRANSFORM_FLIP_VERTICAL]   = "Vertical flip",
+        [TRANSFORM_TRANSPOSE]       = "Transpose",
+        [TRANSFORM_TRANSVERSE]      = "Transverse",
+};
+
+/* struct in_place
+ * Purpose: One transformation being done in place by Transform_in_place
+ * Math for Indexing: the cycle led by cell (x, y) has 'members' cells;
+ *                    member k is the cell the transformation applied k
+ *                    times takes (x, y) from, found through map[k] as
+ *                    for the source of a struct tiling, and takes the
+ *                    contents of member k + 1 (the last member takes
+ *                    the leader's). rows[k] holds the span_at pointers
+ *                    member k of the current rectangle is read through:
+ *                    one per row of the rectangle, or per column when
+ *                    map[k] swaps, unless the array's spans are too
+ *                    short ('narrow') to be worth finding
+ */
+struct in_place {
+        A2Methods_T methods;
+        A2 array;
+        int width, height, size;
+        Transform_T t;
+        int members;
+        struct mapping map[4];
+        char *rows[4][MAX_TILE];
+        int narrow;             /* members are found cell by cell with at */
+        char *held;             /* room for one cell */
+};
+
+/* Instruction set chosen with Transform_set_simd */
+static Transform_simd simd_choice = TRANSFORM_SIMD_AUTO;
+
+/* struct tiling
+ * Purpose: Everything the tile kernels need to know about one
+ *          transformation, gathered once by Transform_tiled
+ */
+struct tiling {
+        A2Methods_T methods;
+        A2 src, dst;
+        int src_width, src_height;      /* of the whole source image */
+        int width, height;              /* of the whole result */
+        int src_row0, dst_row0; /* image rows held in row 0 of src, dst */
+        int x0, x1, y0, y1;     /* the part of the result to fill */
+        int size;
+        struct mapping map;
+        const struct Transform_simd_ops *simd; /* NULL for scalar loops */
+        int tile;               /* side of a cache tile */
+        int unit;               /* side of the square a task fills */
+        int units_across;       /* tasks in a row of tasks */
+        int units_down;         /* tasks in a column of tasks */
+};
+
+static void start_tiling(struct tiling *tiling, Transform_T t,
+                         A2Methods_T methods, A2 src, int src_row0,
+                         int src_height, A2 dst, int dst_row0);
+static void transform_unit(int unit, int thread, void *vtiling);
+static void transform_rect(struct tiling *t, int x0, int x1, int y0, int y1);
+static void halve_rect(struct tiling *t, int x0, int x1, int y0, int y1);
+static void copy_rows(struct tiling *t, int x0, int x1, int y0, int y1);
+static void copy_cols(struct tiling *t, int x0, int x1, int y0, int y1);
+static void leaders(struct in_place *p, int x0, int x1, int y0, int y1);
+static void cycle_rect(struct in_place *p, int x0, int x1, int y0, int y1);
+static void cycle_at(struct in_place *p, int x0, int x1, int y0, int y1);
+
+/* const char *Transform_name(Transform_T t)
+ * Parameters: Transform_T t - the transformation
+ *    Returns: a static string describing t
+ *       Does: Looks the description up
+ *   if Error: None
+ */
+const char *Transform_name(Transform_T t)
+{
+        return names[t];
+}
+
+/* int Transform_set_simd(Transform_simd simd)
+ * Parameters: Transform_simd simd - instruction set for the kernels
+ *    Returns: nonzero if it was selected, 0 if this CPU lacks it
+ *       Does: Records the choice for later calls to Transform_tiled
+ *   if Error: None
+ */
+int Transform_set_simd(Transform_simd simd)
+{
+        if (!Transform_simd_supported(simd)) {
+                return 0;
+        }
+        simd_choice = simd;
+        return 1;
+}
+
+/* Transform_T Transform_compose(Transform_T first, Transform_T then)
+ * Parameters: Transform_T first - the transformation applied first
+ *             Transform_T then - the one applied to its result
+ *    Returns: the transformation with the same effect as both
+ *       Does: Follows a cell of the result back through 'then' and then
+ *             through 'first'. A swap by 'first' exchanges which source
+ *             index each of the flips of 'then' reverses; flips of the
+ *             same index cancel, and two swaps cancel
+ *   if Error: None
+ */
+Transform_T Transform_compose(Transform_T first, Transform_T then)
+{
+        struct mapping a = mappings[first];
+        struct mapping b = mappings[then];
+        struct mapping both = {
+                a.swap ^ b.swap,
+                a.flip_i ^ (a.swap ? b.flip_j : b.flip_i),
+                a.flip_j ^ (a.swap ? b.flip_i : b.flip_j),
+        };
+        for (int t = TRANSFORM_ROTATE_0; t <= TRANSFORM_TRANSVERSE; t++) {
+                if (mappings[t].swap == both.swap
+                    && mappings[t].flip_i == both.flip_i
+                    && mappings[t].flip_j == both.flip_j) {
+                        return (Transform_T) t;
+                }
+        }
+        assert(0);      /* every combination is one of the eight */
+        return TRANSFORM_ROTATE_0;
+}
+
+/* void Transform_dimensions(Transform_T t, int width, int height,
+ *                           int *out_width, int *out_height)
+ * Parameters: Transform_T t - the transformation
+ *             int width, int height - dimensions of the source image
+ *             int *out_width, int *out_height - set to the dimensions of
+ *                                               the transformed image
+ *    Returns: Nothing
+ *       Does: Transformations that swap rows and columns swap the
+ *             dimensions, the others keep them
+ *   if Error: raises assertion if either out pointer is null
+ */
+void Transform_dimensions(Transform_T t, int width, int height,
+                          int *out_width, int *out_height)
+{
+        assert(out_width != NULL && out_height != NULL);
+        if (mappings[t].swap) {
+                *out_width = height;
+                *out_height = width;
+        } else {
+                *out_width = width;
+                *out_height = height;
+        }
+}
+
+/* int Transform_swaps(Transform_T t)
+ * int Transform_flips_rows(Transform_T t)
+ * int Transform_flips_cols(Transform_T t)
+ * Parameters: Transform_T t - the transformation
+ *    Returns: whether t swaps rows and columns, and whether it reverses
+ *             the order of the source rows, or of the source columns
+ *   if Error: None
+ */
+int Transform_swaps(Transform_T t)
+{
+        return mappings[t].swap;
+}
+
+int Transform_flips_rows(Transform_T t)
+{
+        return mappings[t].flip_j;
+}
+
+int Transform_flips_cols(Transform_T t)
+{
+        return mappings[t].flip_i;
+}
+
+/* int Transform_tile_size(int size)
+ * Parameters: int size - bytes in one cell
+ *    Returns: side of a tile, in cells
+ *       Does: Picks the largest multiple of MIN_TILE for which two tiles
+ *             of cells fit in half of the L1 data cache, leaving the
+ *             other half for everything else the loop touches
+ *   if Error: raises assertion if size is not positive
+ */
+int Transform_tile_size(int size)
+{
+        assert(size > 0);
+        long budget = CacheInfo_l1d_size() / 4;
+        int side = MIN_TILE;
+        while (side + MIN_TILE <= MAX_TILE
+               && (long) (side + MIN_TILE) * (side + MIN_TILE) * size
+                  <= budget) {
+                side += MIN_TILE;
+        }
+        return side;
+}
+
+/* void Transform_tiled(Transform_T t, A2Methods_T methods, A2 src, A2 dst)
+ * Parameters: Transform_T t - the transformation to apply
+ *             A2Methods_T methods - methods of both src and dst
+ *             A2 src - the array to transform
+ *             A2 dst - the array receiving the result
+ *    Returns: Nothing
+ *       Does: Splits dst into square tiles, aligned to its blocks when it
+ *             is blocked, and fills each tile before moving to the next
+ *   if Error: raises assertions
+ *             if methods, src or dst is null, or methods has no span_at
+ *             if dst does not have the dimensions of the result
+ *             if src and dst have cells of different sizes
+ */
+void Transform_tiled(Transform_T t, A2Methods_T methods, A2 src, A2 dst)
+{
+        struct tiling tiling;
+        assert(methods != NULL && src != NULL);
+        start_tiling(&tiling, t, methods, src, 0, methods->height(src), 
+                     dst, 0);
+
+        int units = tiling.units_across * tiling.units_down;
+        for (int unit = 0; unit < units; unit++) {
+                transform_unit(unit, 0, &tiling);
+        }
+}
+
+/* void Transform_tiled_parallel(Transform_T t, A2Methods_T methods,
+ *                               A2 src, A2 dst, Workpool_T pool)
+ * Parameters: as for Transform_tiled, plus
+ *             Workpool_T pool - threads to share the work between
+ *    Returns: Nothing
+ *       Does: Runs the units of work Transform_tiled would run in order
+ *             as tasks of the pool. Units never write the same cell of
+ *             dst, and for blocked arrays never share a block, so the
+ *             result is the same as Transform_tiled's
+ *   if Error: raises the assertions of Transform_tiled, and one if
+ *             pool is null
+ */
+void Transform_tiled_parallel(Transform_T t, A2Methods_T methods,
+                              A2 src, A2 dst, Workpool_T pool)
+{
+        assert(pool != NULL);
+        struct tiling tiling;
+        assert(methods != NULL && src != NULL);
+        start_tiling(&tiling, t, methods, src, 0, methods->height(src), 
+                     dst, 0);
+
+        Workpool_run(pool, tiling.units_across * tiling.units_down,
+                     transform_unit, &tiling);
+}
+
+/* void Transform_tiled_band(Transform_T t, A2Methods_T methods,
+ *                           A2 src, int src_row0, int src_height,
+ *                           A2 dst, int dst_row0)
+ * Parameters: Transform_T t - the transformation to apply
+ *             A2Methods_T methods - methods of both src and dst
+ *             A2 src - rows src_row0 onwards of the source image
+ *             int src_row0 - image row held in row 0 of src
+ *             int src_height - height of the whole source image
+ *             A2 dst - rows dst_row0 onwards of the result
+ *             int dst_row0 - result row held in row 0 of dst
+ *    Returns: Nothing
+ *       Does: Fills the cells of dst whose source cells are in src, in
+ *             the same order Transform_tiled fills the whole result
+ *   if Error: raises the assertions of Transform_tiled, where the
+ *             dimensions checked are those of the bands
+ */
+void Transform_tiled_band(Transform_T t, A2Methods_T methods,
+                          A2 src, int src_row0, int src_height,
+                          A2 dst, int dst_row0)
+{
+        struct tiling tiling;
+        start_tiling(&tiling, t, methods, src, src_row0, src_height, 
+                     dst, dst_row0);
+
+        int units = tiling.units_across * tiling.units_down;
+        for (int unit = 0; unit < units; unit++) {
+                transform_unit(unit, 0, &tiling);
+        }
+}
+
+/* void Transform_oblivious(Transform_T t, A2Methods_T methods,
+ *                          A2 src, A2 dst)
+ * Parameters: as for Transform_tiled
+ *    Returns: Nothing
+ *       Does: Fills dst by halving it, and with it the source rectangle
+ *             it comes from, across the longer side until both sides are
+ *             at most OBLIVIOUS_BASE, then copying each small rectangle
+ *             with the loops Transform_tiled uses for a tile
+ *   if Error: raises the assertions of Transform_tiled
+ */
+void Transform_oblivious(Transform_T t, A2Methods_T methods, A2 src, A2 dst)
+{
+        struct tiling tiling;
+        assert(methods != NULL && src != NULL);
+        start_tiling(&tiling, t, methods, src, 0, methods->height(src), 
+                     dst, 0);
+        halve_rect(&tiling, 0, tiling.width, 0, tiling.height);
+}
+
+/* int Transform_in_place_ok(Transform_T t, A2Methods_T methods,
+ *                           int width, int height)
+ * Parameters: Transform_T t - the transformation
+ *             A2Methods_T methods - methods of the array
+ *             int width, int height - dimensions of the array
+ *    Returns: nonzero if the result has the array's own dimensions, or
+ *             methods can change them in place
+ *   if Error: raises assertion if methods is null
+ */
+int Transform_in_place_ok(Transform_T t, A2Methods_T methods, int width,
+                          int height)
+{
+        assert(methods != NULL);
+        return !mappings[t].swap || width == height
+               || methods->transpose != NULL;
+}
+
+/* void Transform_in_place(Transform_T t, A2Methods_T methods, A2 array)
+ * Parameters: Transform_T t - the transformation to apply
+ *             A2Methods_T methods - methods of the array
+ *             A2 array - the array to transform
+ *    Returns: Nothing
+ *       Does: Visits only the cells that lead their cycles, a tile at a
+ *             time, and rotates each cycle's cells: the leaders of a 90
+ *             or 270 degree rotation fill one quarter of the array, of a
+ *             flip or 180 degree rotation one half, and of a square's
+ *             transpose or transverse the triangle on one side of a
+ *             diagonal. A rectangle whose dimensions t swaps is
+ *             transposed by its methods first, which leaves the
+ *             transformation that follows a transpose to give t, and
+ *             that one keeps the dimensions
+ *   if Error: raises assertions
+ *             if methods or array is null, or methods has no span_at
+ *             if Transform_in_place_ok is 0 for the array
+ *             if failed mallocing
+ */
+void Transform_in_place(Transform_T t, A2Methods_T methods, A2 array)
+{
+        assert(methods != NULL && array != NULL);
+        assert(methods->span_at != NULL);
+        int width = methods->width(array);
+        int height = methods->height(array);
+        assert(Transform_in_place_ok(t, methods, width, height));
+        if (mappings[t].swap && width != height) {
+                methods->transpose(array);
+                t = Transform_compose(TRANSFORM_TRANSPOSE, t);
+                width = methods->width(array);
+                height = methods->height(array);
+        }
+        if (t == TRANSFORM_ROTATE_0) {
+                return;
+        }
+
+        /* Member k of a cycle comes from applying t k times, until
+         * applying it once more gets back to the leader */
+        struct in_place p;
+        p.methods = methods;
+        p.array = array;
+        p.width = width;
+        p.height = height;
+        p.size = methods->size(array);
+        p.t = t;
+        p.members = 1;
+        p.map[0] = mappings[TRANSFORM_ROTATE_0];
+        for (Transform_T power = t; power != TRANSFORM_ROTATE_0;
+             power = Transform_compose(power, t)) {
+                assert(p.members < 4);
+                p.map[p.members++] = mappings[power];
+        }
+        assert(p.members == 2 || p.members == 4);
+        int span;
+        methods->span_at(array, 0, 0, &span);
+        p.narrow = span < MIN_TILE && span < width;
+        p.held = malloc(p.size);
+        assert(p.held != NULL);
+
+        switch (t) {
+        case TRANSFORM_ROTATE_90:
+        case TRANSFORM_ROTATE_270:
+                leaders(&p, 0, (width + 1) / 2, 0, height / 2);
+                break;
+        case TRANSFORM_FLIP_HORIZONTAL:
+                leaders(&p, 0, width / 2, 0, height);
+                break;
+        case TRANSFORM_ROTATE_180:
+                /* the middle row of an odd height pairs up within itself */
+                leaders(&p, 0, width, 0, height / 2);
+                leaders(&p, 0, width / 2, height / 2, (height + 1) / 2);
+                break;
+        case TRANSFORM_FLIP_VERTICAL:
+                leaders(&p, 0, width, 0, height / 2);
+                break;
+        default:        /* transpose or transverse, of a square */
+                leaders(&p, 0, width, 0, height);
+                break;
+        }
+        free(p.held);
+}
+
+static inline int round_up(int n, int multiple)
+{
+        return (n + multiple - 1) / multiple * multiple;
+}
+
+/* static void halve_rect(struct tiling *t, int x0, int x1, int y0, int y1)
+ * Parameters: struct tiling *t - the transformation being applied
+ *             int x0, int x1, int y0, int y1 - a rectangle of the
+ *                     destination, as for transform_rect
+ *    Returns: Nothing
+ *       Does: Splits the rectangle in two across its longer side, first
+ *             half first, until it is small enough to copy. Whatever the
+ *             cache sizes, some level of the recursion has rectangles
+ *             whose source and destination fit in each of them. Halves
+ *             are rounded to whole MIN_TILE cells, which suits the
+ *             vector copy loops and has nothing to do with any cache
+ *   if Error: None
+ */
+static void halve_rect(struct tiling *t, int x0, int x1, int y0, int y1)
+{
+        int across = x1 - x0;
+        int down = y1 - y0;
+        if (across <= 0 || down <= 0) {
+                return;
+        }
+        if (across <= OBLIVIOUS_BASE && down <= OBLIVIOUS_BASE) {
+                transform_rect(t, x0, x1, y0, y1);
+        } else if (across >= down) {
+                int mid = x0 + round_up(across / 2, MIN_TILE);
+                halve_rect(t, x0, mid, y0, y1);
+                halve_rect(t, mid, x1, y0, y1);
+        } else {
+                int mid = y0 + round_up(down / 2, MIN_TILE);
+                halve_rect(t, x0, x1, y0, mid);
+                halve_rect(t, x0, x1, mid, y1);
+        }
+}
+
+/* static void start_tiling(struct tiling *tiling, Transform_T t,
+ *                          A2Methods_T methods, A2 src, int src_row0,
+ *                          int src_height, A2 dst, int dst_row0)
+ * Parameters: struct tiling *tiling - filled in
+ *             the rest as for Transform_tiled_band
+ *    Returns: Nothing
+ *       Does: Checks the arguments and works out the kernels, the part
+ *             of the result that src and dst share, and the tiles to
+ *             use. A unit of work is a block of dst when it is blocked
+ *             and a cache tile otherwise
+ *   if Error: raises the assertions of Transform_tiled_band
+ */
+static void start_tiling(struct tiling *tiling, Transform_T t,
+                         A2Methods_T methods, A2 src, int src_row0,
+                         int src_height, A2 dst, int dst_row0)
+{
+        assert(methods != NULL && methods->span_at != NULL);
+        assert(src != NULL && dst != NULL);
+
+        tiling->methods = methods;
+        tiling->src = src;
+        tiling->dst = dst;
+        tiling->src_width = methods->width(src);
+        tiling->src_height = src_height;
+        tiling->src_row0 = src_row0;
+        tiling->dst_row0 = dst_row0;
+        tiling->size = methods->size(src);
+        tiling->map = mappings[t];
+        assert(methods->size(dst) == tiling->size);
+        assert(src_row0 >= 0 
+               && src_row0 + methods->height(src) <= src_height);
+
+        Transform_simd simd = simd_choice;
+        if (simd == TRANSFORM_SIMD_AUTO) {
+                simd = Transform_simd_best();
+        }
+        tiling->simd = Transform_simd_ops(simd, tiling->size);
+
+        Transform_dimensions(t, tiling->src_width, src_height,
+                             &tiling->width, &tiling->height);
+        assert(methods->width(dst) == tiling->width);
+        assert(dst_row0 >= 0 
+               && dst_row0 + methods->height(dst) <= tiling->height);
+
+        /* The source rows in src land in a range of result columns when
+         * swapping and of result rows otherwise; dst limits the rows */
+        int lo = src_row0;
+        int hi = src_row0 + methods->height(src);
+        if (tiling->map.flip_j) {
+                lo = src_height - hi;
+                hi = src_height - src_row0;
+        }
+        tiling->x0 = tiling->map.swap ? lo : 0;
+        tiling->x1 = tiling->map.swap ? hi : tiling->width;
+        tiling->y0 = dst_row0;
+        tiling->y1 = dst_row0 + methods->height(dst);
+        if (!tiling->map.swap) {
+                tiling->y0 = lo > tiling->y0 ? lo : tiling->y0;
+                tiling->y1 = hi < tiling->y1 ? hi : tiling->y1;
+        }
+
+        /* Tiles never straddle more blocks of dst than they must */
+        tiling->tile = Transform_tile_size(tiling->size);
+        tiling->unit = tiling->tile;
+        int blocksize = methods->blocksize(dst);
+        if (blocksize > 1) {
+                tiling->unit = blocksize;
+                if (blocksize < tiling->tile) {
+                        tiling->tile = blocksize;
+                }
+        }
+        int across = tiling->x1 - tiling->x0;
+        int down = tiling->y1 - tiling->y0;
+        tiling->units_across = across > 0 ? (across + tiling->unit - 1)
+                                            / tiling->unit : 0;
+        tiling->units_down = down > 0 ? (down + tiling->unit - 1)
+                                        / tiling->unit : 0;
+}
+
+/* static inline char *src_span(struct tiling *t, int i, int j, int *n)
+ * static inline char *dst_span(struct tiling *t, int x, int y, int *n)
+ * Does: span_at for a cell of the source image or of the result, given
+ *       by its row in the whole image rather than in the band held
+ */
+static inline char *src_span(struct tiling *t, int i, int j, int *n)
+{
+        return t->methods->span_at(t->src, i, j - t->src_row0, n);
+}
+
+static inline char *dst_span(struct tiling *t, int x, int y, int *n)
+{
+        return t->methods->span_at(t->dst, x, y - t->dst_row0, n);
+}
+
+/* static void transform_unit(int unit, int thread, void *vtiling)
+ * Parameters: int unit - number of the unit of work, counting units
+ *                        of dst in row-major order
+ *             int thread - number of the thread running it (unused)
+ *             void *vtiling - the struct tiling of the transformation
+ *    Returns: Nothing
+ *       Does: Fills the unit's square of dst one cache tile at a time
+ *   if Error: None
+ */
+static void transform_unit(int unit, int thread, void *vtiling)
+{
+        struct tiling *t = vtiling;
+        (void) thread;
+        int ux0 = t->x0 + (unit % t->units_across) * t->unit;
+        int uy0 = t->y0 + (unit / t->units_across) * t->unit;
+        int ux1 = ux0 + t->unit < t->x1 ? ux0 + t->unit : t->x1;
+        int uy1 = uy0 + t->unit < t->y1 ? uy0 + t->unit : t->y1;
+
+        for (int y0 = uy0; y0 < uy1; y0 += t->tile) {
+                int y1 = y0 + t->tile < uy1 ? y0 + t->tile : uy1;
+                for (int x0 = ux0; x0 < ux1; x0 += t->tile) {
+                        int x1 = x0 + t->tile < ux1 ? x0 + t->tile : ux1;
+                        transform_rect(t, x0, x1, y0, y1);
+                }
+        }
+}
+
+/* static void transform_rect(struct tiling *t,
+ *                            int x0, int x1, int y0, int y1)
+ * Parameters: struct tiling *t - the transformation being applied
+ *             int x0, int x1 - destination columns x0 up to (not
+ *                              including) x1
+ *             int y0, int y1 - destination rows y0 up to (not
+ *                              including) y1
+ *    Returns: Nothing
+ *       Does: Fills a rectangle of the destination. The copy loops need
+ *             each destination row of the rectangle, and each source
+ *             run it reads from, to be a single span, so a rectangle
+ *             that crosses a span boundary (a block edge) is first
+ *             split there
+ *   if Error: None
+ */
+static void transform_rect(struct tiling *t, int x0, int x1, int y0, int y1)
+{
+        if (x0 >= x1 || y0 >= y1) {
+                return;
+        }
+        int n;
+
+        /* Destination rows of the rectangle must each be one span */
+        dst_span(t, x0, y0, &n);
+        if (n < x1 - x0) {
+                transform_rect(t, x0, x0 + n, y0, y1);
+                transform_rect(t, x0 + n, x1, y0, y1);
+                return;
+        }
+
+        /* Source columns read for one destination row (or column, when
+         * swapping) are lo up to lo + len and must be one span too;
+         * when they are read in reverse the span covers the end of the
+         * destination range rather than its start */
+        int first = t->map.swap ? y0 : x0;
+        int last = t->map.swap ? y1 : x1;
+        int len = last - first;
+        int lo = t->map.flip_i ? t->src_width - last : first;
+        int any_row = t->map.swap ? x0 : y0;
+        if (t->map.flip_j) {
+                any_row = t->src_height - 1 - any_row;
+        }
+        src_span(t, lo, any_row, &n);
+        if (n < len) {
+                int mid = t->map.flip_i ? last - n : first + n;
+                if (t->map.swap) {
+                        transform_rect(t, x0, x1, y0, mid);
+                        transform_rect(t, x0, x1, mid, y1);
+                } else {
+                        transform_rect(t, x0, mid, y0, y1);
+                        transform_rect(t, mid, x1, y0, y1);
+                }
+                return;
+        }
+
+        if (t->map.swap) {
+                copy_cols(t, x0, x1, y0, y1);
+        } else {
+                copy_rows(t, x0, x1, y0, y1);
+        }
+}
+
+/* static inline void copy_cell(char *to, const char *from, int size)
+ * Does: Copies one cell; the kernels below are instantiated with a
+ *       constant size so this compiles to a few moves rather than a
+ *       call to memcpy
+ */
+static inline void copy_cell(char *to, const char *from, int size)
+{
+        memcpy(to, from, size);
+}
+
+/* static inline void rows_kernel(struct tiling *t, int x0, int x1,
+ *                                int y0, int y1, int size)
+ * Does: Body of copy_rows for cells of 'size' bytes: every destination
+ *       row comes from a single source row, read forwards or backwards
+ */
+static inline void rows_kernel(struct tiling *t, int x0, int x1,
+                               int y0, int y1, int size)
+{
+        int len = x1 - x0;
+        int lo = t->map.flip_i ? t->src_width - x1 : x0;
+        int n;
+
+        for (int y = y0; y < y1; y++) {
+                int j = t->map.flip_j ? t->src_height - 1 - y : y;
+                char *to = dst_span(t, x0, y, &n);
+                const char *from = src_span(t, lo, j, &n);
+                if (!t->map.flip_i) {
+                        memcpy(to, from, (size_t) len * size);
+                        continue;
+                }
+                if (t->simd != NULL) {
+                        t->simd->reverse(to, from, len);
+                        continue;
+                }
+                from += (size_t) (len - 1) * size;
+                for (int k = 0; k < len; k++, to += size, from -= size) {
+                        copy_cell(to, from, size);
+                }
+        }
+}
+
+/* static int cols_simd(struct tiling *t, const char *const rows[],
+ *                      int lo, int x0, int x1, int y0, int y1)
+ * Does: Fills as many whole groups of 'side' destination rows of the
+ *       rectangle as it can with the vector transpose, finishing the
+ *       columns that do not fill a square one cell at a time, and
+ *       returns the first destination row it did not fill
+ */
+static int cols_simd(struct tiling *t, const char *const rows[],
+                     int lo, int x0, int x1, int y0, int y1)
+{
+        int side = t->simd->side;
+        int size = t->size;
+        int len = x1 - x0;
+        int n;
+        int y = y0;
+
+        for (; y + side <= y1; y += side) {
+                /* Destination row r of the group reads source cell 
+                 * base + r, so with a reversed source the group's rows
+                 * are taken bottom up */
+                char *to_rows[TRANSFORM_SIMD_MAX_SIDE];
+                for (int r = 0; r < side; r++) {
+                        int row = t->map.flip_i ? y + side - 1 - r : y + r;
+                        to_rows[r] = dst_span(t, x0, row, &n);
+                }
+                int low_i = t->map.flip_i ? t->src_width - y - side : y;
+                size_t base = (size_t) (low_i - lo) * size;
+
+                int k = 0;
+                for (; k + side <= len; k += side) {
+                        const char *from[TRANSFORM_SIMD_MAX_SIDE];
+                        char *to[TRANSFORM_SIMD_MAX_SIDE];
+                        for (int q = 0; q < side; q++) {
+                                from[q] = rows[k + q] + base;
+                                to[q] = to_rows[q] + (size_t) k * size;
+                        }
+                        t->simd->transpose(from, to);
+                }
+                for (; k < len; k++) {
+                        for (int r = 0; r < side; r++) {
+                                memcpy(to_rows[r] + (size_t) k * size,
+                                       rows[k] + base + (size_t) r * size,
+                                       size);
+                        }
+                }
+        }
+        return y;
+}
+
+/* static inline void cols_kernel(struct tiling *t, int x0, int x1,
+ *                                int y0, int y1, int size)
+ * Does: Body of copy_cols for cells of 'size' bytes: destination row y
+ *       is read down a source column, so the source rows the tile
+ *       touches are located once and then indexed by y; when SIMD
+ *       kernels are in use they fill most of the rows
+ */
+static inline void cols_kernel(struct tiling *t, int x0, int x1,
+                               int y0, int y1, int size)
+{
+        const char *rows[MAX_TILE];
+        int len = x1 - x0;
+        int lo = t->map.flip_i ? t->src_width - y1 : y0;
+        int n;
+
+        assert(len <= MAX_TILE);
+        for (int k = 0; k < len; k++) {
+                int j = t->map.flip_j ? t->src_height - 1 - (x0 + k)
+                                      : x0 + k;
+                rows[k] = src_span(t, lo, j, &n);
+        }
+        if (t->simd != NULL) {
+                y0 = cols_simd(t, rows, lo, x0, x1, y0, y1);
+        }
+        for (int y = y0; y < y1; y++) {
+                int i = t->map.flip_i ? t->src_width - 1 - y : y;
+                size_t offset = (size_t) (i - lo) * size;
+                char *to = dst_span(t, x0, y, &n);
+                for (int k = 0; k < len; k++, to += size) {
+                        copy_cell(to, rows[k] + offset, size);
+                }
+        }
+}
+
+/* static void copy_rows(struct tiling *t, int x0, int x1, int y0, int y1)
+ * static void copy_cols(struct tiling *t, int x0, int x1, int y0, int y1)
+ * Parameters: struct tiling *t - the transformation being applied
+ *             int x0, x1, y0, y1 - the destination rectangle, which
+ *                                  transform_rect has made span aligned
+ *    Returns: Nothing
+ *       Does: Fill the rectangle, using a kernel specialized to the size
+ *             of the cells when it is a common one
+ *   if Error: None
+ */
+static void copy_rows(struct tiling *t, int x0, int x1, int y0, int y1)
+{
+        switch (t->size) {
+        case 12: rows_kernel(t, x0, x1, y0, y1, 12);      break;
+        case 4:  rows_kernel(t, x0, x1, y0, y1, 4);       break;
+        case 3:  rows_kernel(t, x0, x1, y0, y1, 3);       break;
+        default: rows_kernel(t, x0, x1, y0, y1, t->size); break;
+        }
+}
+
+static void copy_cols(struct tiling *t, int x0, int x1, int y0, int y1)
+{
+        switch (t->size) {
+        case 12: cols_kernel(t, x0, x1, y0, y1, 12);      break;
+        case 4:  cols_kernel(t, x0, x1, y0, y1, 4);       break;
+        case 3:  cols_kernel(t, x0, x1, y0, y1, 3);       break;
+        default: cols_kernel(t, x0, x1, y0, y1, t->size); break;
+        }
+}
+
+/* static void leaders(struct in_place *p, int x0, int x1, int y0, int y1)
+ * Parameters: struct in_place *p - the transformation being done
+ *             int x0, x1, y0, y1 - a rectangle of leaders, columns x0 up
+ *                                  to x1 and rows y0 up to y1 (for a
+ *                                  transpose or transverse, the part of
+ *                                  it on the leaders' side of the
+ *                                  diagonal)
+ *    Returns: Nothing
+ *       Does: Rotates the cycles the rectangle leads a tile at a time.
+ *             The tiles of one cycle's members, one for each, fit in the
+ *             L1 data cache
+ *   if Error: None
+ */
+static void leaders(struct in_place *p, int x0, int x1, int y0, int y1)
+{
+        int tile = Transform_tile_size(p->size);
+        for (int ty = y0; ty < y1; ty += tile) {
+                int ty1 = ty + tile < y1 ? ty + tile : y1;
+                for (int tx = x0; tx < x1; tx += tile) {
+                        int tx1 = tx + tile < x1 ? tx + tile : x1;
+                        cycle_rect(p, tx, tx1, ty, ty1);
+                }
+        }
+}
+
+/* static inline void cycle_kernel(struct in_place *p, int x0, int x1,
+ *                                 int y0, int y1, int size, int members)
+ * Does: Body of cycle_rect for cells of 'size' bytes in cycles of
+ *       'members' cells: along a row of leaders, a member that does not
+ *       swap moves along a single row, forwards or backwards, and one
+ *       that swaps moves down a column, one row pointer to the next
+ */
+static inline void cycle_kernel(struct in_place *p, int x0, int x1,
+                                int y0, int y1, int size, int members)
+{
+        for (int y = y0; y < y1; y++) {
+                int xa = x0;
+                int xb = x1;
+                if (p->t == TRANSFORM_TRANSPOSE && xa <= y) {
+                        xa = y + 1;
+                } else if (p->t == TRANSFORM_TRANSVERSE
+                           && xb > p->width - 1 - y) {
+                        xb = p->width - 1 - y;
+                }
+
+                /* A member that swaps is at the same place in each of its
+                 * row pointers; one that does not keeps to one of them */
+                char *row[4];
+                size_t offset[4];
+                for (int k = 0; k < members; k++) {
+                        struct mapping m = p->map[k];
+                        int i = m.flip_i ? y1 - 1 - y : y - y0;
+                        row[k] = m.swap ? NULL : p->rows[k][y - y0];
+                        offset[k] = m.swap ? (size_t) i * size : 0;
+                }
+
+                for (int x = xa; x < xb; x++) {
+                        char *cell[4];
+                        for (int k = 0; k < members; k++) {
+                                struct mapping m = p->map[k];
+                                int i = m.flip_i ? x1 - 1 - x : x - x0;
+                                cell[k] = m.swap
+                                          ? p->rows[k][x - x0] + offset[k]
+                                          : row[k] + (size_t) i * size;
+                        }
+                        copy_cell(p->held, cell[0], size);
+                        for (int k = 0; k + 1 < members; k++) {
+                                copy_cell(cell[k], cell[k + 1], size);
+                        }
+                        copy_cell(cell[members - 1], p->held, size);
+                }
+        }
+}
+
+/* static inline void cycle_sized(struct in_place *p, int x0, int x1,
+ *                                int y0, int y1, int size)
+ * Does: cycle_kernel for the pairs of a flip, 180 degree rotation,
+ *       transpose or transverse, or the fours of a quarter turn
+ */
+static inline void cycle_sized(struct in_place *p, int x0, int x1,
+                               int y0, int y1, int size)
+{
+        if (p->members == 2) {
+                cycle_kernel(p, x0, x1, y0, y1, size, 2);
+        } else {
+                cycle_kernel(p, x0, x1, y0, y1, size, 4);
+        }
+}
+
+/* static void cycle_rect(struct in_place *p, int x0, int x1, int y0,
+ *                        int y1)
+ * Parameters: struct in_place *p - the transformation being done
+ *             int x0, x1, y0, y1 - a rectangle of leaders, at most a tile
+ *    Returns: Nothing
+ *       Does: Finds the row pointers of every member of the rectangle's
+ *             cycles and rotates the cycles with a kernel specialized to
+ *             the size of the cells when it is a common one. The cells
+ *             of a member along a row (or, when it swaps, down a column)
+ *             of the rectangle must be one span, so a rectangle that
+ *             would cross a span boundary (a block edge) in some member
+ *             is split there first
+ *   if Error: None
+ */
+static void cycle_rect(struct in_place *p, int x0, int x1, int y0, int y1)
+{
+        if (x0 >= x1 || y0 >= y1
+            || (p->t == TRANSFORM_TRANSPOSE && x1 - 1 <= y0)
+            || (p->t == TRANSFORM_TRANSVERSE && x0 + y0 >= p->width - 1)) {
+                return;         /* no leaders */
+        }
+        if (p->narrow) {
+                cycle_at(p, x0, x1, y0, y1);
+                return;
+        }
+        for (int k = 0; k < p->members; k++) {
+                struct mapping m = p->map[k];
+                int first = m.swap ? y0 : x0;
+                int last = m.swap ? y1 : x1;
+                int lines = m.swap ? x1 - x0 : y1 - y0;
+                int line0 = m.swap ? x0 : y0;
+                int len = last - first;
+                int lo = m.flip_i ? p->width - last : first;
+                for (int a = 0; a < lines; a++) {
+                        int row = m.flip_j ? p->height - 1 - (line0 + a)
+                                           : line0 + a;
+                        int n;
+                        p->rows[k][a] = p->methods->span_at(p->array, lo,
+                                                            row, &n);
+                        if (n >= len) {
+                                continue;
+                        }
+                        int mid = m.flip_i ? last - n : first + n;
+                        if (m.swap) {
+                                cycle_rect(p, x0, x1, y0, mid);
+                                cycle_rect(p, x0, x1, mid, y1);
+                        } else {
+                                cycle_rect(p, x0, mid, y0, y1);
+                                cycle_rect(p, mid, x1, y0, y1);
+                        }
+                        return;
+                }
+        }
+
+        switch (p->size) {
+        case 12: cycle_sized(p, x0, x1, y0, y1, 12);      break;
+        case 4:  cycle_sized(p, x0, x1, y0, y1, 4);       break;
+        case 3:  cycle_sized(p, x0, x1, y0, y1, 3);       break;
+        default: cycle_sized(p, x0, x1, y0, y1, p->size); break;
+        }
+}
+
+/* static void cycle_at(struct in_place *p, int x0, int x1, int y0, int y1)
+ * Parameters: as for cycle_rect
+ *    Returns: Nothing
+ *       Does: Rotates the cycles the rectangle leads finding each member
+ *             with at, for arrays whose spans are only a cell or two
+ *             (Morton order), where row pointers would cover too little
+ *             to pay for finding them
+ *   if Error: None
+ */
+static void cycle_at(struct in_place *p, int x0, int x1, int y0, int y1)
+{
+        int size = p->size;
+        for (int y = y0; y < y1; y++) {
+                int xa = x0;
+                int xb = x1;
+                if (p->t == TRANSFORM_TRANSPOSE && xa <= y) {
+                        xa = y + 1;
+                } else if (p->t == TRANSFORM_TRANSVERSE
+                           && xb > p->width - 1 - y) {
+                        xb = p->width - 1 - y;
+                }
+                for (int x = xa; x < xb; x++) {
+                        char *cell[4];
+                        for (int k = 0; k < p->members; k++) {
+                                struct mapping m = p->map[k];
+                                int i = m.swap ? y : x;
+                                int j = m.swap ? x : y;
+                                if (m.flip_i) {
+                                        i = p->width - 1 - i;
+                                }
+                                if (m.flip_j) {
+                                        j = p->height - 1 - j;
+                                }
+                                cell[k] = p->methods->at(p->array, i, j);
+                        }
+                        memcpy(p->held, cell[0], size);
+                        for (int k = 0; k + 1 < p->members; k++) {
+                                memcpy(cell[k], cell[k + 1], size);
+                        }
+                        memcpy(cell[p->members - 1], p->held, size);
+                }
+        }
+}
@@ -0,0 +1,131 @@
+#ifndef TRANSFORM_INCLUDED
+#define TRANSFORM_INCLUDED
+
+#include "a2methods.h"
+#include "workpool.h"
+
+#define A2 A2Methods_UArray2
+
+/* geometric transformations of an image (the eight symmetries of a
+ * rectangle); rotations are clockwise
+ */
+typedef enum Transform_T {
+        TRANSFORM_ROTATE_0,
+        TRANSFORM_ROTATE_90,
+        TRANSFORM_ROTATE_180,
+        TRANSFORM_ROTATE_270,
+        TRANSFORM_FLIP_HORIZONTAL,      /* mirror left to right */
+        TRANSFORM_FLIP_VERTICAL,        /* mirror top to bottom */
+        TRANSFORM_TRANSPOSE,            /* mirror in the main diagonal */
+        TRANSFORM_TRANSVERSE            /* mirror in the other diagonal */
+} Transform_T;
+
+/* instruction sets the tiled kernels can move cells with */
+typedef enum Transform_simd {
+        TRANSFORM_SIMD_AUTO,            /* the best this CPU supports */
+        TRANSFORM_SIMD_SCALAR,          /* plain C, no vector registers */
+        TRANSFORM_SIMD_SSE2,
+        TRANSFORM_SIMD_AVX2
+} Transform_simd;
+
+/* human readable description of t, e.g. "Rotation of 90 degrees" */
+extern const char *Transform_name(Transform_T t);
+
+/* the single transform with the effect of applying 'first' and then
+ * 'then' (the eight transforms are closed under composition)
+ */
+extern Transform_T Transform_compose(Transform_T first, Transform_T then);
+
+/* sets *out_width and *out_height to the dimensions of the result of
+ * applying t to an image of the given width and height
+ */
+extern void Transform_dimensions(Transform_T t, int width, int height,
+                                 int *out_width, int *out_height);
+
+/* nonzero if the rows of the result of t come from columns of the source
+ * (t swaps the dimensions)
+ */
+extern int Transform_swaps(Transform_T t);
+
+/* nonzero if t puts the top of the source at the bottom of the result
+ * (or at the right, when it swaps)
+ */
+extern int Transform_flips_rows(Transform_T t);
+
+/* nonzero if t puts the left of the source at the bottom of the result
+ * (or at the right, when it does not swap)
+ */
+extern int Transform_flips_cols(Transform_T t);
+
+/* side, in cells, of the square tiles Transform_tiled uses for cells of
+ * 'size' bytes: a source tile and a destination tile together fill no
+ * more than half of the L1 data cache
+ */
+extern int Transform_tile_size(int size);
+
+/* writes the result of applying t to src into dst, one destination tile
+ * at a time, copying cells directly between spans of the two arrays
+ *
+ * dst must have the dimensions given by Transform_dimensions, both arrays
+ * must belong to 'methods' and have cells of the same size, and methods
+ * must provide span_at (checked runtime errors)
+ */
+extern void Transform_tiled(Transform_T t, A2Methods_T methods,
+                            A2 src, A2 dst);
+
+/* Transform_tiled, with the units of work shared between the threads of
+ * 'pool'; the result is identical to Transform_tiled's
+ */
+extern void Transform_tiled_parallel(Transform_T t, A2Methods_T methods,
+                                     A2 src, A2 dst, Workpool_T pool);
+
+/* Transform_tiled without tiles sized for the cache: the result is
+ * halved across its longer side, again and again, down to a few cells
+ * each way, so that the copying has locality at every level of the
+ * memory hierarchy without knowing any cache size (cache oblivious);
+ * the requirements and the result are those of Transform_tiled
+ */
+extern void Transform_oblivious(Transform_T t, A2Methods_T methods,
+                                A2 src, A2 dst);
+
+/* Transform_tiled for bands of rows: src holds rows src_row0 onwards of
+ * a source image src_height rows tall, dst holds rows dst_row0 onwards of
+ * the result, and every cell of dst whose source cell is in src is filled
+ *
+ * src and dst must be as wide as the source image and the result, and lie
+ * within them (checked runtime errors)
+ */
+extern void Transform_tiled_band(Transform_T t, A2Methods_T methods,
+                                 A2 src, int src_row0, int src_height,
+                                 A2 dst, int dst_row0);
+
+/* nonzero if Transform_in_place can apply t to an array of 'methods' of
+ * the given dimensions: t keeps them, the array is square, or methods
+ * can transpose it
+ */
+extern int Transform_in_place_ok(Transform_T t, A2Methods_T methods,
+                                 int width, int height);
+
+/* replaces the cells of 'array' with the result of applying t to them,
+ * using no second array: each cycle of cells t moves around (a pair, or
+ * four cells of a square rotated by 90 or 270 degrees) is rotated through
+ * a single cell's worth of storage, visiting only the cell that leads
+ * each cycle, a tile at a time; methods must provide span_at. A
+ * transformation that changes the dimensions starts with the methods'
+ * transpose, and the array takes the result's dimensions
+ *
+ * it is a checked runtime error if Transform_in_place_ok is 0 for the
+ * array
+ */
+extern void Transform_in_place(Transform_T t, A2Methods_T methods, A2 array);
+
+/* makes the tiled kernels use instruction set simd from now on (the
+ * default is TRANSFORM_SIMD_AUTO); returns 0 and changes nothing if this
+ * CPU does not support it, nonzero otherwise
+ *
+ * every choice produces the same result, only the speed differs
+ */
+extern int Transform_set_simd(Transform_simd simd);
+
+#undef A2
+#endif
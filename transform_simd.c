@@ -0,0 +1,303 @@
+/* HW3 - Locality
+ * transform_simd.c
+ * Function: SSE2 and AVX2 versions of the innermost steps of the tiled
+ *           kernels in transform.c. Small squares of cells are loaded
+ *           into vector registers, transposed or reversed there, and
+ *           stored, instead of being moved one cell at a time. Each
+ *           function is compiled for its own instruction set with a
+ *           target attribute and only called after CPUID (through
+ *           __builtin_cpu_supports) says the CPU has it.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "transform_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+/* static void reverse_tail(char *to, const char *from, int n, int done,
+ *                          int size)
+ * Does: Scalar end of the reverse kernels, for cells k from done to n
+ *       that do not fill a whole vector
+ */
+static void reverse_tail(char *to, const char *from, int n, int done,
+                         int size)
+{
+        for (int k = done; k < n; k++) {
+                memcpy(to + (size_t) k * size, 
+                       from + (size_t) (n - 1 - k) * size, size);
+        }
+}
+
+/* static void transpose4_sse2(const char *const from[],
+ *                             char *const to[])
+ * Does: 4 x 4 transpose of 4-byte cells, one row per register
+ */
+SSE2 static void transpose4_sse2(const char *const from[], char *const to[])
+{
+        __m128i r0 = _mm_loadu_si128((const __m128i *) from[0]);
+        __m128i r1 = _mm_loadu_si128((const __m128i *) from[1]);
+        __m128i r2 = _mm_loadu_si128((const __m128i *) from[2]);
+        __m128i r3 = _mm_loadu_si128((const __m128i *) from[3]);
+
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+        __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+        __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+        _mm_storeu_si128((__m128i *) to[0], _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *) to[1], _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *) to[2], _mm_unpacklo_epi64(t2, t3));
+        _mm_storeu_si128((__m128i *) to[3], _mm_unpackhi_epi64(t2, t3));
+}
+
+/* static void reverse4_sse2(char *to, const char *from, int n)
+ * Does: Reverses 4-byte cells four at a time
+ */
+SSE2 static void reverse4_sse2(char *to, const char *from, int n)
+{
+        int k = 0;
+        for (; k + 4 <= n; k += 4) {
+                __m128i x = _mm_loadu_si128((const __m128i *)
+                                            (from + (size_t) (n - 4 - k) * 4));
+                _mm_storeu_si128((__m128i *) (to + (size_t) k * 4),
+                                 _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 1, 2, 3)));
+        }
+        reverse_tail(to, from, n, k, 4);
+}
+
+/* Four 12-byte cells (such as struct Pnm_rgb) fill exactly three
+ * registers, lanes holding channels as r0 g0 b0 r1 | g1 b1 r2 g2 |
+ * b2 r3 g3 b3. The shuffles below are bitwise, so treating the lanes
+ * as floats never changes a value.
+ */
+
+/* static void split_rgb(__m128 a0, __m128 a1, __m128 a2,
+ *                       __m128 *r, __m128 *g, __m128 *b)
+ * Does: Separates four interleaved cells into one register per channel
+ */
+SSE2 static inline void split_rgb(__m128 a0, __m128 a1, __m128 a2,
+                                  __m128 *r, __m128 *g, __m128 *b)
+{
+        __m128 t = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(1, 1, 2, 2));
+        *r = _mm_shuffle_ps(a0, t, _MM_SHUFFLE(2, 0, 3, 0));
+
+        __m128 p = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 0, 1, 1));
+        __m128 w = _mm_shuffle_ps(p, a2, _MM_SHUFFLE(2, 2, 3, 3));
+        *g = _mm_shuffle_ps(p, w, _MM_SHUFFLE(2, 0, 2, 0));
+
+        __m128 q = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 1, 2, 2));
+        *b = _mm_shuffle_ps(q, a2, _MM_SHUFFLE(3, 0, 2, 0));
+}
+
+/* static void store_rgb(char *to, __m128 r, __m128 g, __m128 b)
+ * Does: Interleaves one register per channel back into four cells
+ */
+SSE2 static inline void store_rgb(char *to, __m128 r, __m128 g, __m128 b)
+{
+        __m128 x, y;
+
+        x = _mm_shuffle_ps(r, g, _MM_SHUFFLE(0, 0, 0, 0));
+        y = _mm_shuffle_ps(b, r, _MM_SHUFFLE(1, 1, 0, 0));
+        _mm_storeu_ps((float *) to,
+                      _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0)));
+
+        x = _mm_shuffle_ps(g, b, _MM_SHUFFLE(1, 1, 1, 1));
+        y = _mm_shuffle_ps(r, g, _MM_SHUFFLE(2, 2, 2, 2));
+        _mm_storeu_ps((float *) (to + 16),
+                      _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0)));
+
+        x = _mm_shuffle_ps(b, r, _MM_SHUFFLE(3, 3, 2, 2));
+        y = _mm_shuffle_ps(g, b, _MM_SHUFFLE(3, 3, 3, 3));
+        _mm_storeu_ps((float *) (to + 32),
+                      _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+/* static void transpose12_sse2(const char *const from[],
+ *                              char *const to[])
+ * Does: 4 x 4 transpose of 12-byte cells: each source run is split into
+ *       channels, the three 4 x 4 channel matrices are transposed, and
+ *       the channels are interleaved again
+ */
+SSE2 static void transpose12_sse2(const char *const from[], char *const to[])
+{
+        __m128 r[4], g[4], b[4];
+        for (int q = 0; q < 4; q++) {
+                const float *src = (const float *) from[q];
+                split_rgb(_mm_loadu_ps(src), _mm_loadu_ps(src + 4),
+                          _mm_loadu_ps(src + 8), &r[q], &g[q], &b[q]);
+        }
+        _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+        _MM_TRANSPOSE4_PS(g[0], g[1], g[2], g[3]);
+        _MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+        for (int q = 0; q < 4; q++) {
+                store_rgb(to[q], r[q], g[q], b[q]);
+        }
+}
+
+/* static void reverse12_sse2(char *to, const char *from, int n)
+ * Does: Reverses 12-byte cells four at a time, turning
+ *       p0 p1 p2 p3 into p3 p2 p1 p0 within three registers
+ */
+SSE2 static void reverse12_sse2(char *to, const char *from, int n)
+{
+        int k = 0;
+        for (; k + 4 <= n; k += 4) {
+                const float *src = (const float *)
+                                   (from + (size_t) (n - 4 - k) * 12);
+                float *dst = (float *) (to + (size_t) k * 12);
+                __m128 a0 = _mm_loadu_ps(src);
+                __m128 a1 = _mm_loadu_ps(src + 4);
+                __m128 a2 = _mm_loadu_ps(src + 8);
+
+                __m128 t = _mm_shuffle_ps(a2, a1, _MM_SHUFFLE(2, 2, 3, 3));
+                _mm_storeu_ps(dst,
+                              _mm_shuffle_ps(a2, t, _MM_SHUFFLE(2, 0, 2, 1)));
+
+                __m128 t1 = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(0, 0, 3, 3));
+                __m128 t2 = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(0, 0, 3, 3));
+                _mm_storeu_ps(dst + 4,
+                              _mm_shuffle_ps(t1, t2, _MM_SHUFFLE(2, 0, 2, 0)));
+
+                __m128 t3 = _mm_shuffle_ps(a1, a0, _MM_SHUFFLE(0, 0, 1, 1));
+                _mm_storeu_ps(dst + 8,
+                              _mm_shuffle_ps(t3, a0, _MM_SHUFFLE(2, 1, 2, 0)));
+        }
+        reverse_tail(to, from, n, k, 12);
+}
+
+/* static void transpose4_avx2(const char *const from[],
+ *                             char *const to[])
+ * Does: 8 x 8 transpose of 4-byte cells: interleave 32-bit then 64-bit
+ *       lanes within each 128-bit half, then swap halves
+ */
+AVX2 static void transpose4_avx2(const char *const from[], char *const to[])
+{
+        __m256i r[8], t[8], u[8];
+        for (int q = 0; q < 8; q++) {
+                r[q] = _mm256_loadu_si256((const __m256i *) from[q]);
+        }
+        for (int q = 0; q < 8; q += 2) {
+                t[q] = _mm256_unpacklo_epi32(r[q], r[q + 1]);
+                t[q + 1] = _mm256_unpackhi_epi32(r[q], r[q + 1]);
+        }
+        for (int q = 0; q < 8; q += 4) {
+                u[q] = _mm256_unpacklo_epi64(t[q], t[q + 2]);
+                u[q + 1] = _mm256_unpackhi_epi64(t[q], t[q + 2]);
+                u[q + 2] = _mm256_unpacklo_epi64(t[q + 1], t[q + 3]);
+                u[q + 3] = _mm256_unpackhi_epi64(t[q + 1], t[q + 3]);
+        }
+        for (int q = 0; q < 4; q++) {
+                _mm256_storeu_si256((__m256i *) to[q],
+                        _mm256_permute2x128_si256(u[q], u[q + 4], 0x20));
+                _mm256_storeu_si256((__m256i *) to[q + 4],
+                        _mm256_permute2x128_si256(u[q], u[q + 4], 0x31));
+        }
+}
+
+/* static void reverse4_avx2(char *to, const char *from, int n)
+ * Does: Reverses 4-byte cells eight at a time
+ */
+AVX2 static void reverse4_avx2(char *to, const char *from, int n)
+{
+        const __m256i backwards = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        int k = 0;
+        for (; k + 8 <= n; k += 8) {
+                __m256i x = _mm256_loadu_si256((const __m256i *)
+                                               (from + (size_t) (n - 8 - k)
+                                                       * 4));
+                _mm256_storeu_si256((__m256i *) (to + (size_t) k * 4),
+                                    _mm256_permutevar8x32_epi32(x,
+                                                                backwards));
+        }
+        reverse_tail(to, from, n, k, 4);
+}
+
+static const struct Transform_simd_ops sse2_4 = {
+        4, transpose4_sse2, reverse4_sse2
+};
+static const struct Transform_simd_ops sse2_12 = {
+        4, transpose12_sse2, reverse12_sse2
+};
+static const struct Transform_simd_ops avx2_4 = {
+        8, transpose4_avx2, reverse4_avx2
+};
+
+/* int Transform_simd_supported(Transform_simd simd)
+ * Parameters: Transform_simd simd - an instruction set
+ *    Returns: nonzero if this CPU can run it
+ *       Does: Asks CPUID, through the compiler's builtin
+ *   if Error: None
+ */
+int Transform_simd_supported(Transform_simd simd)
+{
+        switch (simd) {
+        case TRANSFORM_SIMD_SSE2: return __builtin_cpu_supports("sse2");
+        case TRANSFORM_SIMD_AVX2: return __builtin_cpu_supports("avx2");
+        default:                  return 1;
+        }
+}
+
+/* const struct Transform_simd_ops *Transform_simd_ops(Transform_simd simd,
+ *                                                     int size)
+ * Parameters: Transform_simd simd - an instruction set other than AUTO
+ *             int size - bytes in a cell
+ *    Returns: the kernels for that pair, or NULL if there are none
+ *       Does: 12-byte cells have no AVX2 transpose (four of them fill
+ *             three SSE registers exactly, eight would not fill AVX2
+ *             registers any better), so AVX2 falls back to SSE2 there
+ *   if Error: None
+ */
+const struct Transform_simd_ops *Transform_simd_ops(Transform_simd simd,
+                                                    int size)
+{
+        if (simd == TRANSFORM_SIMD_AVX2 && size == 4) {
+                return &avx2_4;
+        }
+        if (simd == TRANSFORM_SIMD_AVX2 || simd == TRANSFORM_SIMD_SSE2) {
+                if (size == 4) {
+                        return &sse2_4;
+                } else if (size == 12) {
+                        return &sse2_12;
+                }
+        }
+        return NULL;
+}
+
+#else   /* not x86: only the scalar loops exist */
+
+int Transform_simd_supported(Transform_simd simd)
+{
+        return simd == TRANSFORM_SIMD_AUTO || simd == TRANSFORM_SIMD_SCALAR;
+}
+
+const struct Transform_simd_ops *Transform_simd_ops(Transform_simd simd,
+                                                    int size)
+{
+        (void) simd;
+        (void) size;
+        return NULL;
+}
+
+#endif
+
+/* Transform_simd Transform_simd_best(void)
+ * Parameters: None
+ *    Returns: the widest instruction set this CPU supports
+ *       Does: Tries the instruction sets from widest to narrowest
+ *   if Error: None
+ */
+Transform_simd Transform_simd_best(void)
+{
+        if (Transform_simd_supported(TRANSFORM_SIMD_AVX2)) {
+                return TRANSFORM_SIMD_AVX2;
+        } else if (Transform_simd_supported(TRANSFORM_SIMD_SSE2)) {
+                return TRANSFORM_SIMD_SSE2;
+        }
+        return TRANSFORM_SIMD_SCALAR;
+}
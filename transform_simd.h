@@ -0,0 +1,43 @@
+/* HW3 - Locality
+ * transform_simd.h
+ * Function: Private interface between transform.c and the SIMD kernels
+ *           in transform_simd.c; clients of the transform module use
+ *           Transform_set_simd in transform.h instead
+ */
+#ifndef TRANSFORM_SIMD_INCLUDED
+#define TRANSFORM_SIMD_INCLUDED
+
+#include "transform.h"
+
+/* largest 'side' of any kernel below */
+#define TRANSFORM_SIMD_MAX_SIDE 8
+
+/* register kernels for cells of one size on one instruction set
+ *
+ * transpose moves a square of side x side cells: for r and q below side,
+ *     cell q of the run starting at to[r] gets cell r of the run starting
+ *     at from[q], where each run is 'side' adjacent cells
+ * reverse copies n adjacent cells so that cell k of to gets cell
+ *     n - 1 - k of from, for any n >= 0
+ */
+struct Transform_simd_ops {
+        int side;
+        void (*transpose)(const char *const from[], char *const to[]);
+        void (*reverse)(char *to, const char *from, int n);
+};
+
+/* nonzero if this CPU can run code using simd
+ * (TRANSFORM_SIMD_AUTO and TRANSFORM_SIMD_SCALAR are always supported)
+ */
+extern int Transform_simd_supported(Transform_simd simd);
+
+/* the best instruction set this CPU supports */
+extern Transform_simd Transform_simd_best(void);
+
+/* kernels of instruction set simd for cells of 'size' bytes, or NULL
+ * when there are none and the scalar loops must be used
+ */
+extern const struct Transform_simd_ops *Transform_simd_ops(Transform_simd simd,
+                                                           int size);
+
+#endif
@@ -1,70 +1,75 @@
 #line 50 "www/solutions/uarray2.nw"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include "assert.h"
 #include "mem.h"
-#include "uarray.h"
 #include "uarray2.h"
+#include "a2alloc.h"
 
 #define T UArray2_T
 
+/* rows start on cache line boundaries */
+#define LINE 64
+
 /* 
  * Element (i, j) in the world of ideas maps to
- * rows[j][i] where the square brackets stand for access
- * to a Hanson UArray_T
+ * elems[j * stride + i * size], where elems is a single
+ * cache-line aligned block of 'height' rows, each 'stride'
+ * bytes long; stride is width * size rounded up to a whole
+ * number of cache lines, unless a transposition left too
+ * little room for that and the rows are packed together
  */
 struct T {
         int width, height;
         int size;
-        UArray_T rows; /* UArray_T of 'height' UArray_Ts,
-                          each of length 'width' and size 'size' */
+        size_t stride;  /* bytes from the start of one row to the next */
+        size_t bytes;   /* bytes in elems, at least height * stride */
+        char *elems;
 };
 #line 79 "www/solutions/uarray2.nw"
-static inline UArray_T row(T a, int j)
+static inline char *row(T a, int j)
 {
-        UArray_T *prow = UArray_at(a->rows, j);   /* Ramsey idiom */
-        return *prow;
+        return a->elems + (size_t)j * a->stride;
 }
 #line 92 "www/solutions/uarray2.nw"
 static int is_ok(T a)
 {
-        return a && UArray_length(a->rows) == a->height &&
-               UArray_size(a->rows) == sizeof(UArray_T) &&
-               (a->height == 0 || (UArray_length(row(a, 0)) == a->width
-                                   && UArray_size  (row(a, 0)) == a->size));
+        return a && a->elems && a->width >= 0 && a->height >= 0 &&
+               a->size > 0 && (a->stride % LINE == 0 ||
+                               a->stride == (size_t)a->width * a->size) &&
+               a->stride >= (size_t)a->width * a->size &&
+               a->bytes >= a->stride * a->height;
 }
 #line 109 "www/solutions/uarray2.nw"
 T UArray2_new(int width, int height, int size)
 {
-        int i;  /* interates over row number */
         T array;
+        assert(width >= 0 && height >= 0 && size > 0);
         NEW(array);
         array->width  = width;
         array->height = height;
         array->size   = size;
-        array->rows   = UArray_new(height, sizeof(UArray_T));
-        for (i = 0; i < height; i++) {
-                UArray_T *rowp = UArray_at(array->rows, i);
-                *rowp = UArray_new(width, size);
-        }
+        array->stride = ((size_t)width * size + LINE - 1) / LINE * LINE;
+        /* one allocation for every row, on huge pages if it is large */
+        array->bytes = array->stride * height;
+        array->elems = A2alloc_new(array->bytes);
         assert(is_ok(array));
         return array;
 }
 #line 131 "www/solutions/uarray2.nw"
 void UArray2_free(T *array2)
 {
-        int i;
         assert(array2 && *array2);
-        for (i = 0; i < (*array2)->height; i++) {
-                UArray_T p = row(*array2, i);
-                UArray_free(&p);
-        }
-        UArray_free(&(*array2)->rows);
+        A2alloc_free((*array2)->elems, (*array2)->bytes);
         FREE(*array2);
 }
 #line 151 "www/solutions/uarray2.nw"
 void *UArray2_at(T array2, int i, int j)
 {
         assert(array2);
-        return UArray_at(row(array2, j), i);
+        assert(i >= 0 && i < array2->width && j >= 0 && j < array2->height);
+        return row(array2, j) + (size_t)i * array2->size;
 }
 #line 162 "www/solutions/uarray2.nw"
 int UArray2_height(T array2)
@@ -93,11 +98,12 @@ void UArray2_map_row_major(T array2,
         assert(array2);
         int h = array2->height;  /* keeping height and width in registers */
         int w = array2->width;   /* avoids extra memory traffic           */
+        int size = array2->size;
         for (int j = 0; j < h; j++) {
-                /* don't want row/UArray_at in inner loop */
-                UArray_T thisrow = row(array2, j); 
-                for (int i = 0; i < w; i++)
-                        apply(i, j, array2, UArray_at(thisrow, i), cl);
+                /* cells of a row are adjacent: walk them with a pointer */
+                char *elem = row(array2, j);
+                for (int i = 0; i < w; i++, elem += size)
+                        apply(i, j, array2, elem, cl);
         }
 }
 #line 211 "www/solutions/uarray2.nw"
@@ -109,7 +115,89 @@ void UArray2_map_col_major(T array2,
         assert(array2);
         int h = array2->height;  /* keeping height and width in registers */
         int w = array2->width;   /* avoids extra memory traffic           */
-        for (int i = 0; i < w; i++)
-                for (int j = 0; j < h; j++)
-                        apply(i, j, array2, UArray_at(row(array2, j), i), cl);
-}
\ No newline at end of file
+        size_t stride = array2->stride;
+        for (int i = 0; i < w; i++) {
+                /* cells of a column are 'stride' bytes apart */
+                char *elem = array2->elems + (size_t)i * array2->size;
+                for (int j = 0; j < h; j++, elem += stride)
+                        apply(i, j, array2, elem, cl);
+        }
+}
+
+/*
+ * Transposing in place packs the rows together, permutes the
+ * cells of the packed matrix and spreads the new rows out
+ * again. In the packed matrix, the cell at offset n of the
+ * result comes from offset n * width mod (cells - 1) of the
+ * source (the first and last cells stay put), and following
+ * that from cell to cell goes round a cycle; a bitmap, one
+ * bit per cell, marks the cells already moved so that each
+ * cycle is followed once
+ */
+static void pack_rows(T a);
+static void spread_rows(T a, size_t stride);
+static void follow_cycles(char *elems, size_t width, size_t height,
+                          int size);
+
+void UArray2_transpose(T array2)
+{
+        assert(is_ok(array2));
+        int width = array2->width, height = array2->height;
+        size_t packed = (size_t)height * array2->size;
+        size_t stride = (packed + LINE - 1) / LINE * LINE;
+        if (stride * width > array2->bytes)
+                stride = packed;        /* no room to pad the rows */
+
+        pack_rows(array2);
+        follow_cycles(array2->elems, width, height, array2->size);
+        array2->width = height;
+        array2->height = width;
+        spread_rows(array2, stride);
+        assert(is_ok(array2));
+}
+
+static void pack_rows(T a)
+{
+        size_t packed = (size_t)a->width * a->size;
+        for (int j = 1; j < a->height; j++)
+                memmove(a->elems + j * packed, row(a, j), packed);
+        a->stride = packed;
+}
+
+static void spread_rows(T a, size_t stride)
+{
+        size_t packed = (size_t)a->width * a->size;
+        for (int j = a->height - 1; j > 0; j--)
+                memmove(a->elems + j * stride, a->elems + j * packed,
+                        packed);
+        a->stride = stride;
+}
+
+static void follow_cycles(char *elems, size_t width, size_t height,
+                          int size)
+{
+        size_t cells = width * height;
+        if (cells < 3)
+                return;
+        size_t last = cells - 1;
+        uint8_t *moved = calloc(cells / 8 + 1, 1);
+        char *held = malloc(size);
+        assert(moved != NULL && held != NULL);
+        for (size_t start = 1; start < last; start++) {
+                if (moved[start / 8] & (1 << start % 8))
+                        continue;
+                memcpy(held, elems + start * size, size);
+                size_t n = start;
+                for (;;) {
+                        moved[n / 8] |= 1 << n % 8;
+                        size_t from = (uint64_t)n * width % last;
+                        if (from == start)
+                                break;
+                        memcpy(elems + n * size, elems + from * size, size);
+                        n = from;
+                }
+                memcpy(elems + n * size, held, size);
+        }
+        free(held);
+        free(moved);
+}
@@ -11,8 +11,13 @@ extern void  UArray2_free  (T *array2);
 extern int   UArray2_width (T array2);
 extern int   UArray2_height(T array2);
 extern int   UArray2_size  (T array2);
+/* cells (i, j) and (i + 1, j) are adjacent in memory */
 extern void *UArray2_at    (T array2, int i, int j);
 extern void  UArray2_map_row_major(T array2, UArray2_applyfun apply, void *cl);
 extern void  UArray2_map_col_major(T array2, UArray2_applyfun apply, void *cl);
+/* in place, makes array2 height cells wide and width cells tall, with
+ * cell (i, j) holding what cell (j, i) held; needs only a bit per cell
+ */
+extern void  UArray2_transpose(T array2);
 #undef T
 #endif
\ No newline at end of file
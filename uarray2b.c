@@ -14,10 +14,9 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <math.h>
-#include "uarray.h"
 #include "uarray2b.h"
-#include "uarray2.h"                   
 #include "assert.h"
+#include "a2alloc.h"
 
 #define T UArray2b_T
 
@@ -26,13 +25,18 @@
  *          and block major accessing 
  * Data Structure: the two dimensional blocked array will contain 
  *                 data members to store the dimensions of the array,
- *                 the array itself will have a block as each element,
- *                 each block will be a UArray_T type which is a one
- *                 dimensional array
+ *                 the elements themselves live in one cache line aligned
+ *                 slab, with every block stored back to back in block-major
+ *                 order (blocks of a block row left to right, then the
+ *                 next block row) and every block blocksize * blocksize
+ *                 elements long, stored row major within the block
  * Math for Indexing: to get an element at col and row of the UArray2b_T
- *                    first, locate block with col and row
+ *                    first, the block index is computed as
+ *                    [blocked_width * (row / blocksize) + (col / blocksize)]
  *                    second, compute [blocksize * (row % blocksize) + 
- *                    (col % blocksize)] to get the 1D index using row and col
+ *                    (col % blocksize)] to get the index within the block,
+ *                    the element is at the sum of the block index times 
+ *                    the cells per block and the index within the block
  */
 struct T {
         int       height; /* number of elements in column of array */
@@ -40,26 +44,36 @@ struct T {
         int         size; /* size of a single element of array */
         int    blocksize; /* height and width of single block 
                            * (sqrt of the number of elements in a block) */
-        UArray2_T  array; /* a UArray2_T of blocks, each block is a UArray_T 
-                           * of elements */
+        int blocked_width;  /* number of blocks in a row of blocks */
+        int blocked_height; /* number of blocks in a column of blocks */
+        size_t block_bytes; /* bytes occupied by a single block */
+        char     *blocks; /* slab of blocked_width * blocked_height blocks */
+        size_t slab_bytes;  /* bytes in the slab */
 
 };
 
-static void apply_on_block(T array2b, 
+static void block_extent(T array2b, int block_col, int block_row,
+                         int *end_small_col, int *end_small_row);
+static void apply_on_block(T array2b, char *block,
                            int block_col, int block_row, 
                            int end_small_col, int end_small_row, 
                            void apply(int col, int row, 
                                       T array2b, void *elem, void *cl), 
                            void *cl);
-
+static void small_apply_on_block(T array2b, char *block,
+                                 int end_small_col, int end_small_row,
+                                 void apply(void *elem, void *cl),
+                                 void *cl);
 
 /* T UArray2b_new(int width, int height, int size, int blocksize)
  * Parameters: int width - desired total number of elements in row
  *             int height - desired total number of elements in column
  *             int size - the memory allocation size of a single element
  *             int blocksize - number of elements in row or column of a block
- *    Returns: UArray2b_T, with initialized data members and array of blocks
- *       Does: Initializes new UArray2b type based on the passed parameters
+ *    Returns: UArray2b_T, with initialized data members and a single
+ *             slab holding every block
+ *       Does: Initializes new UArray2b type based on the passed parameters,
+ *             the elements of the array are left uninitialized
  *   if Error: raises assertions 
  *             if height or width is less than zero
  *             if size or blocksize is less than or equal to zero 
@@ -85,35 +99,20 @@ T UArray2b_new(int width, int height, int size, int blocksize)
         blocked->height = height; 
         
         /* Calculates number of blocks needed along the width of the 
-         * image and the height of the image, rounds up using ceil to 
-         * account for cut blocks on the right and bottom edges of 
-         * the image */
-        int blocked_width = ceil((double) width / blocksize); 
-        int blocked_height = ceil((double) height / blocksize);
-        
-        /* Initialization of UArray2b->array to a UArray2 type with each 
-         * element of the array being a block with the dimensions 
-         * blocksize x blocksize */
-        blocked->array = UArray2_new(blocked_width,  
-                                     blocked_height, 
-                                     sizeof(UArray_T));
-
-        /* Initializes each element of UArray2b->array to a UArray_T type 
-         * which will store the elements of each block in the UArray_T */
-        for (int block_col = 0; block_col < blocked_width; block_col++) {
-                for (int block_row = 0; block_row < blocked_height; 
-                     block_row++) {
-
-                         /* Get the block at the current block indexes and 
-                          * initialize it to a new UArray_T, the elements of 
-                          * each block will be located next  to each other in 
-                          * memory to exhibit spacial locality */
-                        *(UArray_T *) UArray2_at(blocked->array, 
-                                                 block_col, block_row) 
-                        = UArray_new(blocksize * blocksize, size);
+         * image and the height of the image, rounds up to account for 
+         * cut blocks on the right and bottom edges of the image */
+        blocked->blocked_width = (width + blocksize - 1) / blocksize; 
+        blocked->blocked_height = (height + blocksize - 1) / blocksize;
+        blocked->block_bytes = (size_t) blocksize * blocksize * size;
+
+        /* One allocation holds every block, so the blocks sit next to
+         * each other in memory in the order block-major mapping visits
+         * them; a large slab is put on huge pages */
+        blocked->slab_bytes = blocked->block_bytes 
+                              * blocked->blocked_width 
+                              * blocked->blocked_height;
+        blocked->blocks = A2alloc_new(blocked->slab_bytes);
 
-                }
-        }
         return blocked;
 }
 
@@ -160,41 +159,23 @@ T UArray2b_new_64K_block(int width, int height, int size)
  * Parameters: T *array2b - pointer to UArray2b_T object to be freed
  *    Returns: Nothing
  *       Does: Frees all memory allocated for the passed UArray2b_T object
+ *             and overwrites the pointer with NULL
  *   if Error: raises assertions 
- *             if array2b is null
- *             if array2b->array is null
+ *             if array2b or *array2b is null
+ *             if array2b->blocks is null
  */ 
 void UArray2b_free (T *array2b)
 {
-        /* Validate that the passed array2b and the data member array 
+        /* Validate that the passed array2b and the data member blocks 
          * are not null */
-        assert(array2b != NULL);
-        assert((*array2b)->array != NULL); 
+        assert(array2b != NULL && *array2b != NULL);
+        assert((*array2b)->blocks != NULL); 
         
-        /* Compute the number of blocks in the 
-         * width and height of the array */
-        int blocked_width = ceil((double) (*array2b)->width 
-                                           / (*array2b)->blocksize);
-        int blocked_height = ceil((double) (*array2b)->height 
-                                            / (*array2b)->blocksize);
-
-        /* Index each block within the array using row-major indexing */
-        for (int i = 0; i < blocked_height; i++) {
-                for (int j = 0; j < blocked_width; j++) {
-
-                        /* Get then free the array at each 
-                         * block of the UArray2b_T */
-                        UArray_T* temp = (UArray_T*) 
-                                          UArray2_at((*array2b)->array, j, i);
-                        UArray_free(temp);
-                }
-        }
-
-        /* Free the memory allocated for the UArray2b->array object 
-         * that holds each block then free the memory allocated for 
-         * the structs data members like height and width */
-        UArray2_free(&((*array2b)->array));
+        /* Every block lives in the one slab, so a single free releases 
+         * all of the elements, then the struct itself is freed */
+        A2alloc_free((*array2b)->blocks, (*array2b)->slab_bytes);
         free(*array2b);
+        *array2b = NULL;
 }
 
 /* int UArray2b_width (T array2b)
@@ -258,33 +239,33 @@ int UArray2b_blocksize(T array2b)
  *       Does: Gets the element at the desired column and row of the array
  *   if Error: raises assertions 
  *             if array2b is null
- *             if array2b->array is null
+ *             if array2b->blocks is null
  *             if col or row index is out of bounds of array2b
  */
 void *UArray2b_at(T array2b, int col, int row)
 {
-        /* Validate that the array2b and array2b->array are both not null */
+        /* Validate that the array2b and array2b->blocks are both not null */
         assert(array2b != NULL);
-        assert(array2b->array != NULL);
+        assert(array2b->blocks != NULL);
 
         /* Validates indexes are within bounds */
         assert(col < array2b->width && col >= 0);
         assert(row < array2b->height && row >= 0);
         
-        /* Get the block that contained the desired element */
+        /* Index of the block that contains the desired element, blocks 
+         * are stored one block row after another in the slab */
         int blocksize = array2b->blocksize;
-        UArray_T *block = UArray2_at(array2b->array, 
-                                     col / blocksize, row / blocksize);
-
-        /* Since each block is implemented as a 1 dimensional array, 
-         * the calculation below finds the corresponding 1D index from 
-         * the passed row and col */                                        
-        int index_within_block = blocksize * (row % blocksize) 
-                                 + (col % blocksize);
-
-        /* Return the element at the 1D index of the block containing 
-         * row and col */
-        return UArray_at(*block, index_within_block);
+        size_t block_index = (size_t) array2b->blocked_width 
+                             * (row / blocksize) + (col / blocksize);
+
+        /* Since each block is stored row major, the calculation below 
+         * finds the corresponding 1D index from the passed row and col */
+        size_t index_within_block = (size_t) blocksize * (row % blocksize) 
+                                    + (col % blocksize);
+
+        /* Return the element at a single offset into the slab */
+        return array2b->blocks + block_index * array2b->block_bytes 
+                               + index_within_block * array2b->size;
 }
 
 /* void UArray2b_map(T array2b, 
@@ -309,50 +290,39 @@ void *UArray2b_at(T array2b, int col, int row)
  *             apply function on each element of the passed UArray2b_T object
  *   if Error: raises assertions 
  *             if array2b is null
- *             if array2b->array is null
+ *             if apply is null
  */
 void UArray2b_map(T array2b, 
                   void apply(int col, int row, T array2b, void *elem, 
                              void *cl), 
                   void *cl)
 {
-        /* Validate that the array2b and array2b->array are both not null */
+        /* Validate that the array2b and apply are both not null */
         assert(array2b != NULL);
         assert(apply != NULL);
         
-        /* Create local variables to be used multiple times */
-        int blocksize = array2b->blocksize;
-        int width = array2b->width;
-        int height = array2b->height;
         /* Number of blocks in a row and number of blocks in a column */
-        int blocked_width = ceil((double) width / blocksize);
-        int blocked_height = ceil((double) height / blocksize);
+        int blocked_width = array2b->blocked_width;
+        int blocked_height = array2b->blocked_height;
+
+        /* Blocks are stored in the slab in the order they are visited, 
+         * so the start of the next block is always one block further */
+        char *block = array2b->blocks;
                 
         /* Use row major accessing to index the blocked array */
         for (int block_row = 0; block_row < blocked_height; block_row++) {
                 for (int block_col = 0; block_col < blocked_width; 
-                     block_col++) {
-
-                        /* Default end small column and row indices for if 
-                         * there is no wasted memory in any block */
-                        int end_small_col = blocksize; 
-                        int end_small_row = blocksize; 
-                        
-                        /* Updates end column index if the current block 
-                         * has wasted memory beyond the width */
-                        if ((block_col + 1) * blocksize > width) {
-                                end_small_col = (width % blocksize); 
-                        } 
-                    
-                        /* Updates end row index if the current block has 
-                         * wasted memory beyond the height */
-                        if ((block_row + 1) * blocksize > height) {
-                                end_small_row = (height % blocksize);
-                        }
+                     block_col++, block += array2b->block_bytes) {
+
+                        /* Bounds of the used part of the block, computed
+                         * once per block rather than once per element */
+                        int end_small_col, end_small_row;
+                        block_extent(array2b, block_col, block_row,
+                                     &end_small_col, &end_small_row);
 
                         /* Helper func that applies the apply function to 
                          * every element of the current block */
-                        apply_on_block(array2b, 
+                        apply_on_block(array2b, block,
                                        block_col, block_row, 
                                        end_small_col, end_small_row, 
                                        apply, cl);
@@ -360,13 +330,242 @@ void UArray2b_map(T array2b,
         }
 }                  
 
-/* static void apply_on_block(T array2b, UArray_T block, 
+/* void UArray2b_small_map(T array2b, 
+ *                         void apply(void *elem, void *cl),
+ *                         void *cl)
+ * Parameters: T array2b - UArray2_T object to be accessed
+ *          void apply() - pointer to the function that should 
+ *                         be applied to each element during the block 
+ *                         major mapping
+ *              void *cl - void pointer to closure function or data point
+ *                         that should be incremented
+ * Apply Function Parameters:
+ *            void *elem - void pointer to the element being visited
+ *              void *cl - void pointer to closure function or data point
+ *                        that should be incremented
+ *    Returns: Nothing
+ *       Does: Visits the elements in the same order as UArray2b_map, but 
+ *             passes only the element and the closure, walking each block
+ *             with a pointer and never computing an element's indexes
+ *   if Error: raises assertions 
+ *             if array2b is null
+ *             if apply is null
+ */
+void UArray2b_small_map(T array2b, void apply(void *elem, void *cl), 
+                        void *cl)
+{
+        /* Validate that the array2b and apply are both not null */
+        assert(array2b != NULL);
+        assert(apply != NULL);
+
+        char *block = array2b->blocks;
+
+        /* Same block and element order as UArray2b_map */
+        for (int block_row = 0; block_row < array2b->blocked_height; 
+             block_row++) {
+                for (int block_col = 0; block_col < array2b->blocked_width;
+                     block_col++, block += array2b->block_bytes) {
+
+                        int end_small_col, end_small_row;
+                        block_extent(array2b, block_col, block_row,
+                                     &end_small_col, &end_small_row);
+                        small_apply_on_block(array2b, block, 
+                                             end_small_col, end_small_row,
+                                             apply, cl);
+                }
+        }
+}
+
+/* void UArray2b_map_spans(T array2b, 
+ *                         void apply(int col, int row, int n, T array2b,
+ *                                    void *first, void *cl),
+ *                         void *cl)
+ * Parameters: T array2b - UArray2_T object to be accessed
+ *          void apply() - pointer to the function that should be applied 
+ *                         to each row of each block
+ *              void *cl - void pointer to closure function or data point
+ *                         that should be incremented
+ * Apply Function Parameters:
+ *               int col - column index of the first element of the span
+ *               int row - row index of the span
+ *                 int n - number of elements in the span
+ *             T array2b - UArray2_T object to be accessed
+ *           void *first - void pointer to the first element of the span,
+ *                         element k of the span is k * size bytes after it
+ *              void *cl - void pointer to closure function or data point
+ *                        that should be incremented
+ *    Returns: Nothing
+ *       Does: Visits the blocks in the same order as UArray2b_map, calling
+ *             apply once for every used row of every block, so the caller
+ *             handles a whole run of adjacent elements per call
+ *   if Error: raises assertions 
+ *             if array2b is null
+ *             if apply is null
+ */
+void UArray2b_map_spans(T array2b, 
+                        void apply(int col, int row, int n, T array2b,
+                                   void *first, void *cl),
+                        void *cl)
+{
+        /* Validate that the array2b and apply are both not null */
+        assert(array2b != NULL);
+        assert(apply != NULL);
+
+        int blocksize = array2b->blocksize;
+        size_t row_bytes = (size_t) blocksize * array2b->size;
+        char *block = array2b->blocks;
+
+        for (int block_row = 0; block_row < array2b->blocked_height; 
+             block_row++) {
+                for (int block_col = 0; block_col < array2b->blocked_width;
+                     block_col++, block += array2b->block_bytes) {
+
+                        int end_small_col, end_small_row;
+                        block_extent(array2b, block_col, block_row,
+                                     &end_small_col, &end_small_row);
+
+                        /* One call per used row of the block */
+                        char *first = block;
+                        for (int small_row = 0; small_row < end_small_row;
+                             small_row++, first += row_bytes) {
+                                apply(block_col * blocksize, 
+                                      block_row * blocksize + small_row,
+                                      end_small_col, array2b, first, cl);
+                        }
+                }
+        }
+}
+
+/* int UArray2b_blocks(T array2b)
+ * Parameters: T array2b - UArray2_T object to be accessed
+ *    Returns: Integer expressing the number of blocks of the array
+ *       Does: Counts the blocks, which UArray2b_map visits in the order
+ *             of their numbers 0, 1, ... UArray2b_blocks(array2b) - 1
+ *   if Error: raises assertions 
+ *             if array2b is null
+ */
+int UArray2b_blocks(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b->blocked_width * array2b->blocked_height;
+}
+
+/* void UArray2b_map_block(T array2b, int block,
+ *                         void apply(int col, int row, T array2b, 
+ *                                    void *elem, void *cl),
+ *                         void *cl)
+ * Parameters: T array2b - UArray2_T object to be accessed
+ *             int block - number of the block to visit
+ *          void apply() - pointer to the function that should 
+ *                         be applied to each element of the block
+ *              void *cl - void pointer to closure function or data point
+ *                         that should be incremented
+ * Apply Function Parameters: the same as for UArray2b_map
+ *    Returns: Nothing
+ *       Does: Calls apply on the used elements of one block only, in the
+ *             order UArray2b_map visits them, so that different blocks
+ *             can be mapped by different threads
+ *   if Error: raises assertions 
+ *             if array2b is null
+ *             if apply is null
+ *             if block is not between 0 and UArray2b_blocks(array2b) - 1
+ */
+void UArray2b_map_block(T array2b, int block,
+                        void apply(int col, int row, T array2b, void *elem,
+                                   void *cl),
+                        void *cl)
+{
+        assert(array2b != NULL);
+        assert(apply != NULL);
+        assert(block >= 0 && block < UArray2b_blocks(array2b));
+
+        int block_col = block % array2b->blocked_width;
+        int block_row = block / array2b->blocked_width;
+        int end_small_col, end_small_row;
+        block_extent(array2b, block_col, block_row,
+                     &end_small_col, &end_small_row);
+        apply_on_block(array2b, 
+                       array2b->blocks + block * array2b->block_bytes,
+                       block_col, block_row, end_small_col, end_small_row,
+                       apply, cl);
+}
+
+/* void UArray2b_small_map_block(T array2b, int block,
+ *                               void apply(void *elem, void *cl),
+ *                               void *cl)
+ * Parameters: T array2b - UArray2_T object to be accessed
+ *             int block - number of the block to visit
+ *          void apply() - pointer to the function that should 
+ *                         be applied to each element of the block
+ *              void *cl - void pointer to closure function or data point
+ *                         that should be incremented
+ * Apply Function Parameters: the same as for UArray2b_small_map
+ *    Returns: Nothing
+ *       Does: Same as UArray2b_map_block, passing only the element and 
+ *             the closure
+ *   if Error: raises assertions 
+ *             if array2b is null
+ *             if apply is null
+ *             if block is not between 0 and UArray2b_blocks(array2b) - 1
+ */
+void UArray2b_small_map_block(T array2b, int block,
+                              void apply(void *elem, void *cl), void *cl)
+{
+        assert(array2b != NULL);
+        assert(apply != NULL);
+        assert(block >= 0 && block < UArray2b_blocks(array2b));
+
+        int end_small_col, end_small_row;
+        block_extent(array2b, block % array2b->blocked_width, 
+                     block / array2b->blocked_width,
+                     &end_small_col, &end_small_row);
+        small_apply_on_block(array2b, 
+                             array2b->blocks + block * array2b->block_bytes,
+                             end_small_col, end_small_row, apply, cl);
+}
+
+/* static void block_extent(T array2b, int block_col, int block_row,
+ *                          int *end_small_col, int *end_small_row)
+ * Parameters: T array2b - UArray2_T object to be accessed
+ *         int block_col - column index of the block
+ *         int block_row - row index of the block
+ *    int *end_small_col - set to the number of used columns of the block
+ *    int *end_small_row - set to the number of used rows of the block
+ *  Returns: Nothing
+ *     Does: Finds how much of a block holds elements of the array, which
+ *           is all of it except for blocks cut by the right or bottom edge
+ */
+static void block_extent(T array2b, int block_col, int block_row,
+                         int *end_small_col, int *end_small_row)
+{
+        int blocksize = array2b->blocksize;
+
+        /* Default end small column and row indices for if 
+         * there is no wasted memory in the block */
+        *end_small_col = blocksize; 
+        *end_small_row = blocksize; 
+
+        /* Updates end column index if the current block 
+         * has wasted memory beyond the width */
+        if ((block_col + 1) * blocksize > array2b->width) {
+                *end_small_col = array2b->width % blocksize; 
+        } 
+
+        /* Updates end row index if the current block has 
+         * wasted memory beyond the height */
+        if ((block_row + 1) * blocksize > array2b->height) {
+                *end_small_row = array2b->height % blocksize;
+        }
+}
+
+/* static void apply_on_block(T array2b, char *block,
  *                            int block_col, int block_row, 
  *                            int end_small_col, int end_small_row,
  *                            void apply(int col, int row, T array2b, 
  *                                       void *elem, void *cl), 
  *                            void *cl)
  * Parameters: T array2b - UArray2_T object to be accessed
+ *           char *block - pointer to the first element of the block
  *         int block_col - column index of the current block being indexed
  *         int block_row - row index of the current block being indexed
  *     int end_small_col - column index for the end of the 
@@ -385,11 +584,12 @@ void UArray2b_map(T array2b,
  *              void *cl - void pointer to closure function or data point
  *                        that should be incremented
  *  Returns: Nothing
- *     Does: Helper function to prevent out of bounds indexing during mapping
+ *     Does: Helper function to prevent out of bounds indexing during
+ *           mapping, walks the elements of the block with a pointer
  * if Error: raises assertion 
  *           if array2b is null
  */
-static void apply_on_block(T array2b, 
+static void apply_on_block(T array2b, char *block,
                            int block_col, int block_row, 
                            int end_small_col, int end_small_row, 
                            void apply(int col, int row, 
@@ -398,20 +598,58 @@ static void apply_on_block(T array2b,
 {       
         assert(array2b != NULL);
         int blocksize = array2b->blocksize;
+        int size = array2b->size;
+        size_t row_bytes = (size_t) blocksize * size;
 
-        /* Use row major accessing to index the current block */
+        /* Macro indexes of the block's first element */
+        int first_col = block_col * blocksize;
+        int first_row = block_row * blocksize;
+
+        /* Use row major accessing to index the current block, stepping 
+         * the element pointer rather than recomputing its address */
         for (int small_row = 0; small_row < end_small_row; small_row++) {
+                char *elem = block + small_row * row_bytes;
                 for (int small_col = 0; small_col < end_small_col; 
-                     small_col++) {
-
-                        /* Computes the element's macro indexes within the 
-                         * entire array then uses the UArray2b_at function 
-                         * to get the element at those indexes */
-                        int large_col = block_col * blocksize + small_col;
-                        int large_row = block_row * blocksize + small_row;
-                        void *elem = UArray2b_at(array2b, large_col, 
-                                                 large_row);
-                        apply(large_col, large_row, array2b, elem, cl);
+                     small_col++, elem += size) {
+                        apply(first_col + small_col, first_row + small_row,
+                              array2b, elem, cl);
+                }
+        }
+}
+
+/* static void small_apply_on_block(T array2b, char *block,
+ *                                  int end_small_col, int end_small_row,
+ *                                  void apply(void *elem, void *cl),
+ *                                  void *cl)
+ * Parameters: T array2b - UArray2_T object to be accessed
+ *           char *block - pointer to the first element of the block
+ *     int end_small_col - number of used columns of the block
+ *     int end_small_row - number of used rows of the block
+ *          void apply() - pointer to the function that should be applied to
+ *                         each element of the block
+ *              void *cl - void pointer to closure function or data point
+ *                         that should be incremented
+ *  Returns: Nothing
+ *     Does: Same as apply_on_block, for the mappers that pass only the
+ *           element and the closure
+ */
+static void small_apply_on_block(T array2b, char *block,
+                                 int end_small_col, int end_small_row,
+                                 void apply(void *elem, void *cl),
+                                 void *cl)
+{
+        int size = array2b->size;
+        size_t row_bytes = (size_t) array2b->blocksize * size;
+
+        /* Each row of the block starts one block row of bytes after the 
+         * previous, its used elements are adjacent */
+        char *small_row_start = block;
+        for (int small_row = 0; small_row < end_small_row;
+             small_row++, small_row_start += row_bytes) {
+                char *elem = small_row_start;
+                for (int small_col = 0; small_col < end_small_col;
+                     small_col++, elem += size) {
+                        apply(elem, cl);
                 }
         }
 }
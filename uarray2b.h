@@ -27,6 +27,31 @@ extern void UArray2b_map(T array2b,
 			 void apply(int col, int row, T array2b,
 				    void *elem, void *cl),
 			 void *cl);
+/* same order as UArray2b_map, passing only the cell and the closure */
+extern void UArray2b_small_map(T array2b,
+			       void apply(void *elem, void *cl),
+			       void *cl);
+/* same order as UArray2b_map, but calls apply once per row of each block
+ * with the first cell of that row and the number n of cells the row holds;
+ * those n cells are adjacent in memory
+ */
+extern void UArray2b_map_spans(T array2b,
+			       void apply(int col, int row, int n, T array2b,
+					  void *first, void *cl),
+			       void *cl);
+/* number of blocks; UArray2b_map visits block 0 first, then block 1... */
+extern int UArray2b_blocks(T array2b);
+/* visit only the cells of the given block, in the order UArray2b_map
+ * does; different blocks share no cell, so they may be mapped at once
+ * by different threads
+ */
+extern void UArray2b_map_block(T array2b, int block,
+			       void apply(int col, int row, T array2b,
+					  void *elem, void *cl),
+			       void *cl);
+extern void UArray2b_small_map_block(T array2b, int block,
+				     void apply(void *elem, void *cl),
+				     void *cl);
 /*
  * it is a checked run-time error to pass a NULL T
  * to any function in this interface
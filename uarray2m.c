@@ -0,0 +1,499 @@
+/* HW3 - Locality
+ * uarray2m.c
+ * Function: UArray2 implementation that stores the contents of the array
+ *           in Morton (Z) order, so that cells close to each other in
+ *           either dimension are close to each other in memory without
+ *           choosing a block size
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "uarray2m.h"
+#include "assert.h"
+#include "a2alloc.h"
+
+#define T UArray2m_T
+
+/* Bits of x, and of y, in the index of cell (x, y) of a tile */
+#define EVEN_BITS 0x5555555555555555ULL
+#define ODD_BITS  0xAAAAAAAAAAAAAAAAULL
+
+/* UArray2m_T (uses the defined macro T)
+ * Purpose: An array whose cells follow the Z order curve
+ * Data Structure: the cells live in one cache line aligned slab. The
+ *                 array is covered by a grid of square tiles of side
+ *                 2^tile_bits, padded only to a whole tile at the right
+ *                 and bottom edges; each tile is stored in Z order, and
+ *                 the tiles follow each other in the Z order of their
+ *                 places in the grid, skipping places outside it. slot_of
+ *                 gives the place in the slab of each tile of the grid
+ *                 (in row major order) and tile_at the reverse
+ * Math for Indexing: cell (col, row) is at the slot of its tile times the
+ *                    cells of a tile, plus the Z index of its place (x, y)
+ *                    in the tile, which interleaves the bits of x (even
+ *                    bits) and y (odd bits)
+ */
+struct T {
+        int width;        /* number of elements in row of array */
+        int height;       /* number of elements in column of array */
+        int size;         /* size of a single element of array */
+        int blocksize;    /* side of a tile, a power of two */
+        int tile_bits;    /* log2 of blocksize */
+        int tiles_wide;   /* tiles in a row of the grid */
+        int tiles_high;   /* tiles in a column of the grid */
+        int bmi2;         /* whether to interleave bits with PDEP */
+        size_t tile_cells; /* cells in one tile */
+        int tiles;        /* number of tiles in the slab */
+        int *slot_of;     /* slot in the slab of each tile of the grid */
+        int *tile_at;     /* tile of the grid in each slot of the slab */
+        char *cells;      /* slab of every tile */
+        size_t slab_bytes; /* bytes in the slab */
+};
+
+static int ceil_log2(int n);
+static size_t cell_index(T array2m, int col, int row);
+static void tile_extent(T array2m, int tile, int *col, int *row,
+                        int *cols, int *rows);
+static void order_tiles(T array2m, int x, int y, int side, int *next);
+
+/* T UArray2m_new(int width, int height, int size, int blocksize)
+ * Parameters: int width - desired total number of elements in row
+ *             int height - desired total number of elements in column
+ *             int size - the memory allocation size of a single element
+ *             int blocksize - wanted side of a tile
+ *    Returns: UArray2m_T, with initialized data members and a single
+ *             slab holding every tile
+ *       Does: Works out the tiles and their order and allocates the
+ *             slab; the elements are left uninitialized
+ *   if Error: raises assertions
+ *             if height or width is less than zero
+ *             if size or blocksize is less than or equal to zero
+ *             if failed mallocing
+ */
+T UArray2m_new(int width, int height, int size, int blocksize)
+{
+        assert(height >= 0);
+        assert(width >= 0);
+        assert(size > 0);
+        assert(blocksize > 0);
+
+        T array2m = malloc(sizeof(*array2m));
+        assert(array2m != NULL);
+        array2m->width = width;
+        array2m->height = height;
+        array2m->size = size;
+
+        /* A tile is no wider than the power of two covering the shorter
+         * dimension, so a thin array is not padded out to a square */
+        int shorter = width < height ? width : height;
+        int side = 1 << ceil_log2(shorter);
+        int bits = 0;
+        while ((1 << (bits + 1)) <= blocksize && (1 << bits) < side) {
+                bits++;
+        }
+        int tile = 1 << bits;
+        array2m->blocksize = tile;
+        array2m->tile_bits = bits;
+        array2m->tile_cells = (size_t) tile * tile;
+        array2m->tiles_wide = (width + tile - 1) / tile;
+        array2m->tiles_high = (height + tile - 1) / tile;
+        array2m->tiles = array2m->tiles_wide * array2m->tiles_high;
+
+        /* Number the tiles of the grid in Z order */
+        array2m->slot_of = malloc((2 * (size_t) array2m->tiles + 1)
+                                  * sizeof(int));
+        assert(array2m->slot_of != NULL);
+        array2m->tile_at = array2m->slot_of + array2m->tiles;
+        int grid_side = array2m->tiles_wide > array2m->tiles_high
+                        ? array2m->tiles_wide : array2m->tiles_high;
+        int next = 0;
+        order_tiles(array2m, 0, 0, 1 << ceil_log2(grid_side), &next);
+
+#if defined(__x86_64__) || defined(__i386__)
+        array2m->bmi2 = __builtin_cpu_supports("bmi2");
+#else
+        array2m->bmi2 = 0;
+#endif
+
+        /* a large slab is put on huge pages */
+        array2m->slab_bytes = array2m->tiles * array2m->tile_cells * size;
+        array2m->cells = A2alloc_new(array2m->slab_bytes);
+        return array2m;
+}
+
+/* T UArray2m_new_64K_block(int width, int height, int size)
+ * Parameters: int width - desired total number of elements in row
+ *             int height - desired total number of elements in column
+ *             int size - the memory allocation size of a single element
+ *    Returns: UArray2m_T, as for UArray2m_new
+ *       Does: Uses the largest power of two tile side for which a tile
+ *             occupies at most 64K
+ *   if Error: raises the assertions of UArray2m_new
+ */
+T UArray2m_new_64K_block(int width, int height, int size)
+{
+        assert(size > 0);
+        int blocksize = 1;
+        while ((long) (blocksize * 2) * (blocksize * 2) * size <= 65536) {
+                blocksize *= 2;
+        }
+        return UArray2m_new(width, height, size, blocksize);
+}
+
+/* void UArray2m_free(T *array2m)
+ * Parameters: T *array2m - pointer to UArray2m_T object to be freed
+ *    Returns: Nothing
+ *       Does: Frees the slab, the tile order and the struct and
+ *             overwrites the pointer with NULL
+ *   if Error: raises assertion if array2m or *array2m is null
+ */
+void UArray2m_free(T *array2m)
+{
+        assert(array2m != NULL && *array2m != NULL);
+        A2alloc_free((*array2m)->cells, (*array2m)->slab_bytes);
+        free((*array2m)->slot_of);
+        free(*array2m);
+        *array2m = NULL;
+}
+
+/* int UArray2m_width(T array2m)
+ * int UArray2m_height(T array2m)
+ * int UArray2m_size(T array2m)
+ * int UArray2m_blocksize(T array2m)
+ * Parameters: T array2m - UArray2m_T object to be accessed
+ *    Returns: the elements in a row, the elements in a column, the bytes
+ *             in an element and the side of a tile
+ *   if Error: raises assertion if array2m is null
+ */
+int UArray2m_width(T array2m)
+{
+        assert(array2m != NULL);
+        return array2m->width;
+}
+
+int UArray2m_height(T array2m)
+{
+        assert(array2m != NULL);
+        return array2m->height;
+}
+
+int UArray2m_size(T array2m)
+{
+        assert(array2m != NULL);
+        return array2m->size;
+}
+
+int UArray2m_blocksize(T array2m)
+{
+        assert(array2m != NULL);
+        return array2m->blocksize;
+}
+
+/* void *UArray2m_at(T array2m, int col, int row)
+ * Parameters: T array2m - UArray2m_T object to be accessed
+ *             int col - the column index for the desired element
+ *             int row - the row index for the desired element
+ *    Returns: Void * to the element at the passed indexes
+ *       Does: Offsets into the slab by the cell's index
+ *   if Error: raises assertions
+ *             if array2m is null
+ *             if col or row index is out of bounds of array2m
+ */
+void *UArray2m_at(T array2m, int col, int row)
+{
+        assert(array2m != NULL);
+        assert(col < array2m->width && col >= 0);
+        assert(row < array2m->height && row >= 0);
+        return array2m->cells + cell_index(array2m, col, row) * array2m->size;
+}
+
+/* Z order indexing: interleaving spreads the bits of a coordinate out
+ * to every other bit, and compacting gathers them back. BMI2's PDEP does
+ * the spreading in one instruction; elsewhere the bits move in halving
+ * steps
+ */
+
+static inline uint64_t spread(uint32_t v)
+{
+        uint64_t x = v;
+        x = (x | x << 16) & 0x0000FFFF0000FFFFULL;
+        x = (x | x << 8)  & 0x00FF00FF00FF00FFULL;
+        x = (x | x << 4)  & 0x0F0F0F0F0F0F0F0FULL;
+        x = (x | x << 2)  & 0x3333333333333333ULL;
+        x = (x | x << 1)  & EVEN_BITS;
+        return x;
+}
+
+static inline uint32_t compact(uint64_t x)
+{
+        x &= EVEN_BITS;
+        x = (x | x >> 1)  & 0x3333333333333333ULL;
+        x = (x | x >> 2)  & 0x0F0F0F0F0F0F0F0FULL;
+        x = (x | x >> 4)  & 0x00FF00FF00FF00FFULL;
+        x = (x | x >> 8)  & 0x0000FFFF0000FFFFULL;
+        x = (x | x >> 16) & 0x00000000FFFFFFFFULL;
+        return x;
+}
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+__attribute__((target("bmi2")))
+static uint64_t interleave_bmi2(uint32_t x, uint32_t y)
+{
+        return _pdep_u64(x, EVEN_BITS) | _pdep_u64(y, ODD_BITS);
+}
+
+#else   /* no PDEP: UArray2m_new never sets bmi2 */
+
+static uint64_t interleave_bmi2(uint32_t x, uint32_t y)
+{
+        return spread(x) | spread(y) << 1;
+}
+
+#endif
+
+/* static size_t cell_index(T array2m, int col, int row)
+ * Parameters: T array2m - the array
+ *             int col, int row - indexes of a cell in bounds
+ *    Returns: index of the cell in the slab
+ *   if Error: None
+ */
+static size_t cell_index(T array2m, int col, int row)
+{
+        int bits = array2m->tile_bits;
+        uint32_t mask = ((uint32_t) 1 << bits) - 1;
+        size_t slot = array2m->slot_of[(row >> bits) * array2m->tiles_wide
+                                       + (col >> bits)];
+        uint64_t z = array2m->bmi2
+                     ? interleave_bmi2(col & mask, row & mask)
+                     : spread(col & mask) | spread(row & mask) << 1;
+        return slot << (2 * bits) | z;
+}
+
+/* static int ceil_log2(int n)
+ * Returns: the smallest b with 2^b at least n
+ */
+static int ceil_log2(int n)
+{
+        int bits = 0;
+        while (((long) 1 << bits) < n) {
+                bits++;
+        }
+        return bits;
+}
+
+/* static void tile_extent(T array2m, int tile, int *col, int *row,
+ *                         int *cols, int *rows)
+ * Parameters: T array2m - the array
+ *             int tile - index of a tile
+ *             int *col, int *row - set to the tile's top left cell
+ *             int *cols, int *rows - set to how many of the tile's
+ *                                    columns and rows are in the array,
+ *                                    each at least 1
+ *    Returns: Nothing
+ *       Does: Looks up the tile's place in the grid
+ *   if Error: None
+ */
+static void tile_extent(T array2m, int tile, int *col, int *row,
+                        int *cols, int *rows)
+{
+        int place = array2m->tile_at[tile];
+        *col = (place % array2m->tiles_wide) << array2m->tile_bits;
+        *row = (place / array2m->tiles_wide) << array2m->tile_bits;
+        int side = array2m->blocksize;
+        *cols = array2m->width - *col < side ? array2m->width - *col : side;
+        *rows = array2m->height - *row < side ? array2m->height - *row
+                                              : side;
+}
+
+/* static void order_tiles(T array2m, int x, int y, int side, int *next)
+ * Parameters: T array2m - the array, its grid of tiles worked out
+ *             int x, int y - the place in the grid of the top left tile
+ *                            of an aligned square of tiles
+ *             int side - the side of that square, a power of two
+ *             int *next - the next free slot, advanced past those given
+ *    Returns: Nothing
+ *       Does: Gives slots to the tiles of the square that are in the
+ *             grid, in Z order: its four quarters in turn, top left, top
+ *             right, bottom left, bottom right
+ *   if Error: None
+ */
+static void order_tiles(T array2m, int x, int y, int side, int *next)
+{
+        if (x >= array2m->tiles_wide || y >= array2m->tiles_high) {
+                return;
+        }
+        if (side == 1) {
+                int place = y * array2m->tiles_wide + x;
+                array2m->slot_of[place] = *next;
+                array2m->tile_at[*next] = place;
+                (*next)++;
+                return;
+        }
+        int half = side / 2;
+        order_tiles(array2m, x, y, half, next);
+        order_tiles(array2m, x + half, y, half, next);
+        order_tiles(array2m, x, y + half, half, next);
+        order_tiles(array2m, x + half, y + half, half, next);
+}
+
+/* int UArray2m_blocks(T array2m)
+ * Parameters: T array2m - UArray2m_T object to be accessed
+ *    Returns: the number of tiles in the slab, each holding at least one
+ *             cell of the array
+ *   if Error: raises assertion if array2m is null
+ */
+int UArray2m_blocks(T array2m)
+{
+        assert(array2m != NULL);
+        return array2m->tiles;
+}
+
+/* void UArray2m_map_block(T array2m, int block,
+ *                         void apply(int col, int row, T array2m,
+ *                                    void *elem, void *cl),
+ *                         void *cl)
+ * Parameters: T array2m - UArray2m_T object to be accessed
+ *             int block - index of the tile to visit
+ *             void apply() - function called on each element
+ *             void *cl - closure passed to apply
+ *    Returns: Nothing
+ *       Does: Walks the tile's cells in memory order, decoding the
+ *             indexes of each; padding cells past an edge are skipped
+ *   if Error: raises assertions
+ *             if array2m or apply is null
+ *             if block is not the index of a tile
+ */
+void UArray2m_map_block(T array2m, int block,
+                        void apply(int col, int row, T array2m,
+                                   void *elem, void *cl),
+                        void *cl)
+{
+        assert(array2m != NULL && apply != NULL);
+        assert(block >= 0 && block < array2m->tiles);
+        int col, row, cols, rows;
+        tile_extent(array2m, block, &col, &row, &cols, &rows);
+        char *cell = array2m->cells
+                     + (size_t) block * array2m->tile_cells * array2m->size;
+        for (size_t k = 0; k < array2m->tile_cells;
+             k++, cell += array2m->size) {
+                int x = compact(k);
+                int y = compact(k >> 1);
+                if (x < cols && y < rows) {
+                        apply(col + x, row + y, array2m, cell, cl);
+                }
+        }
+}
+
+/* void UArray2m_small_map_block(T array2m, int block,
+ *                               void apply(void *elem, void *cl),
+ *                               void *cl)
+ * Parameters: as for UArray2m_map_block, with apply given only the
+ *             element and the closure
+ *    Returns: Nothing
+ *       Does: Walks the tile's cells in memory order; a tile wholly in
+ *             the array needs no index at all, and the cells of another
+ *             are tested without decoding, since spreading the bits of
+ *             a coordinate keeps its order
+ *   if Error: raises the assertions of UArray2m_map_block
+ */
+void UArray2m_small_map_block(T array2m, int block,
+                              void apply(void *elem, void *cl),
+                              void *cl)
+{
+        assert(array2m != NULL && apply != NULL);
+        assert(block >= 0 && block < array2m->tiles);
+        int col, row, cols, rows;
+        tile_extent(array2m, block, &col, &row, &cols, &rows);
+        char *cell = array2m->cells
+                     + (size_t) block * array2m->tile_cells * array2m->size;
+        size_t n = array2m->tile_cells;
+        int size = array2m->size;
+        if (cols == array2m->blocksize && rows == array2m->blocksize) {
+                for (size_t k = 0; k < n; k++, cell += size) {
+                        apply(cell, cl);
+                }
+                return;
+        }
+        uint64_t x_end = spread(cols);
+        uint64_t y_end = spread(rows) << 1;
+        for (size_t k = 0; k < n; k++, cell += size) {
+                if ((k & EVEN_BITS) < x_end && (k & ODD_BITS) < y_end) {
+                        apply(cell, cl);
+                }
+        }
+}
+
+/* void UArray2m_map(T array2m,
+ *                   void apply(int col, int row, T array2m, void *elem,
+ *                              void *cl),
+ *                   void *cl)
+ * void UArray2m_small_map(T array2m, void apply(void *elem, void *cl),
+ *                         void *cl)
+ * Parameters: T array2m - UArray2m_T object to be accessed
+ *             void apply() - function called on each element
+ *             void *cl - closure passed to apply
+ *    Returns: Nothing
+ *       Does: Maps every tile in turn, which visits the whole slab once,
+ *             in order
+ *   if Error: raises assertions if array2m or apply is null
+ */
+void UArray2m_map(T array2m,
+                  void apply(int col, int row, T array2m, void *elem,
+                             void *cl),
+                  void *cl)
+{
+        assert(array2m != NULL && apply != NULL);
+        for (int tile = 0; tile < array2m->tiles; tile++) {
+                UArray2m_map_block(array2m, tile, apply, cl);
+        }
+}
+
+void UArray2m_small_map(T array2m, void apply(void *elem, void *cl),
+                        void *cl)
+{
+        assert(array2m != NULL && apply != NULL);
+        for (int tile = 0; tile < array2m->tiles; tile++) {
+                UArray2m_small_map_block(array2m, tile, apply, cl);
+        }
+}
+
+/* void UArray2m_map_spans(T array2m,
+ *                         void apply(int col, int row, int n,
+ *                                    T array2m, void *first, void *cl),
+ *                         void *cl)
+ * Parameters: T array2m - UArray2m_T object to be accessed
+ *             void apply() - function called on each span
+ *             void *cl - closure passed to apply
+ *    Returns: Nothing
+ *       Does: Walks every tile in memory order, two cells at a time: in
+ *             Z order a cell in an even column is followed in memory by
+ *             its neighbour on the right
+ *   if Error: raises assertions if array2m or apply is null
+ */
+void UArray2m_map_spans(T array2m,
+                        void apply(int col, int row, int n, T array2m,
+                                   void *first, void *cl),
+                        void *cl)
+{
+        assert(array2m != NULL && apply != NULL);
+        int size = array2m->size;
+        for (int tile = 0; tile < array2m->tiles; tile++) {
+                int col, row, cols, rows;
+                tile_extent(array2m, tile, &col, &row, &cols, &rows);
+                char *cell = array2m->cells
+                             + (size_t) tile * array2m->tile_cells * size;
+                for (size_t k = 0; k < array2m->tile_cells;
+                     k += 2, cell += 2 * size) {
+                        int x = compact(k);
+                        int y = compact(k >> 1);
+                        if (x < cols && y < rows) {
+                                int n = x + 1 < cols ? 2 : 1;
+                                apply(col + x, row + y, n, array2m, cell,
+                                      cl);
+                        }
+                }
+        }
+}
@@ -0,0 +1,65 @@
+#ifndef UARRAY2M_INCLUDED
+#define UARRAY2M_INCLUDED
+#define T UArray2m_T
+
+typedef struct T *T;
+/*
+ * new 2d array stored in Morton (Z) order: cells near each other in
+ * both dimensions are near each other in memory, at every scale. Every
+ * aligned square tile of blocksize * blocksize cells (blocksize a power
+ * of two) occupies consecutive memory, and tiles follow each other in
+ * Z order too; only the tiles at the right and bottom edges are padded.
+ * blocksize is rounded down to a power of two, and to the power of two
+ * covering the shorter dimension. blocksize < 1 is a checked runtime
+ * error
+ */
+extern T UArray2m_new (int width, int height, int size, int blocksize);
+/* new Morton 2d array whose tiles occupy at most 64KB (if possible) */
+extern T UArray2m_new_64K_block(int width, int height, int size);
+extern void UArray2m_free (T *array2m);
+extern int UArray2m_width (T array2m);
+extern int UArray2m_height (T array2m);
+extern int UArray2m_size (T array2m);
+extern int UArray2m_blocksize(T array2m);
+/* return a pointer to the cell in the given column and row.
+ * index out of range is a checked run-time error
+ */
+extern void *UArray2m_at(T array2m, int column, int row);
+/* visits every cell in Z order, which is also memory order: each tile
+ * is visited before the next
+ */
+extern void UArray2m_map(T array2m,
+                         void apply(int col, int row, T array2m,
+                                    void *elem, void *cl),
+                         void *cl);
+/* same order as UArray2m_map, passing only the cell and the closure */
+extern void UArray2m_small_map(T array2m,
+                               void apply(void *elem, void *cl),
+                               void *cl);
+/* same order as UArray2m_map, but calls apply once per pair of cells
+ * (col, row), (col + 1, row) that are adjacent in memory, with the first
+ * of them and the number n of cells, 2 or (at the right edge) 1
+ */
+extern void UArray2m_map_spans(T array2m,
+                               void apply(int col, int row, int n,
+                                          T array2m, void *first, void *cl),
+                               void *cl);
+/* number of tiles; UArray2m_map visits tile 0 first, then tile 1... */
+extern int UArray2m_blocks(T array2m);
+/* visit only the cells of the given tile, in the order UArray2m_map
+ * does; different tiles share no cell, so they may be mapped at once by
+ * different threads
+ */
+extern void UArray2m_map_block(T array2m, int block,
+                               void apply(int col, int row, T array2m,
+                                          void *elem, void *cl),
+                               void *cl);
+extern void UArray2m_small_map_block(T array2m, int block,
+                                     void apply(void *elem, void *cl),
+                                     void *cl);
+/*
+ * it is a checked run-time error to pass a NULL T
+ * to any function in this interface
+ */
+#undef T
+#endif
@@ -0,0 +1,405 @@
+/* HW3 - Locality
+ * workpool.c
+ * Function: A pool of pthreads that runs numbered tasks with work
+ *           stealing. Each thread owns a deque of task numbers; it works
+ *           through its own deque from one end while idle threads steal
+ *           from the other end, so a thread stuck with expensive tasks
+ *           (such as the partial blocks on the edges of an image) is
+ *           relieved by the others instead of leaving them idle.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "assert.h"
+#include "workpool.h"
+
+#define T Workpool_T
+
+/* struct deque
+ * Purpose: The task numbers one thread has left, which are always the
+ *          consecutive numbers low up to (not including) high; the owner
+ *          takes low, thieves take high - 1
+ */
+struct deque {
+        pthread_mutex_t lock;
+        int low;
+        int high;
+};
+
+/* Workpool_T (uses the defined macro T)
+ * Purpose: A set of threads waiting to run the tasks of Workpool_run.
+ *          Thread 0 is whichever thread calls Workpool_run, threads 1 to
+ *          nthreads - 1 are created by Workpool_new and sleep on 'start'
+ *          until 'generation' changes
+ */
+struct T {
+        int nthreads;
+        pthread_t *threads;       /* nthreads - 1 workers */
+        struct deque *deques;     /* one per thread */
+
+        pthread_mutex_t lock;     /* guards everything below */
+        pthread_cond_t start;     /* signalled when a run begins */
+        pthread_cond_t done;      /* signalled when a worker finishes */
+        unsigned generation;      /* number of runs started */
+        int busy;                 /* workers still in the current run */
+        int quit;                 /* set when the pool is freed */
+        Workpool_taskfun *task;
+        void *cl;
+};
+
+/* struct worker
+ * Purpose: What a pool thread is told when it is created
+ */
+struct worker {
+        T pool;
+        int index;
+};
+
+/* struct map
+ * Purpose: What Workpool_map hands Workpool_run: the task, its closures
+ *          and each thread's closure, made the first time it is needed
+ */
+struct map {
+        Workpool_mapfun *task;
+        void *cl;
+        Workpool_closurefun *make_cl;
+        void *thread_cl;
+        struct {
+                void *cl;
+                int made;
+        } *threads;               /* one per thread */
+};
+
+/* the pool Workpool_map reuses, held by whichever call is running */
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static T shared = NULL;
+
+static void *worker_main(void *vworker);
+static void work(T pool, int index);
+static int take(struct deque *deque, int own, int *task);
+static void map_task(int task, int thread, void *vmap);
+static void free_shared(void);
+
+/* T Workpool_new(int nthreads)
+ * Parameters: int nthreads - number of threads that run tasks
+ *    Returns: the new pool
+ *       Does: Creates nthreads - 1 threads, which wait for work
+ *   if Error: raises assertions
+ *             if nthreads < 1
+ *             if memory or a thread cannot be allocated
+ */
+T Workpool_new(int nthreads)
+{
+        assert(nthreads >= 1);
+        T pool = malloc(sizeof(*pool));
+        assert(pool != NULL);
+
+        pool->nthreads = nthreads;
+        pool->deques = malloc(nthreads * sizeof(*pool->deques));
+        assert(pool->deques != NULL);
+        for (int i = 0; i < nthreads; i++) {
+                pthread_mutex_init(&pool->deques[i].lock, NULL);
+                pool->deques[i].low = pool->deques[i].high = 0;
+        }
+
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->start, NULL);
+        pthread_cond_init(&pool->done, NULL);
+        pool->generation = 0;
+        pool->busy = 0;
+        pool->quit = 0;
+        pool->task = NULL;
+        pool->cl = NULL;
+
+        pool->threads = NULL;
+        if (nthreads > 1) {
+                pool->threads = malloc((nthreads - 1)
+                                       * sizeof(*pool->threads));
+                assert(pool->threads != NULL);
+        }
+        for (int i = 1; i < nthreads; i++) {
+                struct worker *worker = malloc(sizeof(*worker));
+                assert(worker != NULL);
+                worker->pool = pool;
+                worker->index = i;
+                int failed = pthread_create(&pool->threads[i - 1], NULL,
+                                            worker_main, worker);
+                assert(failed == 0);
+        }
+        return pool;
+}
+
+/* void Workpool_free(T *pool)
+ * Parameters: T *pool - pointer to the pool to free
+ *    Returns: Nothing
+ *       Does: Tells the pool's threads to exit, waits for them, frees
+ *             everything and overwrites the pointer with NULL
+ *   if Error: raises assertion if pool or *pool is null
+ */
+void Workpool_free(T *pool)
+{
+        assert(pool != NULL && *pool != NULL);
+        T p = *pool;
+
+        pthread_mutex_lock(&p->lock);
+        p->quit = 1;
+        pthread_cond_broadcast(&p->start);
+        pthread_mutex_unlock(&p->lock);
+        for (int i = 1; i < p->nthreads; i++) {
+                pthread_join(p->threads[i - 1], NULL);
+        }
+
+        for (int i = 0; i < p->nthreads; i++) {
+                pthread_mutex_destroy(&p->deques[i].lock);
+        }
+        pthread_mutex_destroy(&p->lock);
+        pthread_cond_destroy(&p->start);
+        pthread_cond_destroy(&p->done);
+        free(p->threads);
+        free(p->deques);
+        free(p);
+        *pool = NULL;
+}
+
+/* int Workpool_threads(T pool)
+ * Parameters: T pool - the pool
+ *    Returns: number of threads that run its tasks
+ *   if Error: raises assertion if pool is null
+ */
+int Workpool_threads(T pool)
+{
+        assert(pool != NULL);
+        return pool->nthreads;
+}
+
+/* void Workpool_run(T pool, int ntasks, Workpool_taskfun *task, void *cl)
+ * Parameters: T pool - the pool
+ *             int ntasks - number of tasks
+ *             Workpool_taskfun *task - function running one task
+ *             void *cl - closure passed to every task
+ *    Returns: Nothing, once all the tasks have run
+ *       Does: Deals the task numbers out in equal consecutive ranges,
+ *             wakes the workers, works alongside them as thread 0, and
+ *             waits until every worker has finished
+ *   if Error: raises assertions
+ *             if pool or task is null
+ *             if ntasks is negative
+ */
+void Workpool_run(T pool, int ntasks, Workpool_taskfun *task, void *cl)
+{
+        assert(pool != NULL && task != NULL);
+        assert(ntasks >= 0);
+        int nthreads = pool->nthreads;
+
+        /* No worker is running, so the deques can be filled unlocked */
+        for (int i = 0; i < nthreads; i++) {
+                pool->deques[i].low = (int) ((long) ntasks * i / nthreads);
+                pool->deques[i].high = (int) ((long) ntasks * (i + 1)
+                                              / nthreads);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->task = task;
+        pool->cl = cl;
+        pool->busy = nthreads - 1;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->lock);
+
+        work(pool, 0);
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->busy > 0) {
+                pthread_cond_wait(&pool->done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+}
+
+/* void Workpool_map(int nthreads, int ntasks, Workpool_mapfun *task,
+ *                   void *cl, Workpool_closurefun *make_cl,
+ *                   void *thread_cl)
+ * Parameters: int nthreads - number of threads that run tasks
+ *             int ntasks - number of tasks
+ *             Workpool_mapfun *task - function running one task
+ *             void *cl - closure passed to every task
+ *             Workpool_closurefun *make_cl - makes each thread's closure
+ *                                            from thread_cl, or NULL
+ *             void *thread_cl - the threads' closure, or what make_cl
+ *                               makes theirs from
+ *    Returns: Nothing, once all the tasks have run
+ *       Does: Runs the tasks on the shared pool, first making it anew if
+ *             it has a different number of threads; if another call
+ *             holds it, makes and frees a pool for this call alone
+ *   if Error: raises assertions
+ *             if nthreads < 1 or task is null
+ *             if ntasks is negative
+ *             if memory or a thread cannot be allocated
+ */
+void Workpool_map(int nthreads, int ntasks, Workpool_mapfun *task,
+                  void *cl, Workpool_closurefun *make_cl, void *thread_cl)
+{
+        static int registered = 0;
+        assert(nthreads >= 1 && task != NULL);
+        struct map map = { task, cl, make_cl, thread_cl, NULL };
+        map.threads = calloc(nthreads, sizeof(*map.threads));
+        assert(map.threads != NULL);
+
+        T pool;
+        int own = pthread_mutex_trylock(&shared_lock) == 0;
+        if (own) {
+                if (shared != NULL && shared->nthreads != nthreads) {
+                        Workpool_free(&shared);
+                }
+                if (shared == NULL) {
+                        shared = Workpool_new(nthreads);
+                }
+                if (!registered) {
+                        registered = atexit(free_shared) == 0;
+                }
+                pool = shared;
+        } else {
+                pool = Workpool_new(nthreads);
+        }
+        Workpool_run(pool, ntasks, map_task, &map);
+        if (own) {
+                pthread_mutex_unlock(&shared_lock);
+        } else {
+                Workpool_free(&pool);
+        }
+        free(map.threads);
+}
+
+/* static void map_task(int task, int thread, void *vmap)
+ * Parameters: int task - the task's number
+ *             int thread - the number of the thread running it
+ *             void *vmap - the struct map
+ *    Returns: Nothing
+ *       Does: Makes the thread's closure if this is its first task, then
+ *             runs the task with it
+ *   if Error: None
+ */
+static void map_task(int task, int thread, void *vmap)
+{
+        struct map *map = vmap;
+        void *thread_cl = map->thread_cl;
+        if (map->make_cl != NULL) {
+                if (!map->threads[thread].made) {
+                        map->threads[thread].cl = map->make_cl(thread,
+                                                               thread_cl);
+                        map->threads[thread].made = 1;
+                }
+                thread_cl = map->threads[thread].cl;
+        }
+        map->task(task, thread_cl, map->cl);
+}
+
+/* static void free_shared(void)
+ * Parameters: None
+ *    Returns: Nothing
+ *       Does: Frees the pool Workpool_map keeps, at exit, unless a call
+ *             still holds it (exit called from a task)
+ *   if Error: None
+ */
+static void free_shared(void)
+{
+        if (pthread_mutex_trylock(&shared_lock) == 0) {
+                if (shared != NULL) {
+                        Workpool_free(&shared);
+                }
+                pthread_mutex_unlock(&shared_lock);
+        }
+}
+
+/* static void *worker_main(void *vworker)
+ * Parameters: void *vworker - the struct worker describing this thread
+ *    Returns: NULL, when the pool is freed
+ *       Does: Sleeps until a run starts, works until no task is left,
+ *             reports that it is done and goes back to sleep
+ *   if Error: None
+ */
+static void *worker_main(void *vworker)
+{
+        struct worker *worker = vworker;
+        T pool = worker->pool;
+        int index = worker->index;
+        unsigned seen = 0;
+        free(worker);
+
+        pthread_mutex_lock(&pool->lock);
+        for (;;) {
+                while (!pool->quit && pool->generation == seen) {
+                        pthread_cond_wait(&pool->start, &pool->lock);
+                }
+                if (pool->quit) {
+                        break;
+                }
+                seen = pool->generation;
+                pthread_mutex_unlock(&pool->lock);
+
+                work(pool, index);
+
+                pthread_mutex_lock(&pool->lock);
+                if (--pool->busy == 0) {
+                        pthread_cond_signal(&pool->done);
+                }
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+}
+
+/* static void work(T pool, int index)
+ * Parameters: T pool - the pool
+ *             int index - the calling thread's number
+ *    Returns: Nothing, once no deque has a task left
+ *       Does: Runs the tasks of its own deque in increasing order, then
+ *             steals from the other deques, starting with its neighbour,
+ *             until a full sweep finds them all empty; since no task is
+ *             ever added during a run, that means the run is over
+ *   if Error: None
+ */
+static void work(T pool, int index)
+{
+        int nthreads = pool->nthreads;
+        int task;
+
+        while (take(&pool->deques[index], 1, &task)) {
+                pool->task(task, index, pool->cl);
+        }
+
+        int victim = index;
+        int misses = 0;
+        while (misses < nthreads - 1) {
+                victim = (victim + 1) % nthreads;
+                if (victim == index) {
+                        continue;
+                }
+                if (take(&pool->deques[victim], 0, &task)) {
+                        pool->task(task, index, pool->cl);
+                        misses = 0;
+                        victim = index;   /* restart the sweep */
+                } else {
+                        misses++;
+                }
+        }
+}
+
+/* static int take(struct deque *deque, int own, int *task)
+ * Parameters: struct deque *deque - the deque to take from
+ *             int own - nonzero when the caller owns the deque
+ *             int *task - set to the task taken
+ *    Returns: 1 if a task was taken, 0 if the deque was empty
+ *       Does: The owner takes the lowest task left, a thief the highest,
+ *             so the two only meet on the last task
+ *   if Error: None
+ */
+static int take(struct deque *deque, int own, int *task)
+{
+        int taken = 0;
+        pthread_mutex_lock(&deque->lock);
+        if (deque->low < deque->high) {
+                *task = own ? deque->low++ : --deque->high;
+                taken = 1;
+        }
+        pthread_mutex_unlock(&deque->lock);
+        return taken;
+}
@@ -0,0 +1,62 @@
+#ifndef WORKPOOL_INCLUDED
+#define WORKPOOL_INCLUDED
+
+#define T Workpool_T
+typedef struct T *T;
+
+/* a task is known by its number, and is run by calling a function
+ * with that number, the number (0 to nthreads - 1) of the thread
+ * running it and the closure given to Workpool_run
+ */
+typedef void Workpool_taskfun(int task, int thread, void *cl);
+
+/* new pool that runs tasks on 'nthreads' threads: the thread calling
+ * Workpool_run plus nthreads - 1 threads of the pool's own
+ * nthreads < 1 is a checked runtime error
+ */
+extern T    Workpool_new    (int nthreads);
+extern void Workpool_free   (T *pool);
+extern int  Workpool_threads(T pool);
+
+/* runs tasks 0 ... ntasks - 1, each exactly once, and
+ * returns when all of them have finished
+ *
+ * each thread starts with its own deque holding an equal share of
+ * consecutive task numbers, takes tasks from the low end of it, and
+ * when it runs dry steals from the high end of another thread's deque,
+ * so threads that draw slow tasks do not hold up the others
+ *
+ * tasks may run concurrently, in any order, on any thread
+ */
+extern void Workpool_run(T pool, int ntasks, Workpool_taskfun *task,
+                         void *cl);
+
+/* makes the closure one thread of Workpool_map hands its tasks, given
+ * the thread's number and the closure passed to Workpool_map; the same
+ * type as A2Methods_closurefun
+ */
+typedef void *Workpool_closurefun(int thread, void *cl);
+
+/* a task of Workpool_map, called with its number, the closure of the
+ * thread running it and the closure given to Workpool_map
+ */
+typedef void Workpool_mapfun(int task, void *thread_cl, void *cl);
+
+/* runs tasks 0 ... ntasks - 1 as Workpool_run does, on 'nthreads'
+ * threads of a pool kept from one call to the next; each thread's
+ * closure is made by make_cl(thread, thread_cl) the first time that
+ * thread runs a task, or is thread_cl itself if make_cl is NULL
+ *
+ * a call made while another is running gets a pool of its own
+ * nthreads < 1 or a NULL task is a checked runtime error
+ */
+extern void Workpool_map(int nthreads, int ntasks, Workpool_mapfun *task,
+                         void *cl, Workpool_closurefun *make_cl,
+                         void *thread_cl);
+
+/*
+ * it is a checked run-time error to pass a NULL T
+ * to any function in this interface
+ */
+#undef T
+#endif